@@ -1,6 +1,8 @@
 #ifndef CONFIG_H_
 #define CONFIG_H_
 
+#include "kinematicChain.h"
+
 //SERIAL SETTINGS
 #define BAUD 115200
 
@@ -9,7 +11,7 @@
 #define LOW_SHANK_LENGTH 320.0
 #define HIGH_SHANK_LENGTH 320.0
 
-#define END_EFFECTOR_OFFSET 0.0 // LENGTH FROM UPPER SHANK BEARING TO MIDPOINT OF END EFFECTOR IN MM
+#define END_EFFECTOR_OFFSET kxr::KC_END_EFFECTOR_OFFSET // LENGTH FROM UPPER SHANK BEARING TO MIDPOINT OF END EFFECTOR IN MM (SET IN kinematicChain.h , SHARED WITH THE HOST)
 
 //INITIAL INTERPOLATION SETTINGS
 //  INITIAL_XYZ FORMS VERTICAL LOWER ARM & HORIZONTAL UPPER ARM IN 90 DEGREES
@@ -84,10 +86,10 @@
 //2: DEBUG
 
 //MOVE LIMIT PARAMETERS
-#define Z_MIN -125.0 //MINIMUM Z HEIGHT OF TOOLHEAD TOUCHING GROUND
-#define Z_MAX (LOW_SHANK_LENGTH+30.0) //SHANK_LENGTH ADDING ARBITUARY NUMBER FOR Z_MAX
-#define SHANKS_MIN_ANGLE_COS 0.791436948 
-#define SHANKS_MAX_ANGLE_COS -0.774944489 
+#define Z_MIN kxr::KC_Z_MIN //MINIMUM Z HEIGHT OF TOOLHEAD TOUCHING GROUND (SET IN kinematicChain.h , SHARED WITH THE HOST)
+#define Z_MAX (LOW_SHANK_LENGTH+kxr::KC_Z_MAX_ABOVE_LOW_SHANK) //SHANK_LENGTH ADDING ARBITUARY NUMBER FOR Z_MAX (SET IN kinematicChain.h)
+#define SHANKS_MIN_ANGLE_COS kxr::KC_SHANKS_MIN_ANGLE_COS
+#define SHANKS_MAX_ANGLE_COS kxr::KC_SHANKS_MAX_ANGLE_COS
 #define R_MIN (sqrt((sq(LOW_SHANK_LENGTH) + sq(HIGH_SHANK_LENGTH)) - (2*LOW_SHANK_LENGTH*HIGH_SHANK_LENGTH*SHANKS_MIN_ANGLE_COS) ))
 #define R_MAX (sqrt((sq(LOW_SHANK_LENGTH) + sq(HIGH_SHANK_LENGTH)) - (2*LOW_SHANK_LENGTH*HIGH_SHANK_LENGTH*SHANKS_MAX_ANGLE_COS) ))
 
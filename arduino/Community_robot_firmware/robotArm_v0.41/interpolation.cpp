@@ -219,17 +219,9 @@ Point Interpolation::getPosmm() const {
 }
 
 bool Interpolation::isAllowedPosition(float pos_tracker[4]) {
-  float rrot_ee = hypot(pos_tracker[X_AXIS], pos_tracker[Y_AXIS]);
-  float rrot = rrot_ee - END_EFFECTOR_OFFSET; 
-  float rrot_x = rrot * (pos_tracker[Y_AXIS] / rrot_ee);
-  float rrot_y = rrot * (pos_tracker[X_AXIS] / rrot_ee);
-  float squaredPositionModule = sq(rrot_x) + sq(rrot_y) + sq(pos_tracker[Z_AXIS]);  
-
+  //R/Z LIMITS ARE SHARED WITH THE HOST (kinematicChain.h) SO ITS WORKSPACE MAP AGREES WITH THIS CHECK
       bool retVal = (
-          squaredPositionModule <= sq(R_MAX) 
-          && squaredPositionModule >= sq(R_MIN) 
-          && pos_tracker[Z_AXIS] >= Z_MIN  
-          && pos_tracker[Z_AXIS] <= Z_MAX   
+          kxr::isAllowedPosition(LOW_SHANK_LENGTH, HIGH_SHANK_LENGTH, END_EFFECTOR_OFFSET, pos_tracker[X_AXIS], pos_tracker[Y_AXIS], pos_tracker[Z_AXIS])
           && pos_tracker[E_AXIS] <= RAIL_LENGTH
       );
   if(!retVal) {
@@ -0,0 +1,232 @@
+#ifndef KINEMATICCHAIN_H_
+#define KINEMATICCHAIN_H_
+
+//HEADER ONLY KINEMATICS OF THE 4DOF ARM, SHARED BY THE KINECTXROBOT HOST APP AND THIS FIRMWARE
+//C++11 WITHOUT STL SO IT BUILDS WITH AVR-GCC AS WELL AS MSVC/GCC ON THE HOST
+//HOST CONVENTION (robot_manipulator): Y UP, LENGTHS IN MM, ANGLES IN DEGREES, THIRD LINK l3 IS THE WRIST
+//FIRMWARE CONVENTION (RobotGeometry): Z UP, LENGTHS IN MM, ANGLES IN RADIANS, NO WRIST, l3 IS END_EFFECTOR_OFFSET HELD LEVEL
+//BOTH FRAMES ARE RELATIVE TO THE SHOULDER (LOWER SHANK PIVOT)
+
+#include <math.h>
+
+namespace kxr {
+
+const float KC_RAD_TO_DEG = 57.29577951f;
+const float KC_DEG_TO_RAD = 0.01745329252f;
+const float KC_PI = 3.14159265f;
+
+//BUILD CONSTANTS THE HOST HAS TO AGREE ON, config.h TAKES END_EFFECTOR_OFFSET AND Z_MIN FROM HERE
+const float KC_END_EFFECTOR_OFFSET = 0.0f; //LENGTH FROM UPPER SHANK BEARING TO MIDPOINT OF END EFFECTOR IN MM
+const float KC_Z_MIN = -125.0f; //MINIMUM Z HEIGHT OF TOOLHEAD TOUCHING GROUND
+const float KC_Z_MAX_ABOVE_LOW_SHANK = 30.0f; //Z_MAX IS LOW_SHANK_LENGTH PLUS THIS
+const float KC_SHANKS_MIN_ANGLE_COS = 0.791436948f; //R_MIN AND R_MAX FOLLOW FROM THE ELBOW OPENING LIMITS
+const float KC_SHANKS_MAX_ANGLE_COS = -0.774944489f;
+
+//LIMB LENGTHS KNOWN AT COMPILE TIME (WHOLE MM), EVERY DERIVED CONSTANT FOLDS INTO THE SOLVER
+template <int L1_MM, int L2_MM, int L3_MM>
+struct FixedArmDims {
+  static constexpr float l1() { return (float)L1_MM; }
+  static constexpr float l2() { return (float)L2_MM; }
+  static constexpr float l3() { return (float)L3_MM; }
+  static constexpr float l1L2Sqrd() { return l1() * l1() + l2() * l2(); }
+  static constexpr float l1SqrdSubL2() { return l1() * l1() - l2() * l2(); }
+  static constexpr float inv2L1L2() { return 1.0f / (2.0f * l1() * l2()); }
+  static constexpr float twoL1() { return 2.0f * l1(); }
+};
+
+//LIMB LENGTHS CHANGED AT RUNTIME (E.G. THE HOST "CHANGE LIMB LENGTHS" PANEL), DERIVED CONSTANTS CACHED ON set()
+struct RuntimeArmDims {
+  RuntimeArmDims() { set(0.0f, 0.0f, 0.0f); }
+  RuntimeArmDims(float a_l1, float a_l2, float a_l3) { set(a_l1, a_l2, a_l3); }
+
+  void set(float a_l1, float a_l2, float a_l3) {
+    len1 = a_l1;
+    len2 = a_l2;
+    len3 = a_l3;
+    c_l1_l2_sqrd = a_l1 * a_l1 + a_l2 * a_l2;
+    c_l1_sqrd_sub_l2 = a_l1 * a_l1 - a_l2 * a_l2;
+    c_inv_2l1l2 = (a_l1 > 0.0f && a_l2 > 0.0f) ? 1.0f / (2.0f * a_l1 * a_l2) : 0.0f;
+    c_two_l1 = 2.0f * a_l1;
+  }
+
+  float l1() const { return len1; }
+  float l2() const { return len2; }
+  float l3() const { return len3; }
+  float l1L2Sqrd() const { return c_l1_l2_sqrd; }
+  float l1SqrdSubL2() const { return c_l1_sqrd_sub_l2; }
+  float inv2L1L2() const { return c_inv_2l1l2; }
+  float twoL1() const { return c_two_l1; }
+
+  float len1;
+  float len2;
+  float len3;
+  float c_l1_l2_sqrd;
+  float c_l1_sqrd_sub_l2;
+  float c_inv_2l1l2;
+  float c_two_l1;
+};
+
+//FULLY UNROLLED FK/IK OF THE SHOULDER/ELBOW/WRIST/BASE ARM FOR EITHER DIMS TYPE
+template <class Dims>
+class KinematicChain {
+public:
+  KinematicChain() {}
+  explicit KinematicChain(const Dims& a_dims) : dims(a_dims) {}
+
+  //INVERSE KINEMATICS, SAME FORMULAS AS robot_manipulator::calcIK
+  //(x , y , z , gamma) -> angles = (alpha , beta , theta , theta_0)
+  //RETURNS false IF THE TARGET IS OUTSIDE THE REACHABLE SHELL (ANGLES ARE THEN NaN LIKE calcIK)
+  bool inverse(float x, float y, float z, float gamma, float angles[4]) const {
+    float g = gamma * KC_DEG_TO_RAD;
+    float x0 = x - dims.l3() * cosf(g);
+    float y0 = y - dims.l3() * sinf(g);
+    float r0_sqrd = x0 * x0 + y0 * y0;
+    float r0 = sqrtf(r0_sqrd);
+    float rz = sqrtf(x * x + y * y);
+
+    float cos_b = (dims.l1L2Sqrd() - r0_sqrd) * dims.inv2L1L2();
+    float cos_a = (r0_sqrd + dims.l1SqrdSubL2()) / (dims.twoL1() * r0);
+    float cos_t0 = z / rz;
+
+    float b = 180.0f - acosf(cos_b) * KC_RAD_TO_DEG;
+    float a = atanf(y0 / x0) * KC_RAD_TO_DEG + acosf(cos_a) * KC_RAD_TO_DEG;
+
+    angles[0] = a;
+    angles[1] = -b;
+    angles[2] = gamma - a + b;
+    angles[3] = acosf(cos_t0) * KC_RAD_TO_DEG;
+
+    return inUnit(cos_b) && inUnit(cos_a) && inUnit(cos_t0);
+  }
+
+  //FORWARD KINEMATICS, END EFFECTOR RELATIVE TO THE SHOULDER
+  //angles = (alpha , beta , theta , theta_0) -> pos = (x , y , z), X/Z HORIZONTAL AND Y UP
+  void forward(const float angles[4], float pos[3]) const {
+    float a1 = angles[0] * KC_DEG_TO_RAD;
+    float a2 = a1 + angles[1] * KC_DEG_TO_RAD;
+    float a3 = a2 + angles[2] * KC_DEG_TO_RAD;
+    float t0 = angles[3] * KC_DEG_TO_RAD;
+
+    float reach = dims.l1() * cosf(a1) + dims.l2() * cosf(a2) + dims.l3() * cosf(a3);
+    float height = dims.l1() * sinf(a1) + dims.l2() * sinf(a2) + dims.l3() * sinf(a3);
+
+    pos[0] = reach * sinf(t0);
+    pos[1] = height;
+    pos[2] = reach * cosf(t0);
+  }
+
+  Dims dims;
+
+private:
+  static bool inUnit(float v) {
+    return v >= -1.0f && v <= 1.0f; //false for NaN
+  }
+};
+
+//STEPPER ANGLES OF THE FIRMWARE (RADIANS)
+//rot: BASE ROTATION FROM THE Y AXIS TOWARD X, low: LOWER SHANK FROM VERTICAL, high: UPPER SHANK FROM VERTICAL
+struct FirmwareJoints {
+  float rot;
+  float low;
+  float high;
+};
+
+//FK/IK IN THE FIRMWARE CONVENTION, l1 = LOW_SHANK_LENGTH, l2 = HIGH_SHANK_LENGTH, l3 = END_EFFECTOR_OFFSET
+//SINGLE PRECISION LIKE AVR (double IS float THERE) SO THE HOST GETS THE SAME ANSWERS AS THE MCU
+template <class Dims>
+class FirmwareChain {
+public:
+  FirmwareChain() {}
+  explicit FirmwareChain(const Dims& a_dims) : dims(a_dims) {}
+
+  //INVERSE KINEMATICS, SAME FORMULAS RobotGeometry::calculateGrad USED BEFORE IT DELEGATED HERE
+  //RETURNS false IF THE TARGET IS OUTSIDE THE REACHABLE SHELL (THE FIRMWARE STILL STEPS TO THE NaN/CLAMPED RESULT)
+  bool inverse(float x, float y, float z, FirmwareJoints& out) const {
+    float rrot_ee = hypotf(x, y);
+    float rrot = rrot_ee - dims.l3(); //radius from top view
+    float rside = hypotf(rrot, z);    //radius from side view
+    float rside_2 = rside * rside;
+
+    float cos_high = (dims.l1L2Sqrd() - rside_2) * dims.inv2L1L2();
+    float cos_low = (dims.l1SqrdSubL2() + rside_2) / (dims.twoL1() * rside);
+    float sin_rot = x / rrot_ee;
+
+    out.rot = asinf(sin_rot);
+    float high = KC_PI - acosf(cos_high);
+
+    //angle of lower stepper motor
+    if (z > 0) {
+      out.low = acosf(z / rside) - acosf(cos_low);
+    } else {
+      out.low = KC_PI - asinf(rrot / rside) - acosf(cos_low);
+    }
+    out.high = high + out.low;
+
+    return inUnit(cos_high) && inUnit(cos_low) && inUnit(sin_rot);
+  }
+
+  //FORWARD KINEMATICS, pos = (x , y , z) WITH Z UP
+  void forward(const FirmwareJoints& j, float pos[3]) const {
+    float r = dims.l1() * sinf(j.low) + dims.l2() * sinf(j.high) + dims.l3();
+    pos[0] = r * sinf(j.rot);
+    pos[1] = r * cosf(j.rot);
+    pos[2] = dims.l1() * cosf(j.low) + dims.l2() * cosf(j.high);
+  }
+
+  Dims dims;
+
+private:
+  static bool inUnit(float v) {
+    return v >= -1.0f && v <= 1.0f; //false for NaN
+  }
+};
+
+//CONVERSIONS BETWEEN THE TWO CONVENTIONS
+//POSITIONS: HOST (x , y UP , z) <-> FIRMWARE (x , y , z UP), G1 X/Y/Z ARE FIRMWARE COORDINATES
+inline void hostToFirmware(const float host[3], float fw[3]) {
+  fw[0] = host[0];
+  fw[1] = host[2];
+  fw[2] = host[1];
+}
+
+inline void firmwareToHost(const float fw[3], float host[3]) {
+  host[0] = fw[0];
+  host[1] = fw[2];
+  host[2] = fw[1];
+}
+
+//FIRMWARE JOINTS -> HOST (alpha , beta , theta , theta_0) DEGREES, THE FIRMWARE TOOL IS LEVEL SO gamma = 0
+//PUT THROUGH KinematicChain::forward WITH l3 = END_EFFECTOR_OFFSET THIS LANDS ON THE SAME POINT AS FirmwareChain::forward
+inline void firmwareToHostAngles(const FirmwareJoints& j, float angles[4]) {
+  angles[0] = 90.0f - j.low * KC_RAD_TO_DEG;
+  angles[1] = (j.low - j.high) * KC_RAD_TO_DEG;
+  angles[2] = -(angles[0] + angles[1]);
+  angles[3] = j.rot * KC_RAD_TO_DEG;
+}
+
+//HOST ANGLES -> FIRMWARE JOINTS, theta IS DROPPED (THE FIRMWARE HAS NO WRIST)
+inline void hostToFirmwareAngles(const float angles[4], FirmwareJoints& j) {
+  j.low = (90.0f - angles[0]) * KC_DEG_TO_RAD;
+  j.high = j.low - angles[1] * KC_DEG_TO_RAD;
+  j.rot = angles[3] * KC_DEG_TO_RAD;
+}
+
+//MOVE LIMITS OF Interpolation::isAllowedPosition (RAIL EXCLUDED), FIRMWARE FRAME, l1 = LOW_SHANK_LENGTH, l2 = HIGH_SHANK_LENGTH
+//THE HOST RUNS THE SAME TEST SO IT NEVER PLANS A G1 TARGET THE FIRMWARE WOULD REFUSE
+inline bool isAllowedPosition(float l1, float l2, float ee_offset, float x, float y, float z) {
+  float rrot_ee = sqrtf(x * x + y * y);
+  float rrot = rrot_ee - ee_offset;
+  float rrot_x = rrot * (y / rrot_ee);
+  float rrot_y = rrot * (x / rrot_ee);
+  float squaredPositionModule = rrot_x * rrot_x + rrot_y * rrot_y + z * z;
+  float rMinSqrd = l1 * l1 + l2 * l2 - 2.0f * l1 * l2 * KC_SHANKS_MIN_ANGLE_COS;
+  float rMaxSqrd = l1 * l1 + l2 * l2 - 2.0f * l1 * l2 * KC_SHANKS_MAX_ANGLE_COS;
+  return squaredPositionModule <= rMaxSqrd
+      && squaredPositionModule >= rMinSqrd
+      && z >= KC_Z_MIN
+      && z <= l1 + KC_Z_MAX_ABOVE_LOW_SHANK;
+}
+
+}
+
+#endif
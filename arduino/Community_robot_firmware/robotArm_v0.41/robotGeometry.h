@@ -1,6 +1,8 @@
 #ifndef ROBOTGEOMETRY_H_
 #define ROBOTGEOMETRY_H_
 
+#include "kinematicChain.h"
+
 class RobotGeometry {
 public:
   RobotGeometry(float a_ee_offset, float a_low_shank_length, float a_high_length);
@@ -13,9 +15,7 @@ public:
   float getHighRad() const;
 private:
   void calculateGrad();
-  float ee_offset;
-  float low_shank_length;
-  float high_shank_length;
+  kxr::FirmwareChain<kxr::RuntimeArmDims> chain; //shared with the host app so it can predict these angles
   float xmm;
   float ymm;
   float zmm;
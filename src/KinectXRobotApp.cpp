@@ -2,16 +2,26 @@
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
 #include "cinder/CinderImGui.h"
+#include "cinder/Filesystem.h"
 
 #include <Windows.h>
 #include <synchapi.h>
 #include <iostream>
 #include <string>
 #include <queue>
+#include <memory>
+#include <time.h>
 
-#include "NuiApi.h"
 #include "robot_manipulator.h"
+#include "rr_teleop.h"
 #include "serial.h"
+#include "kinect_capture.h"
+#include "replay_source.h"
+#include "scripted_source.h"
+#include "skeleton_recording.h"
+#include "tracking_pipeline.h"
+#include "noise_calibration.h"
+#include "extrinsic_calibration.h"
 
 //Taken from stack over flow for debugging printf
 #include <sstream>
@@ -27,6 +37,44 @@ using namespace ci;
 using namespace ci::app;
 using namespace std;
 
+//session recordings go here relative to the working directory
+#define RECORDING_DIR "recordings"
+
+//filter settings found by the noise calibration, loaded at startup
+#define FILTER_PROFILE_PATH "filter_profile.txt"
+
+//sensor to robot map found by the extrinsic calibration, loaded at startup
+#define EXTRINSIC_PROFILE_PATH "extrinsic_calibration.txt"
+
+//extra arm models are drawn side by side with the main robot , this far apart along z (model units)
+#define ARM_DRAW_SPACING 800.0f
+
+//backends selectable in the "Kinect output" window
+enum skeleton_source_kind {
+	SOURCE_KINECT = 0,
+	SOURCE_REPLAY,
+	SOURCE_SCRIPTED
+};
+
+//an extra arm on its own serial link , following another person off the frames the main pipeline cleaned up
+struct arm_link {
+	robot_manipulator robot;
+	tracking_pipeline pipeline{ robot };
+
+	SerialPort port;
+	char port_name[32];
+	bool port_opened;
+	bool port_failed;			//last open attempt failed
+	bool send_gcode;
+
+	arm_link() {
+		memset(port_name, 0, sizeof(port_name));
+		port_opened = false;
+		port_failed = false;
+		send_gcode = false;
+	}
+};
+
 class KinectXRobotApp : public App {
   public:
 	void setup() override;
@@ -56,9 +104,11 @@ class KinectXRobotApp : public App {
 	//robot manipulator model
 	robot_manipulator r1;
 	
-	//robot model control
-	vec4 robot_dest;		//vector to be passed to robot model  
-	vec3 robot_home_point;	//home position or initial position of model 
+	//skeleton frame -> robot model -> G1 line, shared with the headless driver
+	tracking_pipeline pipeline{ r1 };
+
+	//more arms driven by other people in view, each with its own model , pipeline and port
+	vector<unique_ptr<arm_link>> arms;
 	
 	//robot model length parameters
 	const float f_incre = 5.0f;
@@ -76,65 +126,56 @@ class KinectXRobotApp : public App {
 	//gcode streaming testing tools
 	const int S32_incre = 50.0f;
 	const int Origin_incre = 1.0f;
-	
-	int x_temp, y_temp, z_temp;				//Motion capturefiltering tools
-	int x_temp_old, y_temp_old, z_temp_old;
-	float tot_displacement, old_tot_displacement;
-	int x_origin, y_origin, z_origin;		//Initial position of robot
-	int mv_speed;			//speed up tool
-	char gcode_buff[32];	//gcode container before streaming
-	bool apply_mvspeed;		//speed testing
-	int loops_since_send;   //loop tracker to space out between sends
+	const uint32_t Person_incre = 1;
 
 	//Start of Kinect stuff
-	//Flags and handlers
-	HRESULT hr;
-	HANDLE Skel_dready;
+	//skeleton frames come from the Kinect, a recording or a script
+	std::unique_ptr<skeleton_source> source;
+	int source_kind;			//skeleton_source_kind of source
+	char replay_path[256];		//recording opened by the replay source
+	string source_error;		//why the last open_source failed
+	int frames_drained;			//frames drained in the last update
 
-	//Sensor object
-	INuiSensor* sensor;
+	//every drained frame is also queued here while recording a session
+	recording_writer recorder;
 
 	//for seated tracking mode
 	bool seated_tracking;
-	
-	//Faux origin for setting which point is the displacement if referrenced to
-	vec3 faux_origin;
-	bool faux_origin_set;
-
-	int tracking_target;		//int for choosing which target to track for displacement
-	bool apply_displacement;	//flag for applying displacement
-	vec3 displacement;			//displacement vector calculated relative to origin
-	float displacement_mult;	//scalar multiplier to change sensitivity of displacement vector
-	
 
+	//sensor side smoothing (NuiTransformSmooth) on top of the joint filter
+	bool sensor_smoothing;
 
+	//hold still , measure the sensor noise and tune the joint filter to it
+	noise_calibration calibration;
+	string profile_status;		//result of the last profile load / save
 
-	//Skeleton data 
-	NUI_SKELETON_FRAME c_skeletonFrame;
-	NUI_SKELETON_DATA c_skeletonData;
+	//the robot visits a few points with the operator's hand on the tool , the fit maps the sensor onto the firmware frame
+	extrinsic_calibration extrinsic;
+	bool has_extrinsic;			//a map was loaded or calibrated
+	bool extrinsic_pending;		//a run just finished , its map is not in the pipeline params yet
+	int extrinsic_sent;			//calibration point the robot was last sent to
+	string extrinsic_status;	//result of the last calibration load / save
 
 	//------Custom functions------
 
-	//initialize kinect sensors and skeletonFrame
-	HRESULT init_kinect();
+	//replace the skeleton source, returns false (and keeps no source) if it could not be started
+	bool open_source(int kind);
 
-	//update current skeleton frame
+	//drain every skeleton frame the source has ready into the pipeline
 	void update_skeletonFrame();
 
-	//function to get coordinate of arbitrary joint
-	void get_joint_coordinate();
-
-	//function to set faux origin;
-	void set_faux_origin();
+	//start recording drained frames to a new timestamped file in RECORDING_DIR
+	void start_recording();
 
 	//function to draw lines as bones in 3D space
-	void draw3D_bone(NUI_SKELETON_DATA skeletonData,
-		NUI_SKELETON_POSITION_INDEX joint1,
-		NUI_SKELETON_POSITION_INDEX joint2);
+	void draw3D_bone(const skeleton_pose& pose, int joint1, int joint2);
 
 	//function to draw skeleton tracked
 	void draw_skeleton();
 
+	//panel of the extra arms and the people they follow
+	void update_arms();
+
 
 
 	void cleanup() override;
@@ -165,20 +206,37 @@ void KinectXRobotApp::setup()
 
 	//initialize kinect tracking stuff
 	seated_tracking = true;
-	faux_origin_set = false;
-	tracking_target = 0;
-	apply_displacement = false;
-	displacement_mult = 1.0f;
+	sensor_smoothing = false;
+	source_kind = SOURCE_KINECT;
+	frames_drained = 0;
+	memset(replay_path, 0, sizeof(replay_path));
 
-	//initialize robot model position to home point
-	
-	robot_home_point = vec3(420, 320, 0);		//x=320, y=320, z=0;
-	robot_dest = vec4(robot_home_point, 0);		//home point , gamma = 0;
+	//initialize robot model position to home point (tracking and streaming defaults live in pipeline_params)
+	pipeline.set_dest(vec4(pipeline.get_params().home_point, 0));		//home point , gamma = 0;
 
 	//record initial robot limb lengths
 	default_lens = r1.get_limb_lens();			//get initial limb lens
 
-	r1.set_dest(robot_dest);					//move robot to home point
+	r1.set_dest(pipeline.get_dest());			//move robot to home point
+
+	//joint filter tuned for this installation , if it was calibrated before
+	filter_params profile = pipeline.get_filter().get_params();
+	if (noise_calibration::load_profile(FILTER_PROFILE_PATH, profile)) {
+		pipeline.get_filter().set_params(profile);
+		profile_status = "Loaded " FILTER_PROFILE_PATH;
+	}
+
+	//sensor to robot map of this installation replaces the faux origin in position mode , if it was calibrated before
+	has_extrinsic = false;
+	extrinsic_pending = false;
+	extrinsic_sent = -1;
+	pipeline_params track = pipeline.get_params();
+	if (extrinsic_calibration::load_profile(EXTRINSIC_PROFILE_PATH, track.extrinsic)) {
+		track.use_extrinsic = true;
+		pipeline.set_params(track);
+		has_extrinsic = true;
+		extrinsic_status = "Loaded " EXTRINSIC_PROFILE_PATH;
+	}
 
 
 	//initialize serial port status
@@ -187,35 +245,21 @@ void KinectXRobotApp::setup()
 	send_gcode = false;
 	s1 = SerialPort();						   //intantiate port object
 
-	//initialize gcode buff
-	memset(gcode_buff, 0, sizeof(gcode_buff));
-
-	//set initial position of actual robot
-	x_origin = 0;
-	y_origin = 320;
-	z_origin = 320;
-
-	//initialize filtering variables
-	tot_displacement = 0;
-	old_tot_displacement = 0;
-	x_temp = 0;
-	y_temp = 0;
-	z_temp = 0;
-
-	x_temp_old = x_temp;
-	y_temp_old = y_temp;
-	z_temp_old = z_temp;
-
-	apply_mvspeed = false;
-	mv_speed = 0;
-	loops_since_send = 0;
+	//skeleton source: the Kinect unless started with --replay <file> or --scripted
+	int kind = SOURCE_KINECT;
+	const vector<string>& args = getCommandLineArgs();
+	for (size_t i = 1; i < args.size(); i++) {
+		if (args[i] == "--scripted") kind = SOURCE_SCRIPTED;
+		else if (args[i] == "--replay" && i + 1 < args.size()) {
+			kind = SOURCE_REPLAY;
+			strncpy(replay_path, args[++i].c_str(), sizeof(replay_path) - 1);
+		}
+	}
 
-	//initiate kinect device communication
-	this->hr = init_kinect();
-	if (FAILED(this->hr))
+	//initiate skeleton source communication
+	if (!open_source(kind))
 		quit();
 
-	
 
 }
 
@@ -247,13 +291,24 @@ void KinectXRobotApp::update()
 	float u_bound = r1.get_tot_len();
 
 	//Get XYZ coordinates seperately
+	vec4 robot_dest = pipeline.get_dest();
 	ImGui::DragFloat("X", &robot_dest.x, 1.0f, 0.0f, u_bound);
 	ImGui::DragFloat("Y", &robot_dest.y, 1.0f, 0.0f, u_bound);
 	ImGui::DragFloat("Z", &robot_dest.z, 1.0f, 0.0f, u_bound);
 	//Get desired tool angle
 	ImGui::DragFloat("tool angle", &robot_dest.w, 1.0f, -90.0f,90.0f);
+	//or follow the operator's hand (wrist -> hand) while the displacement is applied
+	pipeline_params tool_params = pipeline.get_params();
+	ImGui::Checkbox("tool angle from hand", &tool_params.track_tool_angle);
+	if (tool_params.track_tool_angle) {
+		ImGui::DragFloat("tool angle offset", &tool_params.tool_angle_offset, 1.0f, -90.0f, 90.0f);
+		string tool_str = "hand tool angle: " + to_string(pipeline.get_tool_angle());
+		ImGui::Text(tool_str.c_str());
+	}
+	pipeline.set_params(tool_params);
 	//Button to reset end effector to home point
-	if (ImGui::Button("Reset to Home")) robot_dest = vec4(robot_home_point, 0);	
+	if (ImGui::Button("Reset to Home")) robot_dest = vec4(pipeline.get_params().home_point, 0);
+	pipeline.set_dest(robot_dest);
 
 
 
@@ -310,8 +365,84 @@ void KinectXRobotApp::update()
 	ImGui::Spacing();
 	ImGui::Spacing();
 	ImGui::Text("Robot-Kinect control");
-	ImGui::DragFloat("sensitivity", &displacement_mult,0.001f, 1.0f,2.0f);
-	ImGui::Checkbox("Apply displacement vector", &apply_displacement);
+	pipeline_params track = pipeline.get_params();
+	ImGui::DragFloat("sensitivity", &track.displacement_mult,0.001f, 1.0f,2.0f);
+	ImGui::Checkbox("Apply displacement vector", &track.apply_displacement);
+
+	//velocity mode starts integrating from wherever the model currently is
+	if (ImGui::Checkbox("Resolved-rate teleop", &track.rr_mode) && track.rr_mode) {
+		track.retarget_mode = false;
+		pipeline.start_rr(getElapsedSeconds());
+	}
+	rr_teleop& rr = pipeline.get_rr();
+	if (track.rr_mode && ImGui::TreeNode("Resolved-rate settings")) {
+		rr_params params = rr.get_params();
+		ImGui::DragFloat("control rate (Hz)", &params.rate_hz, 1.0f, 20.0f, 500.0f);
+		ImGui::DragFloat("gain (mm/s per cm/s)", &params.gain, 0.1f, 0.0f, 50.0f);
+		ImGui::DragFloat("smoothing", &params.smoothing, 0.01f, 0.01f, 1.0f);
+		ImGui::DragFloat("deadband (cm/s)", &params.deadband, 0.1f, 0.0f, 20.0f);
+		ImGui::DragFloat("max joint speed (deg/s)", &params.max_joint_speed, 1.0f, 1.0f, 360.0f);
+		ImGui::DragFloat("damping", &params.damping, 0.1f, 0.0f, 20.0f);
+		ImGui::DragFloat("G1 rate (Hz)", &track.rr_send_hz, 1.0f, 1.0f, 100.0f);
+		rr.set_params(params);
+
+		vec3 hand_vel = rr.get_hand_vel();
+		string hand_vel_str = "Hand velocity: (" + std::to_string(hand_vel.x) + " , " + std::to_string(hand_vel.y) + " , "
+			+ std::to_string(hand_vel.z) + " ) cm/s";
+		string manip_str = "Manipulability: " + std::to_string(rr.get_manipulability()) + " , damping: " + std::to_string(rr.get_lambda());
+		string steps_str = "Control steps: " + std::to_string(rr.get_steps());
+		ImGui::Text(hand_vel_str.c_str());
+		ImGui::Text(manip_str.c_str());
+		ImGui::Text(steps_str.c_str());
+		ImGui::TreePop();
+	}
+
+	//joint space teleop: the operator's shoulder , elbow and wrist angles drive the joints, zeroed on the current pose
+	if (ImGui::Checkbox("Joint-space retarget", &track.retarget_mode) && track.retarget_mode) {
+		track.rr_mode = false;
+		pipeline.start_retarget(getElapsedSeconds());
+	}
+	joint_retarget& retarget = pipeline.get_retarget();
+	if (track.retarget_mode && ImGui::TreeNode("Retarget settings")) {
+		retarget_params params = retarget.get_params();
+		ImGui::DragFloat4("gain (a , b , th , th0)", &params.gain.x, 0.01f, -5.0f, 5.0f);
+		ImGui::DragFloat4("min angle (deg)", &params.min_angle.x, 1.0f, -180.0f, 180.0f);
+		ImGui::DragFloat4("max angle (deg)", &params.max_angle.x, 1.0f, -180.0f, 180.0f);
+		ImGui::DragFloat("max joint speed (deg/s)", &params.max_speed, 1.0f, 0.0f, 720.0f);
+		ImGui::DragFloat("min reach for heading (cm)", &params.min_yaw_reach, 0.5f, 0.0f, 50.0f);
+		ImGui::DragFloat("G1 rate (Hz)", &track.rr_send_hz, 1.0f, 1.0f, 100.0f);
+		retarget.set_params(params);
+		if (ImGui::Button("Zero on current pose")) pipeline.start_retarget(getElapsedSeconds());
+
+		vec4 op = retarget.get_operator_angles();
+		string op_str = "Operator arm: " + std::to_string(op.x) + " , " + std::to_string(op.y) + " , " + std::to_string(op.z) + " , "
+			+ std::to_string(op.w);
+		ImGui::Text(op_str.c_str());
+		if (!retarget.has_neutral()) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "Arm not visible, zero again");
+		else if (retarget.is_limited()) ImGui::TextColored(ImVec4(1, 0.6f, 0.2f, 1), "At a joint or speed limit");
+		ImGui::TreePop();
+	}
+
+	//latency compensation: run the tracked joint ahead by the measured delay and re-evaluate it every loop
+	target_predictor& predictor = pipeline.get_predictor();
+	predict_params prediction = predictor.get_params();
+	ImGui::Checkbox("Predict target", &prediction.enabled);
+	if (prediction.enabled && ImGui::TreeNode("Prediction settings")) {
+		ImGui::Checkbox("horizon from measured delay", &prediction.auto_horizon);
+		if (!prediction.auto_horizon) ImGui::DragFloat("horizon (s)", &prediction.horizon, 0.005f, 0.0f, prediction.max_horizon);
+		ImGui::DragFloat("max horizon (s)", &prediction.max_horizon, 0.005f, 0.0f, 1.0f);
+		ImGui::DragFloat("sensor latency (s)", &prediction.sensor_latency, 0.005f, 0.0f, 0.5f);
+		ImGui::DragFloat("inferred scale", &prediction.inferred_scale, 0.01f, 0.0f, 1.0f);
+		ImGui::DragFloat("max lead (cm)", &prediction.max_lead, 0.5f, 0.0f, 50.0f);
+
+		string delay_str = "Delay: " + std::to_string(pipeline.get_delay() * 1000.0f) + " ms , ahead: "
+			+ std::to_string(pipeline.get_horizon() * 1000.0f) + " ms";
+		string lead_str = "Lead: " + std::to_string(predictor.get_lead()) + " cm";
+		ImGui::Text(delay_str.c_str());
+		ImGui::Text(lead_str.c_str());
+		ImGui::TreePop();
+	}
+	predictor.set_params(prediction);
 	
 	ImGui::Separator();
 	ImGui::Spacing();
@@ -352,83 +483,43 @@ void KinectXRobotApp::update()
 			//Modify initial position of actual robot and other commands
 			if (ImGui::TreeNode("Additional Options")) {
 
-				ImGui::InputScalar("Initial X pos.", ImGuiDataType_S32, &x_origin, &Origin_incre);
-				ImGui::InputScalar("Initial Y pos.", ImGuiDataType_S32, &y_origin, &Origin_incre);
-				ImGui::InputScalar("Initial Z pos.", ImGuiDataType_S32, &z_origin, &Origin_incre);
+				ImGui::InputScalar("Initial X pos.", ImGuiDataType_S32, &track.origin.x, &Origin_incre);
+				ImGui::InputScalar("Initial Y pos.", ImGuiDataType_S32, &track.origin.y, &Origin_incre);
+				ImGui::InputScalar("Initial Z pos.", ImGuiDataType_S32, &track.origin.z, &Origin_incre);
+
+				//position mode send rules (cm of displacement)
+				ImGui::DragFloat("max displacement", &track.max_displacement, 0.5f, 1.0f, 100.0f);
+				ImGui::DragFloat("send threshold", &track.send_threshold, 0.1f, 0.0f, 10.0f);
 
 				//enable and disable movement speed command in gcode
-				ImGui::Checkbox("Apply mv speed", &apply_mvspeed);
-				if (apply_mvspeed) ImGui::InputScalar("movement speed", ImGuiDataType_S32, &mv_speed, &S32_incre);
+				ImGui::Checkbox("Apply mv speed", &track.apply_mvspeed);
+				if (track.apply_mvspeed) ImGui::InputScalar("movement speed", ImGuiDataType_S32, &track.mv_speed, &S32_incre);
 
 				ImGui::TreePop();
 			}
 			
-			//Int to track how many coordinate values have changed
-			int coordinates_changed = 0;
-			int displacement_filter = 40;
-			int sample_threshold = 2;
-			//get total length of displacement vector
-			tot_displacement = sqrt((displacement.x * displacement.x) + (displacement.y * displacement.y) + (displacement.z * displacement.z));
-			
-			//Only record displacement if:
-			//----displacement is less than DISPLACEMENT_FILTER units long
-			//----new displacement has a delta of atleast SAMPLE_THRESHOLD from the previous displacement value
-	
-			if ((displacement.x < displacement_filter && displacement.x > -displacement_filter) &&
-				((displacement.x >= x_temp_old + sample_threshold)  || (displacement.x <= x_temp_old - sample_threshold))) {
-				x_temp_old = displacement_mult * displacement.x;
-				coordinates_changed++;
+			//sensor to robot calibration moves the robot through its points , otherwise the filtered G1 for this loop
+			//(pipeline decides whether it is due)
+			if (extrinsic.is_running()) {
+				if (extrinsic.get_point_index() != extrinsic_sent) {
+					vec3 point = extrinsic.get_point();
+					char point_gcode[32];
+					snprintf(point_gcode, sizeof(point_gcode), "G1X%dY%dZ%d", (int)round(point.x), (int)round(point.y), (int)round(point.z));
+					s1.write(point_gcode);
+					extrinsic_sent = extrinsic.get_point_index();
+					extrinsic.point_sent();
+				}
 			}
-
-			if ((displacement.y < displacement_filter && displacement.y > -displacement_filter) && 
-				((displacement.y >= y_temp_old + sample_threshold) || (displacement.y <= y_temp_old - sample_threshold))) {
-				y_temp_old = displacement_mult * displacement.y;
-				coordinates_changed++;
-			}
-
-			if ((displacement.z < displacement_filter && displacement.z > -displacement_filter) &&
-				( (displacement.z >= z_temp_old + sample_threshold) || (displacement.z <= z_temp_old - sample_threshold) )) {
-				z_temp_old = displacement_mult * displacement.z;
-				coordinates_changed++;
+			else if (pipeline.stream(getElapsedSeconds())) s1.write(pipeline.get_gcode());
+			ImGui::Text(pipeline.get_gcode());
+
+			//stepper angles RobotGeometry will compute for this move
+			kxr::FirmwareJoints fw_joints;
+			if (r1.predict_firmware(pipeline.get_g1_target(), fw_joints)) {
+				string fw_str = "MCU joints (rad): " + std::to_string(fw_joints.rot) + " , " + std::to_string(fw_joints.low) + " , " + std::to_string(fw_joints.high);
+				ImGui::Text(fw_str.c_str());
 			}
-
-
-			//Adding displacement to current home position (multiplying displacement with a constant)
-			int x_dest = (x_temp_old * 4) + x_origin;
-			int y_dest = (y_temp_old * 2) + y_origin;
-			int z_dest = (z_temp_old  * 2)+ z_origin;
-
-			//--------Coordinate edge cases-----
-			//minimum and maximum X coordinates
-			if (x_dest > 300) x_dest = 300;
-			if (x_dest < -300) x_dest = -300;
-			//minimum and maximum Y coordinates
-			if (y_dest < 250) y_dest = 320;
-			if (y_dest > 500) y_dest = 500;
-			//minimum and maximum Z coordinates
-			if (z_dest < 100) z_dest = 100;
-			if (z_dest > 320) z_dest = 320;
-
-			//Apply base speed
-			if (apply_mvspeed) sprintf(gcode_buff, "G1X%dY%dZ%dF%d", x_dest, y_dest, z_dest, mv_speed);
-			else  sprintf(gcode_buff, "G1X%dY%dZ%d", x_dest, y_dest, z_dest);
-
-			//send to robot over serial port if more than 1 coordinate has been updated
-			//after sending set a timer
-			if (coordinates_changed >= 1 && loops_since_send == 0) {
-				s1.write(gcode_buff); 
-				loops_since_send = 10;
-			}
-			
-			//decriment timer till next viable gcode send
-			if (loops_since_send > 0) loops_since_send -= 1;
-			else loops_since_send = 0;
-
-			//update record
-			old_tot_displacement = tot_displacement;
-			
-			ImGui::Text(gcode_buff);
-			memset(gcode_buff, 0, sizeof(gcode_buff));
+			else ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "MCU: target unreachable");
 
 			if (ImGui::Button("Stop gcode stream")) send_gcode = false;
 		}
@@ -475,58 +566,300 @@ void KinectXRobotApp::update()
 
 	//----------------------------START OF DISPLACEMENT PROCESSING / GCODE HANDLING---------------------------------------
 
-	//Calculating target displacement to apply to robot model
-	vec4 robot_displacement = vec4(displacement_mult) * vec4(robot_home_point + displacement, 0);
-	
+	//move the robot model from the latest displacement (resolved rate integration or IK)
+	pipeline.update(getElapsedSeconds());
+
+	//while calibrating the model shows the point the robot was sent to
+	if (extrinsic.is_running()) {
+		kxr::FirmwareJoints point_joints;
+		if (r1.predict_firmware(extrinsic.get_point(), point_joints)) {
+			float point_angles[4];
+			kxr::firmwareToHostAngles(point_joints, point_angles);
+			r1.set_angles(vec4(point_angles[0], point_angles[1], point_angles[2], point_angles[3]));
+		}
+	}
+
+	//same for every extra arm , each streams to its own port
+	for (size_t a = 0; a < arms.size(); a++) {
+		arm_link& arm = *arms[a];
+		arm.pipeline.update(getElapsedSeconds());
+		if (arm.port_opened && arm.send_gcode && arm.pipeline.stream(getElapsedSeconds())) arm.port.write(arm.pipeline.get_gcode());
+	}
 
-	
 	//--------------------------------END OF DISPLACEMENT PROCESSING / GCODE HANDLING---------------------------------------
 
-	//if apply displacement flag is set then update robot using displacement vector
-	if (apply_displacement) {
-		robot_dest = robot_displacement;
+	//Kinect stuff (tracking is only reconfigured by the capture thread when the seated flag changes)
+	if (source) {
+		source->set_seated(seated_tracking);
+		source->set_sensor_smoothing(sensor_smoothing);
 	}
-	//update robot arm destination
-	r1.set_dest(robot_dest);
 
-	//Kinect stuff
-	if (seated_tracking)
-		sensor->NuiSkeletonTrackingEnable(Skel_dready, NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT);
-	else
-		sensor->NuiSkeletonTrackingEnable(Skel_dready, 0);
+	//process everything the source queued since the last update
+	update_skeletonFrame();
 
-	//wait for available data and update skeletonFrame object
-	if (WAIT_OBJECT_0 == WaitForSingleObject(Skel_dready, 0)) {
-		update_skeletonFrame();
-		get_joint_coordinate();
+	//a sensor to robot calibration that just finished goes live
+	if (extrinsic_pending) {
+		track.extrinsic = extrinsic.get_result();
+		track.use_extrinsic = true;
+		has_extrinsic = true;
+		extrinsic_pending = false;
 	}
 
 	//Vector for tracking options
 	std::vector<std::string> tracking_targets;
-	tracking_targets.push_back("Head");
-	tracking_targets.push_back("Left hand");
-	tracking_targets.push_back("Right hand");
-	tracking_targets.push_back("Left foot");
-	tracking_targets.push_back("Right foot");
+	for (int i = 0; i < TRACK_TARGET_COUNT; i++) tracking_targets.push_back(tracking_pipeline::get_target_name(i));
 
 	//Displacement vector info
+	vec3 displacement = pipeline.get_displacement();
 	string displacement_str = "Displacement: (X" + std::to_string(displacement.x) + " ,Y " + std::to_string(displacement.y) + " ,Z "
 		+ std::to_string(displacement.z) + " )";
 
 	//Faux origin vector info
+	vec3 faux_origin = pipeline.get_faux_origin();
 	string faux_origin_string = "Faux origin ( " + std::to_string(faux_origin.x) + ", "
 		+ std::to_string(faux_origin.y) + ", " + std::to_string(faux_origin.z) + ")";
 
 	//Kinect tracking control window
 	ImGui::Begin("Kinect output");
+
+	//skeleton source selection
+	std::vector<std::string> source_kinds;
+	source_kinds.push_back("Kinect");
+	source_kinds.push_back("Replay file");
+	source_kinds.push_back("Scripted");
+	static int kind = source_kind;
+	ImGui::Combo("Skeleton source", &kind, source_kinds);
+	if (kind == SOURCE_REPLAY) ImGui::InputText("recording", replay_path, sizeof(replay_path));
+	if (ImGui::Button("Open source")) open_source(kind);
+	if (!source_error.empty()) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), source_error.c_str());
 	
-	ImGui::Combo("Tracking target", &tracking_target, tracking_targets);
+	ImGui::Combo("Tracking target", &track.tracking_target, tracking_targets);
 	ImGui::Checkbox("Seated Tracking", &seated_tracking);
 
+	//stable identities of everyone in view, a second person walking in does not take over the arm
+	ImGui::InputScalar("Follow person (0 first in view)", ImGuiDataType_U32, &track.person, &Person_incre);
+	if (ImGui::TreeNode("People")) {
+		body_tracker& people = pipeline.get_people();
+		tracker_params tracker = people.get_params();
+		ImGui::DragFloat("hold lost person (s)", &tracker.hold_time, 0.05f, 0.0f, 10.0f);
+		ImGui::DragFloat("re-acquire radius (m)", &tracker.max_jump, 0.01f, 0.05f, 2.0f);
+		people.set_params(tracker);
+
+		double now = pipeline.get_frame().time;
+		for (int i = 0; i < people.get_count(); i++) {
+			const tracked_person& person = people.get(i);
+			string person_str = "Person " + std::to_string(person.person) + ": ";
+			if (person.slot >= 0) person_str += "slot " + std::to_string(person.slot) + " , id " + std::to_string(person.id) + " , in view "
+				+ std::to_string(now - person.first_seen) + " s";
+			else person_str += "lost for " + std::to_string(now - person.last_seen) + " s";
+			if (person.person == pipeline.get_following()) person_str += " -> main arm";
+			for (size_t a = 0; a < arms.size(); a++)
+				if (person.person == arms[a]->pipeline.get_following()) person_str += " -> arm " + std::to_string(a + 2);
+			ImGui::Text(person_str.c_str());
+		}
+		ImGui::TreePop();
+	}
+
+	//rigid arm cleanup ahead of the joint filter
+	bone_constraint& bones = pipeline.get_bones();
+	bone_params bone_settings = bones.get_params();
+	ImGui::Checkbox("Bone length constraint", &bone_settings.enabled);
+	if (bone_settings.enabled && ImGui::TreeNode("Bone length settings")) {
+		ImGui::DragFloat("learning time (s)", &bone_settings.learn_time, 0.1f, 0.5f, 30.0f);
+		ImGui::DragInt("iterations", &bone_settings.iterations, 0.1f, 1, 10);
+		ImGui::DragFloat("inferred mobility", &bone_settings.inferred_mobility, 0.1f, 1.0f, 20.0f);
+		if (ImGui::Button("Relearn lengths")) bones.reset();
+
+		const bone_stats& bone_info = bones.get_stats();
+		string bone_str = std::to_string(bone_info.learned) + " learned , " + std::to_string(bone_info.learning) + " learning , correction "
+			+ std::to_string(bone_info.correction_mm) + " mm";
+		ImGui::Text(bone_str.c_str());
+
+		float lengths[ARM_BONE_COUNT];
+		if (pipeline.get_pose().valid && bones.get_lengths(pipeline.get_pose().slot, lengths)) {
+			string arm_str = "Left arm (cm): " + std::to_string(lengths[1] * 100.0f) + " , " + std::to_string(lengths[2] * 100.0f) + " , "
+				+ std::to_string(lengths[3] * 100.0f);
+			ImGui::Text(arm_str.c_str());
+		}
+		ImGui::TreePop();
+	}
+	bones.set_params(bone_settings);
+
+	//joint filter between the source and the robot, trade smoothness for latency
+	if (ImGui::TreeNode("Joint filter")) {
+		skeleton_filter& filter = pipeline.get_filter();
+		filter_params params = filter.get_params();
+
+		std::vector<std::string> filter_kinds;
+		for (int i = 0; i < FILTER_KIND_COUNT; i++) filter_kinds.push_back(skeleton_filter::get_kind_name(i));
+		ImGui::Combo("filter", &params.kind, filter_kinds);
+
+		if (params.kind == FILTER_ONE_EURO) {
+			ImGui::DragFloat("min cutoff (Hz)", &params.min_cutoff, 0.05f, 0.05f, 30.0f);
+			ImGui::DragFloat("beta (Hz per m/s)", &params.beta, 0.1f, 0.0f, 100.0f);
+			ImGui::DragFloat("speed cutoff (Hz)", &params.d_cutoff, 0.05f, 0.05f, 30.0f);
+		}
+		if (params.kind == FILTER_KALMAN) {
+			ImGui::DragFloat("process noise (m/s^2)", &params.process_noise, 0.1f, 0.01f, 100.0f);
+			ImGui::DragFloat("measurement noise (m)", &params.measurement_noise, 0.001f, 0.001f, 0.2f);
+		}
+		if (params.kind != FILTER_PASSTHROUGH) ImGui::DragFloat("inferred weight", &params.inferred_weight, 0.01f, 0.05f, 1.0f);
+		filter.set_params(params);
+
+		ImGui::Checkbox("Kinect smoothing", &sensor_smoothing);
+
+		const filter_stats& stats = filter.get_stats();
+		string lag_str = "Lag: " + std::to_string(stats.lag_ms) + " ms";
+		string jitter_str = "Jitter: " + std::to_string(stats.jitter_mm) + " mm (raw " + std::to_string(stats.raw_jitter_mm) + " mm)";
+		ImGui::Text(lag_str.c_str());
+		ImGui::Text(jitter_str.c_str());
+		ImGui::TreePop();
+	}
+
+	//operator holds still for a few seconds , the joint filter is tuned to the measured noise
+	if (ImGui::TreeNode("Noise calibration")) {
+		calib_params calib = calibration.get_params();
+		ImGui::DragFloat("hold still (s)", &calib.duration, 0.1f, 1.0f, 30.0f);
+		ImGui::DragFloat("latency budget (ms)", &calib.latency_budget_ms, 1.0f, 5.0f, 500.0f);
+		ImGui::DragFloat("max jitter (mm)", &calib.max_jitter_mm, 0.05f, 0.1f, 20.0f);
+		if (!calibration.is_running()) calibration.set_params(calib);
+
+		if (calibration.is_running()) {
+			if (ImGui::Button("Cancel calibration")) calibration.cancel();
+			ImGui::ProgressBar(calibration.get_progress());
+		}
+		else if (ImGui::Button("Start calibration")) calibration.start(pipeline.get_filter().get_params());
+
+		if (!calibration.get_error().empty()) ImGui::Text(calibration.get_error().c_str());
+		if (calibration.is_done()) {
+			const joint_noise& target_noise = calibration.get_noise(tracking_pipeline::get_target_joint(track.tracking_target));
+			string noise_str = "Target noise: " + std::to_string(target_noise.noise_mm) + " mm , drift " + std::to_string(target_noise.drift_mm_s) + " mm/s";
+			ImGui::Text(noise_str.c_str());
+
+			const filter_params& tuned = calibration.get_result();
+			string tuned_str = string(skeleton_filter::get_kind_name(tuned.kind)) + ": ";
+			if (tuned.kind == FILTER_KALMAN) tuned_str += "process noise " + std::to_string(tuned.process_noise) + " , measurement noise " + std::to_string(tuned.measurement_noise);
+			else tuned_str += "min cutoff " + std::to_string(tuned.min_cutoff) + " , beta " + std::to_string(tuned.beta);
+			ImGui::Text(tuned_str.c_str());
+
+			string result_str = "Lag " + std::to_string(calibration.get_result_lag()) + " ms , jitter " + std::to_string(calibration.get_result_jitter()) + " mm"
+				+ (calibration.is_budget_met() ? "" : " (budget not met)");
+			ImGui::Text(result_str.c_str());
+		}
+		if (!profile_status.empty()) ImGui::Text(profile_status.c_str());
+		ImGui::TreePop();
+	}
+
+	//sensor to robot axes, applied to every joint before rendering and control
+	if (ImGui::TreeNode("Sensor to robot")) {
+		std::vector<std::string> axis_names;
+		for (int i = 0; i < 3; i++) axis_names.push_back(joint_transform::get_axis_name(i));
+		const char* robot_axes[3] = { "robot x", "robot y", "robot z" };
+		const char* mirror_names[3] = { "mirror x", "mirror y", "mirror z" };
+
+		ImGui::DragFloat("scale (cm per m)", &track.sensor_map.scale, 1.0f, 1.0f, 1000.0f);
+		for (int i = 0; i < 3; i++) {
+			ImGui::Combo(robot_axes[i], &track.sensor_map.axes[i], axis_names);
+			ImGui::SameLine();
+			ImGui::Checkbox(mirror_names[i], &track.sensor_map.mirror[i]);
+		}
+		ImGui::DragFloat3("offset (cm)", &track.sensor_map.offset.x, 1.0f);
+		if (ImGui::Button("Reset mapping")) track.sensor_map = transform_params();
+		ImGui::TreePop();
+	}
+
+	//the robot visits points in its safe box , the operator holds the tracked hand on the tool at each one
+	//the least squares fit replaces the faux origin , gains and sensitivity in position mode
+	if (ImGui::TreeNode("Sensor to robot calibration")) {
+		extrinsic_params ext = extrinsic.get_params();
+		ImGui::Checkbox("fit scale", &ext.fit_scale);
+		ImGui::DragFloat("settle time (s)", &ext.settle_time, 0.1f, 0.0f, 10.0f);
+		ImGui::DragFloat("hold time (s)", &ext.hold_time, 0.1f, 0.2f, 10.0f);
+		ImGui::DragFloat("still radius (m)", &ext.still_radius, 0.001f, 0.002f, 0.1f);
+		ImGui::DragFloat("max fit error (mm)", &ext.max_rms, 0.5f, 1.0f, 100.0f);
+		if (!extrinsic.is_running()) extrinsic.set_params(ext);
+
+		if (extrinsic.is_running()) {
+			string point_str = "Point " + std::to_string(extrinsic.get_point_index() + 1) + " / " + std::to_string(extrinsic.get_point_count())
+				+ ": hold the tracked hand on the tool";
+			ImGui::Text(point_str.c_str());
+			ImGui::ProgressBar(extrinsic.get_progress());
+			if (ImGui::Button("Cancel robot calibration")) extrinsic.cancel();
+		}
+		else if (ImGui::Button("Start robot calibration")) {
+			vec3 box_min = vec3(-300, 250, 100);
+			vec3 box_max = vec3(300, 500, 320);
+			r1.get_safe_box(vec3(track.origin), box_min, box_max);
+			vec4 lens = r1.get_limb_lens();
+			vector<vec3> points;
+			extrinsic_calibration::make_points(box_min, box_max, 0.6f, lens.x, lens.y, kxr::KC_END_EFFECTOR_OFFSET, points);
+			extrinsic.start(points);
+			extrinsic_sent = -1;
+		}
+		if (extrinsic.is_running() && !(port_opened && send_gcode)) ImGui::TextColored(ImVec4(1, 0.6f, 0.2f, 1), "Stream gcode to move the robot");
+
+		if (!extrinsic.get_error().empty()) ImGui::Text(extrinsic.get_error().c_str());
+		if (extrinsic.is_done()) {
+			string fit_str = "Fit error " + std::to_string(extrinsic.get_rms()) + " mm over " + std::to_string(extrinsic.get_pair_count())
+				+ " points , scale " + std::to_string(extrinsic.get_scale()) + " mm per m";
+			ImGui::Text(fit_str.c_str());
+		}
+		if (has_extrinsic) ImGui::Checkbox("Use calibrated map", &track.use_extrinsic);
+		if (!extrinsic_status.empty()) ImGui::Text(extrinsic_status.c_str());
+		ImGui::TreePop();
+	}
+
 	ImGui::Text(faux_origin_string.c_str());
-	if (ImGui::Button("Set new faux origin")) set_faux_origin();
+	if (ImGui::Button("Set new faux origin")) pipeline.set_faux_origin(getElapsedSeconds());
 
 	ImGui::Text(displacement_str.c_str());
+
+	if (source) {
+		string capture_str = string(source->get_name()) + " frames: " + std::to_string(source->get_delivered()) + " delivered , "
+			+ std::to_string(source->get_dropped()) + " dropped , " + std::to_string(frames_drained) + " drained this update";
+		ImGui::Text(capture_str.c_str());
+		if (source->finished()) ImGui::Text("Source finished");
+	}
+
+	//frame sequence and timing, tells a starving sensor from a slow app
+	if (ImGui::TreeNode("Frame timing")) {
+		frame_monitor& monitor = pipeline.get_monitor();
+		const frame_stats& timing = monitor.get_stats();
+
+		string seq_str = std::to_string(timing.accepted) + " accepted , " + std::to_string(timing.duplicates) + " duplicate , "
+			+ std::to_string(timing.late) + " late , " + std::to_string(timing.missing) + " missing in " + std::to_string(timing.gaps) + " gaps";
+		string interval_str = "Sensor interval: " + std::to_string(timing.interval_ms) + " ms (jitter " + std::to_string(timing.interval_jitter_ms) + " ms)";
+		string age_str = "Frame age at use: " + std::to_string(timing.age_ms) + " ms (max " + std::to_string(timing.max_age_ms) + " ms)";
+		ImGui::Text(seq_str.c_str());
+		ImGui::Text(interval_str.c_str());
+		ImGui::Text(age_str.c_str());
+
+		float bins[FRAME_INTERVAL_BINS];
+		for (int i = 0; i < FRAME_INTERVAL_BINS; i++) bins[i] = (float)timing.histogram[i];
+		string hist_str = "0 - " + std::to_string(FRAME_INTERVAL_BINS * FRAME_INTERVAL_BIN_MS) + "+ ms";
+		ImGui::PlotHistogram("intervals", bins, FRAME_INTERVAL_BINS, 0, hist_str.c_str(), 0.0f, FLT_MAX, ImVec2(0, 60));
+
+		//frames older than one interval waited on the app , intervals well over 33 ms waited on the sensor
+		if (timing.accepted > 0) {
+			if (timing.age_ms > timing.interval_ms) ImGui::TextColored(ImVec4(1, 0.6f, 0.2f, 1), "App is slower than the sensor");
+			else if (timing.interval_ms > 50.0f) ImGui::TextColored(ImVec4(1, 0.6f, 0.2f, 1), "Sensor is starving");
+		}
+		if (ImGui::Button("Reset timing stats")) monitor.reset_stats();
+		ImGui::TreePop();
+	}
+
+	//session recording
+	if (!recorder.is_recording()) {
+		if (ImGui::Button("Start recording")) start_recording();
+		if (!recorder.get_error().empty()) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), recorder.get_error().c_str());
+	}
+	else {
+		string rec_str = "Recording " + recorder.get_path() + ": " + std::to_string(recorder.get_written()) + " frames , "
+			+ std::to_string(recorder.get_dropped()) + " dropped";
+		ImGui::Text(rec_str.c_str());
+		if (ImGui::Button("Stop recording")) recorder.stop();
+	}
+
 	int dummy = 0;	//dummy vairable
 	ImGui::ListBox("Displacement queue", &dummy, gcode_string_vector, gcode_queue_len);	//view gcode queue
 	
@@ -550,8 +883,10 @@ void KinectXRobotApp::update()
 	
 	ImGui::End();
 
+	pipeline.set_params(track);
 
-	
+	//extra arms window
+	update_arms();
 
 	//update camera parameters
 	left_cam.setEyePoint(left_eye_point);
@@ -575,9 +910,13 @@ void KinectXRobotApp::draw()
 	gl::color(Color(1, 1, 1));
 	gl::setMatrices(right_cam);
 
-	//draw robot
-	r1.draw();
-	
+	//draw robot , extra arms beside it tinted like the person they follow
+	r1.draw(Color(1, 1, 1));
+	for (size_t a = 0; a < arms.size(); a++) {
+		gl::ScopedModelMatrix scp_model;
+		gl::translate(vec3(0, 0, -ARM_DRAW_SPACING * (a + 1)));
+		arms[a]->robot.draw(Color(CM_HSV, (float)(a + 1) / (arms.size() + 1), 0.7f, 1.0f));
+	}
 
 
 	//left side of screen
@@ -616,180 +955,98 @@ void KinectXRobotApp::set_cam_def(){
 }
 
 
-//function to initialize sensor object and skeletonFrame variable
-HRESULT KinectXRobotApp::init_kinect() {
-
-	int sensor_cnt = 0;		//for number of kinects
-
-	//Checking for sensor number
-	if (NuiGetSensorCount(&sensor_cnt) < 0 || sensor_cnt < 1) {
-		OutputDebugStringA("No Kinects found\n");
-
-		//Make app quit
-		return E_FAIL;
+//function to swap the skeleton source
+bool KinectXRobotApp::open_source(int kind)
+{
+	if (source) source->stop();
+	source.reset();
+	source_kind = kind;
+
+	if (kind == SOURCE_REPLAY) {
+		replay_source* replay = new replay_source(replay_path);
+		replay->set_realtime(true);
+		replay->set_loop(true);
+		source.reset(replay);
 	}
-
-
-	//Connect to kinect found (only first one)
-	HRESULT hr = NuiCreateSensorByIndex(0, &sensor);
-
-	if (FAILED(hr)) {
-		OutputDebugStringA("Failed to connect to kinect\n");
-
-		//Return Fail
-		return E_FAIL;
+	else if (kind == SOURCE_SCRIPTED) {
+		scripted_source* scripted = new scripted_source();
+		scripted->set_realtime(true);
+		source.reset(scripted);
 	}
-	else
-		OutputDebugStringA("Kinect object created\n");
-
-
-	//Initialize kinect for skeleton tracking
-	sensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_SKELETON);
-
-	Skel_dready = CreateEvent(NULL, TRUE, FALSE, NULL);	//Check what this means after besides it creates and event handler
-
-	if (seated_tracking) {
-		sensor->NuiSkeletonTrackingEnable(Skel_dready, NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT);	//enable seated tracking
+	else source.reset(new kinect_capture());
+
+	source->set_seated(seated_tracking);
+	source->set_sensor_smoothing(sensor_smoothing);
+	if (!source->start()) {
+		source_error = source->get_error();
+		source.reset();
+		return false;
 	}
-	else
-		sensor->NuiSkeletonTrackingEnable(Skel_dready, 0);		//full body tracking only
-
-	//initialize skeleton data
-	c_skeletonFrame = { 0 };
 
-	return S_OK;
+	source_error = "";
+	return true;
 }
 
 
-//function to get new skeleton frame every after draw loop
+//function to drain the skeleton frames the source has ready
 void KinectXRobotApp::update_skeletonFrame()
 {
-
-	//get skeleton fram data
-	HRESULT hr = sensor->NuiSkeletonGetNextFrame(0, &c_skeletonFrame);
-	if (FAILED(hr)) {
-		OutputDebugStringA("Couldn't get next frame\n");
-		return;
-	}
-
-	//smoothen out skeletonframe data
-	sensor->NuiTransformSmooth(&c_skeletonFrame, 0);
-
-}
-
-
-//actually get the skeleton data
-void KinectXRobotApp::get_joint_coordinate() {
-
-	//Idea: cycle through all skeleton data, might help stabalize tracking
-	//Transfer to proper variable
-	NUI_SKELETON_DATA skeletonData = c_skeletonFrame.SkeletonData[0];
-
-	for (int i = 0; skeletonData.eTrackingState == NUI_SKELETON_NOT_TRACKED; i++) {
-		if (i >= 6) {
-			OutputDebugStringA("No skeleton tracked \n");
-			return;
+	frames_drained = 0;
+	if (!source) return;
+
+	//every frame is processed in order, the last one stays current for drawing
+	skeleton_frame frame;
+	while (source->pop(frame)) {
+		if (recorder.is_recording()) recorder.push(frame);		//never blocks, the writer has its own thread
+		frames_drained++;
+
+		//repeated and late sensor frames stop here
+		if (!pipeline.add_frame(frame)) continue;
+		for (size_t a = 0; a < arms.size(); a++) arms[a]->pipeline.add_frame(pipeline);
+
+		//calibration sees the raw joints , the result goes live as soon as the run ends
+		if (calibration.is_running() && calibration.add_frame(frame) && calibration.is_done()) {
+			pipeline.get_filter().set_params(calibration.get_result());
+			profile_status = calibration.save_profile(FILTER_PROFILE_PATH) ? "Saved " FILTER_PROFILE_PATH : "Could not save " FILTER_PROFILE_PATH;
 		}
-		else
-			skeletonData = c_skeletonFrame.SkeletonData[i];
-
-	}
-
-	if (skeletonData.eTrackingState != NUI_SKELETON_NOT_TRACKED) {
-
-		//assume that head is tracked so we get the data
-		Vector4 head_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HEAD];
-		Vector4 left_hand_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HAND_LEFT];
-		Vector4 right_hand_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HAND_RIGHT];
 
-		OutputDebugStringA("skeleton found!\n"); //MOther FuCkEr I Found it!
-
-
-
-
-		return;
+		//the tracked hand is paired with the point the robot was sent to , the map is kept for the next start
+		if (extrinsic.is_running() && pipeline.has_target() && extrinsic.add_sample(pipeline.get_sensor_target(), frame.time) && extrinsic.is_done()) {
+			extrinsic_pending = true;
+			extrinsic_status = extrinsic.save_profile(EXTRINSIC_PROFILE_PATH) ? "Saved " EXTRINSIC_PROFILE_PATH : "Could not save " EXTRINSIC_PROFILE_PATH;
+		}
 	}
-
-
 }
 
-void KinectXRobotApp::set_faux_origin()
-{
-	//Idea: cycle through all skeleton data, might help stabalize tracking
-	//Transfer to proper variable
-	NUI_SKELETON_DATA skeletonData = c_skeletonFrame.SkeletonData[0];
-
-	for (int i = 0; skeletonData.eTrackingState == NUI_SKELETON_NOT_TRACKED; i++) {
-		if (i >= 6) return;
-		else skeletonData = c_skeletonFrame.SkeletonData[i];
-	}
-
-	if (skeletonData.eTrackingState != NUI_SKELETON_NOT_TRACKED) {
 
-		//assume that head is tracked so we get the data
-		Vector4 tracked_pos = Vector4();
-		
-		Vector4 head_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HEAD];
-		Vector4 left_hand_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HAND_LEFT];
-		Vector4 right_hand_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HAND_RIGHT];
-		Vector4 left_foot_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_FOOT_LEFT];
-		Vector4 right_foot_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_FOOT_RIGHT];
-
-		switch (tracking_target) {
-			case 0:
-				tracked_pos = head_pos;
-				break;
-			case 1:
-				tracked_pos = left_hand_pos;
-				break;
-			case 2:
-				tracked_pos = right_hand_pos;
-				break;
-			case 3:
-				tracked_pos = left_foot_pos;
-				break;
-			case 4:
-				tracked_pos = right_foot_pos;
-				break;
-			default:
-				tracked_pos = left_hand_pos;
-		}
-
-		//set faux origin temporarily via hardcoding and scale to cm from raw m values
-		float scalar = 100.0f;
-		faux_origin = vec3(tracked_pos.x * scalar, tracked_pos.y * scalar, tracked_pos.z * scalar);
-
-		if (!faux_origin_set) faux_origin_set = true;
+void KinectXRobotApp::start_recording()
+{
+	char name[64];
+	time_t now = time(NULL);
+	strftime(name, sizeof(name), "session_%Y%m%d_%H%M%S.kxr", localtime(&now));
 
-		return;
-	}
+	std::error_code ec;
+	fs::create_directories(RECORDING_DIR, ec);
+	recorder.start((fs::path(RECORDING_DIR) / name).string());
 }
 
 
-
-
 //drawing some bones here
 
-void KinectXRobotApp::draw3D_bone(NUI_SKELETON_DATA skeletonData, NUI_SKELETON_POSITION_INDEX joint1, NUI_SKELETON_POSITION_INDEX joint2) {
-	NUI_SKELETON_POSITION_TRACKING_STATE q_joint1 = skeletonData.eSkeletonPositionTrackingState[joint1];
-	NUI_SKELETON_POSITION_TRACKING_STATE q_joint2 = skeletonData.eSkeletonPositionTrackingState[joint2];
-
-	vec3 joint1_pos = vec3(skeletonData.SkeletonPositions[joint1].x, skeletonData.SkeletonPositions[joint1].y, skeletonData.SkeletonPositions[joint1].z);
-	vec3 joint2_pos = vec3(skeletonData.SkeletonPositions[joint2].x, skeletonData.SkeletonPositions[joint2].y, skeletonData.SkeletonPositions[joint2].z);
+void KinectXRobotApp::draw3D_bone(const skeleton_pose& pose, int joint1, int joint2) {
+	int q_joint1 = pose.state[joint1];
+	int q_joint2 = pose.state[joint2];
 
+	//pose is already in cm
+	vec3 joint1_pos = pose.joint(joint1);
+	vec3 joint2_pos = pose.joint(joint2);
 
-	//adjust scale from m to cm
-	int scalar = 100;
-	joint1_pos = vec3(joint1_pos.x * scalar, joint1_pos.y * scalar, joint1_pos.z * scalar);
-	joint2_pos = vec3(joint2_pos.x * scalar, joint2_pos.y * scalar, joint2_pos.z * scalar);
 
-
-
-	if (q_joint1 == NUI_SKELETON_POSITION_INFERRED || q_joint2 == NUI_SKELETON_POSITION_INFERRED) {
+	if (q_joint1 == SKEL_INFERRED || q_joint2 == SKEL_INFERRED) {
 		gl::lineWidth(1);
 		gl::drawLine(joint1_pos, joint2_pos);
 	}
-	else if (q_joint1 == NUI_SKELETON_POSITION_TRACKED && q_joint2 == NUI_SKELETON_POSITION_TRACKED) {
+	else if (q_joint1 == SKEL_TRACKED && q_joint2 == SKEL_TRACKED) {
 		gl::lineWidth(10);
 		gl::drawLine(joint1_pos, joint2_pos);
 		//reset line width
@@ -803,115 +1060,136 @@ void KinectXRobotApp::draw3D_bone(NUI_SKELETON_DATA skeletonData, NUI_SKELETON_P
 
 void KinectXRobotApp::draw_skeleton() {
 
+	//people driving the extra arms , one colour each
+	for (size_t a = 0; a < arms.size(); a++) {
+		const skeleton_pose& arm_pose = arms[a]->pipeline.get_pose();
+		if (!arm_pose.valid) continue;
+		gl::color(Color(CM_HSV, (float)(a + 1) / (arms.size() + 1), 0.7f, 1.0f));
+		for (int i = 0; i < SKEL_BONE_COUNT; i++)
+			draw3D_bone(arm_pose, SKEL_BONES[i][0], SKEL_BONES[i][1]);
+	}
+	gl::color(Color(1, 1, 1));
 
-	//Idea: cycle through all skeleton data, might help stabalize tracking
-	//Transfer to proper variable
-	NUI_SKELETON_DATA skeletonData = c_skeletonFrame.SkeletonData[0];
-
-	for (int i = 0; skeletonData.eTrackingState == NUI_SKELETON_NOT_TRACKED; i++) {
-		if (i >= 6) {
-			OutputDebugStringA("No skeleton tracked \n");
-			return;
-		}
-		else
-			skeletonData = c_skeletonFrame.SkeletonData[i];
-
-	}
-
-	//draw vector from faux_origin to tracked target (temporarily left hand) if faux origin has been set
-	if (faux_origin_set) {
-		//get trackig target
-
-		Vector4 tracked_pos = Vector4();
-
-		Vector4 head_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HEAD];
-		Vector4 left_hand_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HAND_LEFT];
-		Vector4 right_hand_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_HAND_RIGHT];
-		Vector4 left_foot_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_FOOT_LEFT];
-		Vector4 right_foot_pos = skeletonData.SkeletonPositions[NUI_SKELETON_POSITION_FOOT_RIGHT];
-
-		switch (tracking_target) {
-		case 0:
-			tracked_pos = head_pos;
-			break;
-		case 1:
-			tracked_pos = left_hand_pos;
-			break;
-		case 2:
-			tracked_pos = right_hand_pos;
-			break;
-		case 3:
-			tracked_pos = left_foot_pos;
-			break;
-		case 4:
-			tracked_pos = right_foot_pos;
-			break;
-		default:
-			tracked_pos = left_hand_pos;
-		}
-
-		float scalar = 100.0f;	//convert from m to cm
-		vec3 target_pos = vec3(tracked_pos.x * scalar, tracked_pos.y * scalar , tracked_pos.z * scalar);
-		
+	//body the pipeline follows in the last frame
+	const skeleton_pose& pose = pipeline.get_pose();
+	if (!pose.valid) return;
 
+	//draw vector from faux_origin to tracked target if faux origin has been set
+	if (pipeline.is_faux_origin_set() && pipeline.has_target()) {
 		//assume faux_origin has been set and scaled properly
 		gl::color(Color(1, 0, 0));
 		gl::lineWidth(8);
-		gl::drawLine(faux_origin, target_pos);
+		gl::drawLine(pipeline.get_faux_origin(), pipeline.get_target_pos());
 		gl::color(Color(1, 1, 1));
+	}
+
+	//Draw bones here (3D render mode)
+	for (int i = 0; i < SKEL_BONE_COUNT; i++)
+		draw3D_bone(pose, SKEL_BONES[i][0], SKEL_BONES[i][1]);
+
+}
+
 
-		//calculate and record displacement to be applied to robot
-		if (apply_displacement) {
-			displacement = target_pos - faux_origin;
+//extra arms: who each one follows , its own port and G1 stream
+void KinectXRobotApp::update_arms()
+{
+	ImGui::Begin("Arms");
+
+	if (ImGui::Button("Add arm")) {
+		arms.emplace_back(new arm_link());
+		arm_link& arm = *arms.back();
+
+		//same settings as the main arm, following the first person in view nobody else follows
+		pipeline_params arm_track = pipeline.get_params();
+		arm_track.person = 0;
+		arm_track.apply_displacement = false;
+		arm_track.use_extrinsic = false;		//the sensor to robot map was measured for the main robot only
+		arm_track.extrinsic = mat4(1.0f);
+		const body_tracker& people = pipeline.get_people();
+		for (int i = 0; i < people.get_count() && arm_track.person == 0; i++) {
+			uint32_t candidate = people.get(i).person;
+			bool taken = people.get(i).slot < 0 || candidate == pipeline.get_following();
+			for (size_t a = 0; a + 1 < arms.size(); a++) taken = taken || candidate == arms[a]->pipeline.get_following();
+			if (!taken) arm_track.person = candidate;
 		}
-		
+		arm.pipeline.set_params(arm_track);
+		arm.pipeline.set_dest(vec4(arm_track.home_point, 0));
+		arm.robot.set_dest(arm.pipeline.get_dest());
 	}
-	//Draw bones here
-
-	//3D render mode
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_HEAD, NUI_SKELETON_POSITION_SHOULDER_CENTER);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SHOULDER_LEFT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SHOULDER_RIGHT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SPINE);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_SPINE, NUI_SKELETON_POSITION_HIP_CENTER);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_HIP_CENTER, NUI_SKELETON_POSITION_HIP_LEFT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_HIP_CENTER, NUI_SKELETON_POSITION_HIP_RIGHT);
-
-	// Left Arm
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_SHOULDER_LEFT, NUI_SKELETON_POSITION_ELBOW_LEFT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_ELBOW_LEFT, NUI_SKELETON_POSITION_WRIST_LEFT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_WRIST_LEFT, NUI_SKELETON_POSITION_HAND_LEFT);
-
-	// Right Arm
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_SHOULDER_RIGHT, NUI_SKELETON_POSITION_ELBOW_RIGHT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_ELBOW_RIGHT, NUI_SKELETON_POSITION_WRIST_RIGHT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_WRIST_RIGHT, NUI_SKELETON_POSITION_HAND_RIGHT);
-
-	// Left Leg
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_HIP_LEFT, NUI_SKELETON_POSITION_KNEE_LEFT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_KNEE_LEFT, NUI_SKELETON_POSITION_ANKLE_LEFT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_ANKLE_LEFT, NUI_SKELETON_POSITION_FOOT_LEFT);
-
-	// Right Leg
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_HIP_RIGHT, NUI_SKELETON_POSITION_KNEE_RIGHT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_KNEE_RIGHT, NUI_SKELETON_POSITION_ANKLE_RIGHT);
-	draw3D_bone(skeletonData, NUI_SKELETON_POSITION_ANKLE_RIGHT, NUI_SKELETON_POSITION_FOOT_RIGHT);
 
-}
+	std::vector<std::string> tracking_targets;
+	for (int i = 0; i < TRACK_TARGET_COUNT; i++) tracking_targets.push_back(tracking_pipeline::get_target_name(i));
+
+	int removed = -1;
+	for (size_t a = 0; a < arms.size(); a++) {
+		arm_link& arm = *arms[a];
+		string arm_name = "Arm " + std::to_string(a + 2);
+
+		ImGui::PushID((int)a);
+		if (ImGui::TreeNode(arm_name.c_str())) {
+			pipeline_params arm_track = arm.pipeline.get_params();
+			ImGui::InputScalar("person", ImGuiDataType_U32, &arm_track.person, &Person_incre);
+			ImGui::Combo("Tracking target", &arm_track.tracking_target, tracking_targets);
+			ImGui::Checkbox("Apply displacement vector", &arm_track.apply_displacement);
+			if (ImGui::Button("Set faux origin")) arm.pipeline.set_faux_origin(getElapsedSeconds());
+			ImGui::InputScalar("Initial X pos.", ImGuiDataType_S32, &arm_track.origin.x, &Origin_incre);
+			ImGui::InputScalar("Initial Y pos.", ImGuiDataType_S32, &arm_track.origin.y, &Origin_incre);
+			ImGui::InputScalar("Initial Z pos.", ImGuiDataType_S32, &arm_track.origin.z, &Origin_incre);
+			arm.pipeline.set_params(arm_track);
+
+			vec4 angles = arm.robot.get_angles();
+			string follow_str = arm.pipeline.get_pose().valid ? "Following person " + std::to_string(arm.pipeline.get_following()) : "Person not in view";
+			string angles_str = "Angles: " + std::to_string(angles.x) + " , " + std::to_string(angles.y) + " , " + std::to_string(angles.z) + " , "
+				+ std::to_string(angles.w);
+			ImGui::Text(follow_str.c_str());
+			ImGui::Text(angles_str.c_str());
+
+			//own serial link
+			if (!arm.port_opened) {
+				ImGui::InputText("port", arm.port_name, sizeof(arm.port_name), ImGuiInputTextFlags_CharsUppercase | ImGuiInputTextFlags_CharsNoBlank);
+				if (ImGui::Button("Open port")) {
+					arm.port_opened = arm.port.open(arm.port_name) != -1;
+					arm.port_failed = !arm.port_opened;
+				}
+				if (arm.port_failed) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "Could not open port. Please try again");
+			}
+			else {
+				ImGui::Checkbox("Stream gcode", &arm.send_gcode);
+				ImGui::Text(arm.pipeline.get_gcode());
+				if (ImGui::Button("Close port connection")) {
+					arm.port.close();
+					arm.port_opened = false;
+					arm.send_gcode = false;
+				}
+			}
+
+			if (ImGui::Button("Remove arm")) removed = (int)a;
+			ImGui::TreePop();
+		}
+		ImGui::PopID();
+	}
 
+	if (removed >= 0) {
+		if (arms[removed]->port_opened) arms[removed]->port.close();
+		arms.erase(arms.begin() + removed);
+	}
+
+	ImGui::End();
+}
 
 //handle resources
 void KinectXRobotApp::cleanup() {
-	//Clean up
-	if (!FAILED(this->hr)) {
-		sensor->Release();			//Release sensor (might cause some detection errors if not)
-		CloseHandle(Skel_dready);	//Close handle
-		OutputDebugStringA("Kinect cleaned up\n");
-	}
+	//Clean up (joins the capture thread and releases the sensor)
+	if (source) source->stop();
+
+	//finish the recording so it gets its index
+	recorder.stop();
 
 	//Close port if opened
 	if (port_opened == true)
 		s1.close();
+	for (size_t a = 0; a < arms.size(); a++)
+		if (arms[a]->port_opened) arms[a]->port.close();
 }
 
 
@@ -0,0 +1,163 @@
+#include "body_tracker.h"
+
+//joint that stands for where a body is
+#define TRACKER_CENTER_JOINT SKEL_SPINE
+
+tracker_params::tracker_params() {
+    hold_time = 1.0f;
+    max_jump = 0.4f;
+}
+
+body_tracker::body_tracker() {
+    reset();
+}
+
+void body_tracker::set_params(const tracker_params& params)
+{
+    this->params = params;
+}
+
+const tracker_params& body_tracker::get_params() const
+{
+    return params;
+}
+
+void body_tracker::reset()
+{
+    count = 0;
+    next_person = 1;
+    last_time = 0;
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) slot_person[b] = 0;
+}
+
+void body_tracker::update(const skeleton_frame& frame)
+{
+    //source started over , nobody carries over
+    if (frame.time < last_time) count = 0;
+    last_time = frame.time;
+
+    //forget people lost for too long , keep the rest in order of arrival
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (people[i].slot < 0 && frame.time - people[i].last_seen > params.hold_time) continue;
+        people[kept] = people[i];
+        people[kept].slot = -1;
+        kept++;
+    }
+    count = kept;
+
+    bool claimed[SKEL_BODY_COUNT];
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        claimed[b] = !frame.bodies[b].tracked;
+        slot_person[b] = 0;
+    }
+
+    //same sensor tracking id , same person
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        if (claimed[b]) continue;
+        for (int i = 0; i < count; i++) {
+            if (people[i].slot < 0 && people[i].id == frame.bodies[b].id) {
+                assign(people[i], frame.bodies[b], b, frame.time);
+                claimed[b] = true;
+                break;
+            }
+        }
+    }
+
+    //new tracking ids near where somebody was lost take that identity back , closest pair first
+    for (;;) {
+        int best_b = -1, best_i = -1;
+        float best = params.max_jump * params.max_jump;
+        for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+            if (claimed[b]) continue;
+            vec3 center = frame.bodies[b].joints[TRACKER_CENTER_JOINT];
+            for (int i = 0; i < count; i++) {
+                if (people[i].slot >= 0) continue;
+                vec3 d = center - people[i].center;
+                float d2 = dot(d, d);
+                if (d2 < best) {
+                    best = d2;
+                    best_b = b;
+                    best_i = i;
+                }
+            }
+        }
+        if (best_b < 0) break;
+        assign(people[best_i], frame.bodies[best_b], best_b, frame.time);
+        claimed[best_b] = true;
+    }
+
+    //everyone else just walked in
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        if (claimed[b]) continue;
+
+        //full: the person lost the longest makes room
+        if (count == TRACKER_MAX_PEOPLE) {
+            int oldest = -1;
+            for (int i = 0; i < count; i++)
+                if (people[i].slot < 0 && (oldest < 0 || people[i].last_seen < people[oldest].last_seen)) oldest = i;
+            if (oldest < 0) break;
+            for (int i = oldest; i + 1 < count; i++) people[i] = people[i + 1];
+            count--;
+        }
+
+        tracked_person& person = people[count++];
+        person.person = next_person++;
+        person.first_seen = frame.time;
+        assign(person, frame.bodies[b], b, frame.time);
+    }
+}
+
+void body_tracker::assign(tracked_person& person, const skeleton_body& body, int slot, double time)
+{
+    person.id = body.id;
+    person.slot = slot;
+    person.center = body.joints[TRACKER_CENTER_JOINT];
+    person.last_seen = time;
+    slot_person[slot] = person.person;
+}
+
+uint32_t body_tracker::get_person(int slot) const
+{
+    if (slot < 0 || slot >= SKEL_BODY_COUNT) return 0;
+    return slot_person[slot];
+}
+
+int body_tracker::find_slot(uint32_t person) const
+{
+    if (person == 0) return -1;
+    for (int i = 0; i < count; i++)
+        if (people[i].person == person) return people[i].slot;
+    return -1;
+}
+
+bool body_tracker::is_known(uint32_t person) const
+{
+    if (person == 0) return false;
+    for (int i = 0; i < count; i++)
+        if (people[i].person == person) return true;
+    return false;
+}
+
+uint32_t body_tracker::get_first() const
+{
+    //people are kept in order of arrival
+    for (int i = 0; i < count; i++)
+        if (people[i].slot >= 0) return people[i].person;
+    return 0;
+}
+
+int body_tracker::get_count() const
+{
+    return count;
+}
+
+const tracked_person& body_tracker::get(int i) const
+{
+    return people[i];
+}
+
+uint32_t body_tracker::get_total() const
+{
+    return next_person - 1;
+}
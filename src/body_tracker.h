@@ -0,0 +1,68 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+
+#include "skeleton_frame.h"
+
+using namespace ci;
+
+//people remembered at once: everyone in view plus the ones briefly lost
+#define TRACKER_MAX_PEOPLE (2 * SKEL_BODY_COUNT)
+
+struct tracker_params {
+	float hold_time;			//seconds a lost person keeps their identity
+	float max_jump;				//m, how far from where they were lost a body may reappear and still be the same person
+
+	tracker_params();
+};
+
+//one identity
+struct tracked_person {
+	uint32_t person;			//stable id , 1 for the first person seen after reset
+	uint32_t id;				//sensor tracking id last seen with
+	int slot;					//skeleton_frame::bodies index in the last frame , -1 while lost
+	vec3 center;				//spine joint last seen (sensor frame , m)
+	double first_seen;
+	double last_seen;
+};
+
+//Stable identities for every tracked body
+//The sensor tracking id carries a person from frame to frame , when it is lost (the sensor drops a body for a few frames
+//and brings it back under a new id , often in another slot) the body that reappears nearest to where a lost person was
+//takes that identity back. People lost for longer than hold_time are forgotten
+//All slots are matched every frame , at most SKEL_BODY_COUNT x TRACKER_MAX_PEOPLE distance checks
+class body_tracker
+{
+	public:
+
+		body_tracker();
+
+		void set_params(const tracker_params& params);
+		const tracker_params& get_params() const;
+
+		void reset();								//forget everyone , numbering starts over
+
+		void update(const skeleton_frame& frame);	//frames must come in order
+
+		uint32_t get_person(int slot) const;		//person tracked in slot in the last frame , 0 if none
+		int find_slot(uint32_t person) const;		//slot of person in the last frame , -1 if not in view
+		bool is_known(uint32_t person) const;		//in view or lost for less than hold_time
+		uint32_t get_first() const;					//person in view that has been known longest , 0 if nobody is in view
+
+		int get_count() const;						//people known (in view or held)
+		const tracked_person& get(int i) const;		//i < get_count() , in order of arrival
+		uint32_t get_total() const;					//identities handed out since reset
+
+	private:
+
+		tracker_params params;
+
+		tracked_person people[TRACKER_MAX_PEOPLE];
+		int count;
+		uint32_t next_person;
+		uint32_t slot_person[SKEL_BODY_COUNT];
+		double last_time;
+
+		void assign(tracked_person& person, const skeleton_body& body, int slot, double time);
+};
@@ -0,0 +1,177 @@
+#include "bone_constraint.h"
+
+#include <algorithm>
+#include <math.h>
+
+//chains from the pinned shoulder center out to the hands, in projection order
+const int ARM_BONES[ARM_BONE_COUNT][2] = {
+    { SKEL_SHOULDER_CENTER, SKEL_SHOULDER_LEFT },
+    { SKEL_SHOULDER_LEFT, SKEL_ELBOW_LEFT },
+    { SKEL_ELBOW_LEFT, SKEL_WRIST_LEFT },
+    { SKEL_WRIST_LEFT, SKEL_HAND_LEFT },
+
+    { SKEL_SHOULDER_CENTER, SKEL_SHOULDER_RIGHT },
+    { SKEL_SHOULDER_RIGHT, SKEL_ELBOW_RIGHT },
+    { SKEL_ELBOW_RIGHT, SKEL_WRIST_RIGHT },
+    { SKEL_WRIST_RIGHT, SKEL_HAND_RIGHT }
+};
+
+//weight of the newest frame in the correction average
+static const float BONE_STATS_SMOOTHING = 0.05f;
+
+//bones shorter than this (m) are measurement garbage (joints collapsed onto each other)
+static const float BONE_MIN_LENGTH = 0.01f;
+
+bone_params::bone_params() {
+    enabled = false;
+    learn_time = 3.0f;
+    iterations = 3;
+    inferred_mobility = 4.0f;
+}
+
+bone_constraint::bone_constraint() {
+    reset();
+}
+
+void bone_constraint::set_params(const bone_params& params)
+{
+    this->params = params;
+}
+
+const bone_params& bone_constraint::get_params() const
+{
+    return params;
+}
+
+void bone_constraint::reset()
+{
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        bodies[b].tracked = false;
+        bodies[b].id = 0;
+        bodies[b].start = 0;
+        bodies[b].learned = false;
+        for (int i = 0; i < ARM_BONE_COUNT; i++) {
+            bodies[b].lengths[i] = 0;
+            bodies[b].samples[i].clear();
+        }
+    }
+    stats.learned = 0;
+    stats.learning = 0;
+    stats.correction_mm = 0;
+}
+
+void bone_constraint::apply(skeleton_frame& frame)
+{
+    int learned = 0, learning = 0;
+    float correction = 0;
+    int corrected = 0;
+
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        skeleton_body& body = frame.bodies[b];
+        body_state& state = bodies[b];
+
+        if (!body.tracked) {
+            state.tracked = false;
+            continue;
+        }
+
+        //somebody new in this slot, measure them from scratch
+        if (!state.tracked || state.id != body.id) {
+            state.tracked = true;
+            state.id = body.id;
+            state.start = frame.time;
+            state.learned = false;
+            for (int i = 0; i < ARM_BONE_COUNT; i++) state.samples[i].clear();
+        }
+
+        if (!state.learned) {
+            learn(state, body, frame.time);
+            if (!state.learned) {
+                learning++;
+                continue;
+            }
+        }
+        learned++;
+
+        if (params.enabled) {
+            correction += project(state, body);
+            corrected++;
+        }
+    }
+
+    stats.learned = learned;
+    stats.learning = learning;
+    if (corrected) stats.correction_mm += BONE_STATS_SMOOTHING * (correction / corrected * 1000.0f - stats.correction_mm);
+}
+
+const bone_stats& bone_constraint::get_stats() const
+{
+    return stats;
+}
+
+bool bone_constraint::get_lengths(int slot, float lengths[ARM_BONE_COUNT]) const
+{
+    if (slot < 0 || slot >= SKEL_BODY_COUNT || !bodies[slot].tracked || !bodies[slot].learned) return false;
+    for (int i = 0; i < ARM_BONE_COUNT; i++) lengths[i] = bodies[slot].lengths[i];
+    return true;
+}
+
+void bone_constraint::learn(body_state& state, const skeleton_body& body, double time)
+{
+    //only bones with both ends really seen count
+    for (int i = 0; i < ARM_BONE_COUNT; i++) {
+        int a = ARM_BONES[i][0], c = ARM_BONES[i][1];
+        if (body.state[a] != SKEL_TRACKED || body.state[c] != SKEL_TRACKED) continue;
+        float len = distance(body.joints[a], body.joints[c]);
+        if (len > BONE_MIN_LENGTH) state.samples[i].push_back(len);
+    }
+
+    if (time - state.start < params.learn_time) return;
+
+    //median per bone, a bone never seen keeps learning
+    for (int i = 0; i < ARM_BONE_COUNT; i++)
+        if (state.samples[i].empty()) return;
+
+    for (int i = 0; i < ARM_BONE_COUNT; i++) {
+        vector<float>& samples = state.samples[i];
+        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+        state.lengths[i] = samples[samples.size() / 2];
+        samples.clear();
+        samples.shrink_to_fit();
+    }
+    state.learned = true;
+}
+
+float bone_constraint::project(const body_state& state, skeleton_body& body) const
+{
+    //how freely each joint moves: the shoulder center is pinned , inferred joints are trusted less than tracked ones
+    float mobility[SKEL_JOINT_COUNT];
+    vec3 before[SKEL_JOINT_COUNT];
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        mobility[j] = body.state[j] == SKEL_TRACKED ? 1.0f : params.inferred_mobility;
+        before[j] = body.joints[j];
+    }
+    mobility[SKEL_SHOULDER_CENTER] = 0;
+
+    for (int it = 0; it < params.iterations; it++) {
+        for (int i = 0; i < ARM_BONE_COUNT; i++) {
+            int a = ARM_BONES[i][0], c = ARM_BONES[i][1];
+            if (body.state[a] == SKEL_NOT_TRACKED || body.state[c] == SKEL_NOT_TRACKED) continue;
+
+            vec3 d = body.joints[c] - body.joints[a];
+            float len = length(d);
+            float w = mobility[a] + mobility[c];
+            if (len < BONE_MIN_LENGTH || w <= 0) continue;
+
+            //move both ends along the bone until it has its learned length , split by mobility
+            vec3 fix = d * ((len - state.lengths[i]) / (len * w));
+            body.joints[a] += fix * mobility[a];
+            body.joints[c] -= fix * mobility[c];
+        }
+    }
+
+    //average move of the arm joints
+    float moved = 0;
+    for (int i = 0; i < ARM_BONE_COUNT; i++) moved += distance(body.joints[ARM_BONES[i][1]], before[ARM_BONES[i][1]]);
+    return moved / ARM_BONE_COUNT;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "skeleton_frame.h"
+
+using namespace std;
+
+//arm bones the constraint holds at fixed length, shoulder center out to each hand
+#define ARM_BONE_COUNT 8
+extern const int ARM_BONES[ARM_BONE_COUNT][2];
+
+struct bone_params {
+	bool enabled;
+	float learn_time;			//seconds of tracking used to measure the bone lengths of a new person
+	int iterations;				//projection passes per frame
+	float inferred_mobility;	//how much more an inferred joint moves than a tracked one during projection
+
+	bone_params();
+};
+
+struct bone_stats {
+	int learned;				//bodies with learned lengths
+	int learning;				//bodies still being measured
+	float correction_mm;		//average distance a joint was moved by the projection
+};
+
+//Rigid arm cleanup ahead of the joint filter
+//For every newly tracked person the arm bone lengths are measured (median over learn_time) from joints that are both tracked,
+//after that each frame's arm chains are projected back onto those lengths in a few fixed passes
+//The shoulder center stays put , the rest of the chain moves the least it can to restore the lengths,
+//which removes the part of the sensor noise that stretches or shrinks the arm
+class bone_constraint
+{
+	public:
+
+		bone_constraint();
+
+		void set_params(const bone_params& params);
+		const bone_params& get_params() const;
+
+		void reset();							//forget every learned person
+
+		void apply(skeleton_frame& frame);		//frames must come in order
+
+		const bone_stats& get_stats() const;
+
+		//learned lengths (m) of the body in slot , false while it is still being measured
+		bool get_lengths(int slot, float lengths[ARM_BONE_COUNT]) const;
+
+	private:
+
+		struct body_state {
+			bool tracked;
+			uint32_t id;
+			double start;						//time tracking of this person started
+			bool learned;
+			float lengths[ARM_BONE_COUNT];
+			vector<float> samples[ARM_BONE_COUNT];
+		};
+
+		bone_params params;
+		body_state bodies[SKEL_BODY_COUNT];
+		bone_stats stats;
+
+		void learn(body_state& state, const skeleton_body& body, double time);
+		float project(const body_state& state, skeleton_body& body) const;
+};
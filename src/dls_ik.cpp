@@ -0,0 +1,210 @@
+#include "dls_ik.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <math.h>
+
+dls_chain::dls_chain() {
+    base = mat4(1.0f);
+    tool = mat4(1.0f);
+    tool_axis = vec3(0, 1, 0);
+    count = 0;
+}
+
+bool dls_chain::add_joint(dls_joint_type type, const mat4& offset, vec3 axis, float min_val, float max_val)
+{
+    if (count >= DLS_MAX_JOINTS) return false;
+
+    dls_joint& j = joints[count++];
+    j.type = type;
+    j.offset = offset;
+    j.axis = normalize(axis);
+    j.min_val = min_val;
+    j.max_val = max_val;
+    return true;
+}
+
+dls_params::dls_params() {
+    damping = 2.0f;
+    tolerance = 0.5f;
+    max_iterations = 8;
+    max_step = 10.0f;
+    tool_weight = 0.0f;
+}
+
+dls_ik::dls_ik() {
+    for (int i = 0; i < DLS_MAX_JOINTS; i++) q[i] = 0;
+    error = 0;
+    iterations = 0;
+}
+
+void dls_ik::set_chain(const dls_chain& chain)
+{
+    this->chain = chain;
+    for (int i = 0; i < chain.count; i++)
+        q[i] = clamp(q[i], chain.joints[i].min_val, chain.joints[i].max_val);
+}
+
+void dls_ik::set_params(const dls_params& params)
+{
+    this->params = params;
+}
+
+const dls_params& dls_ik::get_params() const
+{
+    return params;
+}
+
+void dls_ik::seed(const float* q)
+{
+    for (int i = 0; i < chain.count; i++)
+        this->q[i] = clamp(q[i], chain.joints[i].min_val, chain.joints[i].max_val);
+}
+
+const float* dls_ik::get_solution() const
+{
+    return q;
+}
+
+float dls_ik::get_error() const
+{
+    return error;
+}
+
+int dls_ik::get_iterations() const
+{
+    return iterations;
+}
+
+void dls_ik::joint_frames(const float* q, vec3* origins, vec3* axes, mat4& tool_pose) const
+{
+    mat4 m = chain.base;
+    for (int i = 0; i < chain.count; i++) {
+        const dls_joint& j = chain.joints[i];
+        m = m * j.offset;
+
+        origins[i] = vec3(m[3]);
+        axes[i] = normalize(vec3(m * vec4(j.axis, 0)));
+
+        if (j.type == DLS_REVOLUTE) m = glm::rotate(m, toRadians(q[i]), j.axis);
+        else m = glm::translate(m, j.axis * q[i]);
+    }
+    tool_pose = m * chain.tool;
+}
+
+mat4 dls_ik::forward(const float* q) const
+{
+    vec3 origins[DLS_MAX_JOINTS];
+    vec3 axes[DLS_MAX_JOINTS];
+    mat4 tool_pose;
+    joint_frames(q, origins, axes, tool_pose);
+    return tool_pose;
+}
+
+bool dls_ik::solve(vec3 target, vec3 tool_dir)
+{
+    const int n = chain.count;
+    const int rows = params.tool_weight > 0 ? 6 : 3;
+    const float deg = (float)(M_PI / 180.0);
+    const float w = params.tool_weight;
+
+    vec3 origins[DLS_MAX_JOINTS];
+    vec3 axes[DLS_MAX_JOINTS];
+    mat4 tool_pose;
+
+    float jac[DLS_MAX_ROWS][DLS_MAX_JOINTS];
+    float a[DLS_MAX_ROWS][DLS_MAX_ROWS];
+    float e[DLS_MAX_ROWS];
+    float y[DLS_MAX_ROWS];
+
+    if (w > 0) tool_dir = normalize(tool_dir);
+
+    iterations = 0;
+    for (;;) {
+        joint_frames(q, origins, axes, tool_pose);
+        vec3 tip = vec3(tool_pose[3]);
+        vec3 dir = normalize(vec3(tool_pose * vec4(chain.tool_axis, 0)));
+
+        //task error
+        vec3 e_pos = target - tip;
+        error = length(e_pos);
+        e[0] = e_pos.x;
+        e[1] = e_pos.y;
+        e[2] = e_pos.z;
+        if (rows == 6) {
+            vec3 e_dir = (tool_dir - dir) * w;
+            e[3] = e_dir.x;
+            e[4] = e_dir.y;
+            e[5] = e_dir.z;
+        }
+
+        if (error <= params.tolerance || iterations >= params.max_iterations) break;
+        iterations++;
+
+        //geometric jacobian, revolute columns per degree so dq comes out in joint units
+        for (int i = 0; i < n; i++) {
+            vec3 dp, dd;
+            if (chain.joints[i].type == DLS_REVOLUTE) {
+                dp = cross(axes[i], tip - origins[i]) * deg;
+                dd = cross(axes[i], dir) * (deg * w);
+            }
+            else {
+                dp = axes[i];
+                dd = vec3(0);
+            }
+            jac[0][i] = dp.x;
+            jac[1][i] = dp.y;
+            jac[2][i] = dp.z;
+            if (rows == 6) {
+                jac[3][i] = dd.x;
+                jac[4][i] = dd.y;
+                jac[5][i] = dd.z;
+            }
+        }
+
+        //A = J J^T + lambda^2 I (symmetric positive definite)
+        float lambda_sqrd = params.damping * params.damping;
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c <= r; c++) {
+                float sum = 0;
+                for (int i = 0; i < n; i++) sum += jac[r][i] * jac[c][i];
+                a[r][c] = sum;
+                a[c][r] = sum;
+            }
+            a[r][r] += lambda_sqrd;
+        }
+
+        //solve A y = e with an in place Cholesky factorization (lower triangle)
+        for (int c = 0; c < rows; c++) {
+            float d = a[c][c];
+            for (int k = 0; k < c; k++) d -= a[c][k] * a[c][k];
+            d = sqrt(std::max(d, 1e-12f));
+            a[c][c] = d;
+            for (int r = c + 1; r < rows; r++) {
+                float s = a[r][c];
+                for (int k = 0; k < c; k++) s -= a[r][k] * a[c][k];
+                a[r][c] = s / d;
+            }
+        }
+        for (int r = 0; r < rows; r++) {
+            float s = e[r];
+            for (int k = 0; k < r; k++) s -= a[r][k] * y[k];
+            y[r] = s / a[r][r];
+        }
+        for (int r = rows - 1; r >= 0; r--) {
+            float s = y[r];
+            for (int k = r + 1; k < rows; k++) s -= a[k][r] * y[k];
+            y[r] = s / a[r][r];
+        }
+
+        //dq = J^T y, limited per iteration and clamped to the joint limits
+        for (int i = 0; i < n; i++) {
+            float dq = 0;
+            for (int r = 0; r < rows; r++) dq += jac[r][i] * y[r];
+            dq = clamp(dq, -params.max_step, params.max_step);
+            q[i] = clamp(q[i] + dq, chain.joints[i].min_val, chain.joints[i].max_val);
+        }
+    }
+
+    return error <= params.tolerance;
+}
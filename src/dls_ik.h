@@ -0,0 +1,85 @@
+#pragma once
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+
+using namespace ci;
+
+//maximum number of joints in a chain (fixed so the solver never allocates)
+#define DLS_MAX_JOINTS 8
+
+//task rows: 3 for position + 3 for tool direction
+#define DLS_MAX_ROWS 6
+
+enum dls_joint_type {
+	DLS_REVOLUTE = 0,	//value in degrees, rotates abt axis
+	DLS_PRISMATIC		//value in milimeters, translates along axis
+};
+
+struct dls_joint {
+	dls_joint_type type;
+	mat4 offset;		//fixed transform from the previous joint frame, applied before this joint moves
+	vec3 axis;			//local axis of motion (unit length)
+	float min_val;		//joint limits (degrees or milimeters)
+	float max_val;
+};
+
+//Serial chain description: base -> joint[0] -> ... -> joint[count-1] -> tool
+struct dls_chain {
+	mat4 base;			//world transform of the chain root
+	dls_joint joints[DLS_MAX_JOINTS];
+	int count;
+	mat4 tool;			//fixed transform from the last joint frame to the tool tip
+	vec3 tool_axis;		//local tool direction used for the orientation task
+
+	dls_chain();
+	bool add_joint(dls_joint_type type, const mat4& offset, vec3 axis, float min_val, float max_val);	//false if chain is full
+};
+
+struct dls_params {
+	float damping;			//lambda (milimeters per degree of joint motion), larger = smoother near singularities but slower convergence
+	float tolerance;		//stop once position error is below this (milimeters)
+	int max_iterations;		//iteration budget per solve call
+	float max_step;			//max change of a joint per iteration (degrees or milimeters)
+	float tool_weight;		//milimeters per unit of tool direction error, 0 disables the orientation task
+
+	dls_params();
+};
+
+//Damped least squares IK: dq = J^T (J J^T + lambda^2 I)^-1 e
+//Warm started: every solve continues from the previous solution so consecutive targets converge in a few iterations
+class dls_ik
+{
+	public:
+
+		dls_ik();
+
+		void set_chain(const dls_chain& chain);		//also clamps the current solution into the new limits
+		void set_params(const dls_params& params);
+		const dls_params& get_params() const;
+
+		void seed(const float* q);					//overwrite warm start with count joint values
+
+		//run up to max_iterations toward target (world) with desired tool direction (world, ignored if tool_weight is 0)
+		//returns true if the position error is within tolerance
+		bool solve(vec3 target, vec3 tool_dir);
+
+		const float* get_solution() const;			//count joint values (degrees or milimeters)
+		float get_error() const;					//position error after last solve (milimeters)
+		int get_iterations() const;					//iterations used by last solve
+
+		//forward kinematics of the chain for joint values q, returns tool transform
+		mat4 forward(const float* q) const;
+
+	private:
+
+		dls_chain chain;
+		dls_params params;
+
+		float q[DLS_MAX_JOINTS];
+		float error;
+		int iterations;
+
+		//world position and axis of every joint plus tool pose for the current q
+		void joint_frames(const float* q, vec3* origins, vec3* axes, mat4& tool_pose) const;
+};
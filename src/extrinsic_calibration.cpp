@@ -0,0 +1,417 @@
+#include "extrinsic_calibration.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+
+//profile file header
+static const char* EXTRINSIC_PROFILE_MAGIC = "KXREXTRINSIC";
+static const int EXTRINSIC_PROFILE_VERSION = 1;
+
+//hand samples averaged into one captured point at the least
+static const uint32_t EXTRINSIC_MIN_HOLD_SAMPLES = 5;
+
+//hand positions spread along one line (second spread over the first) can not fix a rotation
+static const double EXTRINSIC_MIN_SPREAD = 1e-4;
+
+//jacobi sweeps before giving up on the eigen decomposition
+static const int EXTRINSIC_MAX_SWEEPS = 50;
+
+extrinsic_params::extrinsic_params() {
+    fit_scale = true;
+    unit_scale = 1000.0f;
+    settle_time = 2.0f;
+    hold_time = 1.0f;
+    still_radius = 0.01f;
+    max_rms = 15.0f;
+}
+
+extrinsic_calibration::extrinsic_calibration() {
+    running = false;
+    done = false;
+    point = 0;
+    sent = false;
+    point_time = -1;
+    hold_start = 0;
+    hold_anchor = vec3(0);
+    hold_sum = dvec3(0);
+    hold_samples = 0;
+    progress = 0;
+    result = mat4(1.0f);
+    rms = 0;
+    scale = 0;
+}
+
+void extrinsic_calibration::set_params(const extrinsic_params& params)
+{
+    this->params = params;
+}
+
+const extrinsic_params& extrinsic_calibration::get_params() const
+{
+    return params;
+}
+
+void extrinsic_calibration::start(const vector<vec3>& points)
+{
+    this->points = points;
+    sensor_pts.clear();
+    robot_pts.clear();
+    point = 0;
+    sent = false;
+    point_time = -1;
+    hold_samples = 0;
+    progress = 0;
+    error = "";
+    done = false;
+    running = !points.empty();
+    if (!running) error = "No calibration points";
+}
+
+void extrinsic_calibration::cancel()
+{
+    running = false;
+    progress = 0;
+}
+
+bool extrinsic_calibration::add_sample(vec3 sensor_pos, double time)
+{
+    if (!running || !sent) return false;
+
+    //the robot is still on its way to the point
+    if (point_time < 0) point_time = time;
+    if (time - point_time < params.settle_time) return false;
+
+    //hand has to come to rest , any move out of still_radius starts the hold over from there
+    if (hold_samples == 0 || distance(sensor_pos, hold_anchor) > params.still_radius) {
+        hold_start = time;
+        hold_anchor = sensor_pos;
+        hold_sum = dvec3(0);
+        hold_samples = 0;
+    }
+    hold_sum += dvec3(sensor_pos);
+    hold_samples++;
+    progress = params.hold_time > 0 ? std::min((float)((time - hold_start) / params.hold_time), 1.0f) : 1.0f;
+
+    if (time - hold_start < params.hold_time || hold_samples < EXTRINSIC_MIN_HOLD_SAMPLES) return false;
+
+    add_pair(vec3(hold_sum / (double)hold_samples), points[point]);
+    next_point();
+    if (point < (int)points.size()) return false;
+
+    //all points visited
+    running = false;
+    solve();
+    return true;
+}
+
+void extrinsic_calibration::point_sent()
+{
+    if (sent) return;
+    sent = true;
+    point_time = -1;
+}
+
+void extrinsic_calibration::next_point()
+{
+    point++;
+    sent = false;
+    point_time = -1;
+    hold_samples = 0;
+    progress = 0;
+}
+
+void extrinsic_calibration::add_pair(vec3 sensor_pos, vec3 robot_pos)
+{
+    sensor_pts.push_back(sensor_pos);
+    robot_pts.push_back(robot_pos);
+}
+
+bool extrinsic_calibration::solve()
+{
+    done = false;
+    if (sensor_pts.size() < 3) {
+        error = "At least 3 points are needed";
+        return false;
+    }
+
+    mat4 m;
+    float fit_rms = 0;
+    if (!fit(sensor_pts, robot_pts, params.fit_scale, params.unit_scale, m, fit_rms)) {
+        error = "Hand positions were all on one line";
+        return false;
+    }
+    if (fit_rms > params.max_rms) {
+        error = "Fit error " + std::to_string(fit_rms) + " mm is too large , keep the hand on the tool and try again";
+        return false;
+    }
+
+    result = m;
+    rms = fit_rms;
+    scale = length(vec3(m[0]));
+    error = "";
+    done = true;
+    return true;
+}
+
+bool extrinsic_calibration::is_running() const
+{
+    return running;
+}
+
+bool extrinsic_calibration::is_done() const
+{
+    return done;
+}
+
+vec3 extrinsic_calibration::get_point() const
+{
+    if (points.empty()) return vec3(0);
+    return points[std::min(point, (int)points.size() - 1)];
+}
+
+int extrinsic_calibration::get_point_index() const
+{
+    return point;
+}
+
+size_t extrinsic_calibration::get_point_count() const
+{
+    return points.size();
+}
+
+float extrinsic_calibration::get_progress() const
+{
+    return progress;
+}
+
+size_t extrinsic_calibration::get_pair_count() const
+{
+    return sensor_pts.size();
+}
+
+string extrinsic_calibration::get_error() const
+{
+    return error;
+}
+
+const mat4& extrinsic_calibration::get_result() const
+{
+    return result;
+}
+
+float extrinsic_calibration::get_rms() const
+{
+    return rms;
+}
+
+float extrinsic_calibration::get_scale() const
+{
+    return scale;
+}
+
+bool extrinsic_calibration::save_profile(const string& path) const
+{
+    if (!done) return false;
+
+    ofstream file(path);
+    if (!file) return false;
+    file.precision(9);
+
+    file << EXTRINSIC_PROFILE_MAGIC << " " << EXTRINSIC_PROFILE_VERSION << "\n";
+    file << "matrix";
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++) file << " " << result[c][r];
+    file << "\n";
+
+    //what the fit was based on (ignored when loading)
+    file << "scale " << scale << "\n";
+    file << "rms_mm " << rms << "\n";
+    for (size_t i = 0; i < sensor_pts.size(); i++) {
+        file << "pair " << sensor_pts[i].x << " " << sensor_pts[i].y << " " << sensor_pts[i].z << " "
+             << robot_pts[i].x << " " << robot_pts[i].y << " " << robot_pts[i].z << "\n";
+    }
+    return (bool)file;
+}
+
+bool extrinsic_calibration::load_profile(const string& path, mat4& m)
+{
+    ifstream file(path);
+    if (!file) return false;
+
+    string magic;
+    int version = 0;
+    file >> magic >> version;
+    if (magic != EXTRINSIC_PROFILE_MAGIC || version != EXTRINSIC_PROFILE_VERSION) return false;
+
+    bool has_matrix = false;
+    mat4 loaded;
+    string key;
+    while (file >> key) {
+        if (key == "matrix") {
+            for (int c = 0; c < 4; c++)
+                for (int r = 0; r < 4; r++) file >> loaded[c][r];
+            has_matrix = true;
+        }
+        else {
+            //informational line
+            string rest;
+            getline(file, rest);
+        }
+        if (!file) return false;
+    }
+    if (!has_matrix) return false;
+
+    m = loaded;
+    return true;
+}
+
+void extrinsic_calibration::make_points(vec3 box_min, vec3 box_max, float fraction, float l1_len, float l2_len, float ee_offset, vector<vec3>& points)
+{
+    vec3 mid = (box_min + box_max) * 0.5f;
+    vec3 half = (box_max - box_min) * 0.5f * fraction;
+
+    points.clear();
+    for (int i = 0; i < 9; i++) {
+        vec3 corner = i == 0 ? vec3(0) : vec3((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1);
+
+        //checked as sent , whole milimeters , a point the robot never reaches would pair the hand with the wrong target
+        vec3 point = round(mid + corner * half);
+        if (kxr::isAllowedPosition(l1_len, l2_len, ee_offset, point.x, point.y, point.z)) points.push_back(point);
+    }
+}
+
+//eigen decomposition of a symmetric n x n matrix (n <= 4) by cyclic jacobi rotations , a is destroyed
+//eigenvalue i comes with the eigenvector in column i of vectors
+static void jacobi_eigen(double a[4][4], int n, double values[4], double vectors[4][4])
+{
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) vectors[i][j] = i == j ? 1.0 : 0.0;
+
+    for (int sweep = 0; sweep < EXTRINSIC_MAX_SWEEPS; sweep++) {
+        double off = 0, diag = 0;
+        for (int p = 0; p < n; p++) {
+            diag += a[p][p] * a[p][p];
+            for (int q = p + 1; q < n; q++) off += a[p][q] * a[p][q];
+        }
+        if (off <= 1e-24 * diag || off == 0) break;
+
+        for (int p = 0; p < n - 1; p++) {
+            for (int q = p + 1; q < n; q++) {
+                if (a[p][q] == 0) continue;
+
+                //rotation in the (p , q) plane that zeroes a[p][q]
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0);
+                double s = t * c;
+
+                for (int k = 0; k < n; k++) {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; k++) {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; k++) {
+                    double vkp = vectors[k][p], vkq = vectors[k][q];
+                    vectors[k][p] = c * vkp - s * vkq;
+                    vectors[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) values[i] = a[i][i];
+}
+
+bool extrinsic_calibration::fit(const vector<vec3>& a, const vector<vec3>& b, bool fit_scale, float scale, mat4& m, float& rms)
+{
+    size_t n = std::min(a.size(), b.size());
+    if (n < 3) return false;
+
+    //centroids
+    dvec3 mean_a(0), mean_b(0);
+    for (size_t i = 0; i < n; i++) {
+        mean_a += dvec3(a[i]);
+        mean_b += dvec3(b[i]);
+    }
+    mean_a /= (double)n;
+    mean_b /= (double)n;
+
+    //cross covariance s[j][k] = sum a'_j b'_k , spread of a
+    double s[3][3] = { { 0 } };
+    double cov[4][4] = { { 0 } };
+    double var_a = 0;
+    for (size_t i = 0; i < n; i++) {
+        dvec3 pa = dvec3(a[i]) - mean_a;
+        dvec3 pb = dvec3(b[i]) - mean_b;
+        for (int j = 0; j < 3; j++) {
+            for (int k = 0; k < 3; k++) {
+                s[j][k] += pa[j] * pb[k];
+                cov[j][k] += pa[j] * pa[k];
+            }
+        }
+        var_a += dot(pa, pa);
+    }
+    if (var_a <= 0) return false;
+
+    //the two largest spreads of a must both be there or the rotation about the line is free
+    double spread[4], axes[4][4];
+    jacobi_eigen(cov, 3, spread, axes);
+    double largest = std::max(spread[0], std::max(spread[1], spread[2]));
+    double smallest = std::min(spread[0], std::min(spread[1], spread[2]));
+    double middle = spread[0] + spread[1] + spread[2] - largest - smallest;
+    if (middle < EXTRINSIC_MIN_SPREAD * largest) return false;
+
+    //Horn: the rotation is the unit quaternion of the largest eigenvalue of this symmetric matrix
+    double sxx = s[0][0], sxy = s[0][1], sxz = s[0][2];
+    double syx = s[1][0], syy = s[1][1], syz = s[1][2];
+    double szx = s[2][0], szy = s[2][1], szz = s[2][2];
+    double horn[4][4] = {
+        { sxx + syy + szz, syz - szy, szx - sxz, sxy - syx },
+        { syz - szy, sxx - syy - szz, sxy + syx, szx + sxz },
+        { szx - sxz, sxy + syx, -sxx + syy - szz, syz + szy },
+        { sxy - syx, szx + sxz, syz + szy, -sxx - syy + szz }
+    };
+    double values[4], vectors[4][4];
+    jacobi_eigen(horn, 4, values, vectors);
+    int best = 0;
+    for (int i = 1; i < 4; i++)
+        if (values[i] > values[best]) best = i;
+
+    double qw = vectors[0][best], qx = vectors[1][best], qy = vectors[2][best], qz = vectors[3][best];
+    double qn = sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+    qw /= qn; qx /= qn; qy /= qn; qz /= qn;
+
+    //rotation , columns are glm's (rot[column][row])
+    glm::dmat3 rot;
+    rot[0] = dvec3(1 - 2 * (qy * qy + qz * qz), 2 * (qx * qy + qw * qz), 2 * (qx * qz - qw * qy));
+    rot[1] = dvec3(2 * (qx * qy - qw * qz), 1 - 2 * (qx * qx + qz * qz), 2 * (qy * qz + qw * qx));
+    rot[2] = dvec3(2 * (qx * qz + qw * qy), 2 * (qy * qz - qw * qx), 1 - 2 * (qx * qx + qy * qy));
+
+    //Umeyama: least squares scale once the rotation is known
+    double k = scale;
+    if (fit_scale) {
+        double num = 0;
+        for (size_t i = 0; i < n; i++) num += dot(dvec3(b[i]) - mean_b, rot * (dvec3(a[i]) - mean_a));
+        k = num / var_a;
+        if (k <= 0) return false;
+    }
+    dvec3 offset = mean_b - k * (rot * mean_a);
+
+    m = mat4(1.0f);
+    for (int c = 0; c < 3; c++) m[c] = vec4(vec3(rot[c] * k), 0.0f);
+    m[3] = vec4(vec3(offset), 1.0f);
+
+    double err = 0;
+    for (size_t i = 0; i < n; i++) {
+        dvec3 d = k * (rot * dvec3(a[i])) + offset - dvec3(b[i]);
+        err += dot(d, d);
+    }
+    rms = (float)sqrt(err / (double)n);
+    return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../arduino/Community_robot_firmware/robotArm_v0.41/kinematicChain.h"
+
+using namespace ci;
+using namespace std;
+
+struct extrinsic_params {
+	bool fit_scale;				//similarity fit (Umeyama) , otherwise rigid (Kabsch) at unit_scale
+	float unit_scale;			//firmware mm per sensor m for a rigid fit
+	float settle_time;			//seconds after the robot is sent to a point before the hand is sampled
+	float hold_time;			//seconds the hand has to stay within still_radius to capture a point
+	float still_radius;			//m
+	float max_rms;				//fit residual (mm) above which the result is rejected
+
+	extrinsic_params();
+};
+
+//Sensor to robot calibration from point correspondences
+//The robot visits a list of G1 targets , at each one the operator holds the tracked hand on the tool until it has been
+//still for hold_time and the mean hand position (sensor frame , m) is paired with the target (firmware frame , mm).
+//At the end the least squares rotation , translation and (optionally) scale taking the hand positions onto the targets
+//is solved in closed form (Horn's quaternion method , Umeyama's scale) and kept as one affine matrix
+class extrinsic_calibration
+{
+	public:
+
+		extrinsic_calibration();
+
+		void set_params(const extrinsic_params& params);
+		const extrinsic_params& get_params() const;
+
+		//visit points (firmware frame , mm) in order , pairs from an earlier run are dropped
+		void start(const vector<vec3>& points);
+		void cancel();
+
+		//call once the G1 for get_point() has actually been written , samples before that are ignored
+		void point_sent();
+
+		//feed the tracked hand (sensor frame , m) once per frame , true on the frame that finished the run
+		bool add_sample(vec3 sensor_pos, double time);
+
+		//one correspondence measured some other way , solve when done adding
+		void add_pair(vec3 sensor_pos, vec3 robot_pos);
+		bool solve();
+
+		bool is_running() const;
+		bool is_done() const;				//finished with a result
+		vec3 get_point() const;				//where the robot should be now (firmware frame , mm)
+		int get_point_index() const;		//changes every time a point is captured
+		size_t get_point_count() const;
+		float get_progress() const;			//0..1 of the hold at the current point
+		size_t get_pair_count() const;
+		string get_error() const;			//why the last run produced no result
+
+		const mat4& get_result() const;		//sensor (m) to firmware frame (mm)
+		float get_rms() const;				//mm
+		float get_scale() const;			//firmware mm per sensor m
+
+		//calibration profile (text): the matrix plus the pairs it was fit to
+		bool save_profile(const string& path) const;
+		static bool load_profile(const string& path, mat4& m);
+
+		//G1 targets for a run: the middle of the box and its corners pulled in towards the middle by fraction
+		//points the firmware would refuse for an arm with shanks l1 , l2 (kxr::isAllowedPosition) are left out
+		static void make_points(vec3 box_min, vec3 box_max, float fraction, float l1_len, float l2_len, float ee_offset, vector<vec3>& points);
+
+		//least squares map taking a onto b , with scale fixed when fit_scale is off , false if a is degenerate (collinear)
+		static bool fit(const vector<vec3>& a, const vector<vec3>& b, bool fit_scale, float scale, mat4& m, float& rms);
+
+	private:
+
+		extrinsic_params params;
+
+		bool running;
+		bool done;
+		string error;
+
+		vector<vec3> points;
+		int point;
+		bool sent;				//the current point went out to the robot
+		double point_time;		//time of the first sample after the point was sent , negative until then
+		double hold_start;		//time the hand came to rest
+		vec3 hold_anchor;		//where it came to rest
+		dvec3 hold_sum;
+		uint32_t hold_samples;
+		float progress;
+
+		vector<vec3> sensor_pts;	//m
+		vector<vec3> robot_pts;		//mm
+
+		mat4 result;
+		float rms;
+		float scale;
+
+		void next_point();
+};
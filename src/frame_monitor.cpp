@@ -0,0 +1,125 @@
+#include "frame_monitor.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+//weight of the newest sample in the interval and age averages
+static const float MONITOR_SMOOTHING = 0.05f;
+
+//sensor clock going back further than this (ms) is a new sequence , not a late frame
+static const int64_t MONITOR_RESYNC_MS = 1000;
+
+//same for frame numbers on sources without a sensor clock
+static const uint32_t MONITOR_RESYNC_FRAMES = 30;
+
+//frame spacing of a 30 Hz sensor , counts missing frames when a source has no frame numbers
+static const float MONITOR_NOMINAL_MS = 1000.0f / 30.0f;
+
+frame_monitor::frame_monitor() {
+    reset();
+}
+
+void frame_monitor::reset()
+{
+    has_last = false;
+    last_time = 0;
+    last_timestamp = 0;
+    last_number = 0;
+    reset_stats();
+}
+
+void frame_monitor::reset_stats()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+int frame_monitor::add_frame(const skeleton_frame& frame)
+{
+    if (!has_last || frame.time < last_time) {
+        //first frame , or the source clock went backwards (new source or a rewind)
+        bool restart = has_last;
+        has_last = true;
+        last_time = frame.time;
+        last_timestamp = frame.timestamp;
+        last_number = frame.number;
+        stats.accepted++;
+        if (restart) stats.restarts++;
+        return restart ? FRAME_RESTART : FRAME_NEW;
+    }
+
+    int64_t dt_ms = 0;
+    bool stamped = frame.timestamp != 0 && last_timestamp != 0;
+    bool numbered = frame.number != 0 && last_number != 0;
+
+    if (stamped) {
+        dt_ms = frame.timestamp - last_timestamp;
+        if (dt_ms == 0 || (numbered && frame.number == last_number)) {
+            stats.duplicates++;
+            return FRAME_DUPLICATE;
+        }
+        if (dt_ms < 0 && -dt_ms < MONITOR_RESYNC_MS) {
+            stats.late++;
+            return FRAME_LATE;
+        }
+    }
+    else if (numbered) {
+        if (frame.number == last_number) {
+            stats.duplicates++;
+            return FRAME_DUPLICATE;
+        }
+        if (frame.number < last_number && last_number - frame.number < MONITOR_RESYNC_FRAMES) {
+            stats.late++;
+            return FRAME_LATE;
+        }
+    }
+
+    //sensor clock or frame number started over while the arrival clock kept going (replay loop , sensor reset)
+    bool restart = stamped ? dt_ms < 0 : numbered && frame.number < last_number;
+    if (restart) {
+        stats.restarts++;
+    }
+    else {
+        float interval = stamped ? (float)dt_ms : (float)((frame.time - last_time) * 1000.0);
+        add_interval(interval);
+
+        //frames the sensor produced in between that never arrived
+        uint32_t skipped = 0;
+        if (numbered) skipped = frame.number - last_number - 1;
+        else if (interval > 1.5f * MONITOR_NOMINAL_MS) skipped = (uint32_t)(interval / MONITOR_NOMINAL_MS + 0.5f) - 1;
+        if (skipped > 0) {
+            stats.gaps++;
+            stats.missing += skipped;
+        }
+    }
+
+    last_time = frame.time;
+    last_timestamp = frame.timestamp;
+    last_number = frame.number;
+    stats.accepted++;
+    return restart ? FRAME_RESTART : FRAME_NEW;
+}
+
+void frame_monitor::add_interval(float ms)
+{
+    int bin = std::min((int)(ms / FRAME_INTERVAL_BIN_MS), FRAME_INTERVAL_BINS - 1);
+    stats.histogram[std::max(bin, 0)]++;
+
+    if (stats.interval_ms == 0) stats.interval_ms = ms;
+    float dev = ms - stats.interval_ms;
+    stats.interval_ms += MONITOR_SMOOTHING * dev;
+    stats.interval_jitter_ms = sqrtf(stats.interval_jitter_ms * stats.interval_jitter_ms
+        + MONITOR_SMOOTHING * (dev * dev - stats.interval_jitter_ms * stats.interval_jitter_ms));
+}
+
+void frame_monitor::add_age(float age)
+{
+    float ms = age * 1000.0f;
+    stats.age_ms += MONITOR_SMOOTHING * (ms - stats.age_ms);
+    stats.max_age_ms = std::max(stats.max_age_ms, ms);
+}
+
+const frame_stats& frame_monitor::get_stats() const
+{
+    return stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "skeleton_frame.h"
+
+//inter-frame interval histogram: FRAME_INTERVAL_BIN_MS wide bins , the last one collects everything longer
+#define FRAME_INTERVAL_BINS 20
+#define FRAME_INTERVAL_BIN_MS 5
+
+//what the monitor made of a frame
+enum frame_verdict {
+	FRAME_NEW = 0,				//next frame of the sequence
+	FRAME_RESTART,				//the source started over (new source , rewind , replay loop) , history is stale
+	FRAME_DUPLICATE,			//same sensor frame as the last one , drop
+	FRAME_LATE					//older than the last one , drop
+};
+
+//counters since the last reset_stats , averages over the last couple of seconds
+struct frame_stats {
+	uint32_t accepted;
+	uint32_t duplicates;
+	uint32_t late;
+	uint32_t restarts;
+	uint32_t gaps;				//times the sequence skipped ahead
+	uint32_t missing;			//frames the skips add up to (the sensor produced them , nobody received them)
+
+	float interval_ms;			//sensor clock time between accepted frames
+	float interval_jitter_ms;	//rms deviation of that interval
+	float age_ms;				//how long the newest frame waited before a loop consumed it
+	float max_age_ms;
+
+	uint32_t histogram[FRAME_INTERVAL_BINS];	//sensor intervals
+};
+
+//Sequence check and timing accounting in front of the tracking pipeline
+//Frames are ordered by sensor timestamp (frame number when there is none , arrival time when there is neither)
+//A frame that repeats or predates the last one is dropped before it can move the displacement or trigger a G1 line ,
+//skips in the frame number count as missing frames
+//Long sensor intervals with young frames mean the sensor is starving , regular intervals with old frames mean the app is slow
+class frame_monitor
+{
+	public:
+
+		frame_monitor();
+
+		void reset();							//forget the sequence and the stats
+		void reset_stats();						//keep the sequence , zero the counters
+
+		int add_frame(const skeleton_frame& frame);		//frame_verdict
+		void add_age(float age);				//seconds the newest frame waited , once per consuming loop
+
+		const frame_stats& get_stats() const;
+
+	private:
+
+		bool has_last;
+		double last_time;
+		int64_t last_timestamp;
+		uint32_t last_number;
+
+		frame_stats stats;
+
+		void add_interval(float ms);
+};
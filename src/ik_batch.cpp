@@ -0,0 +1,350 @@
+#include "ik_batch.h"
+#include <math.h>
+
+//pick widest instruction set available at compile time
+//Note: MSVC does not define __SSE2__ but x64 always has it
+#if defined(__AVX__)
+#define IK_BATCH_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IK_BATCH_SSE2
+#endif
+
+#if defined(IK_BATCH_AVX) || defined(IK_BATCH_SSE2)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    const float PI_F = 3.14159265358979f;
+    const float HALF_PI_F = 1.57079632679490f;
+    const float RAD_TO_DEG = 180.0f / PI_F;
+    const float DEG_TO_RAD = PI_F / 180.0f;
+
+    //limb dependent constants, computed once per call instead of once per lane
+    struct ik_consts {
+        float l3;
+        float l1_l2_sqrd;       //L1^2 + L2^2
+        float l1_sqrd_sub_l2;   //L1^2 - L2^2
+        float inv_2l1l2;        //1 / (2 * L1 * L2)
+        float two_l1;           //2 * L1
+    };
+
+    ik_consts make_consts(float l1, float l2, float l3) {
+        ik_consts c;
+        c.l3 = l3;
+        c.l1_l2_sqrd = l1 * l1 + l2 * l2;
+        c.l1_sqrd_sub_l2 = l1 * l1 - l2 * l2;
+        c.inv_2l1l2 = 1.0f / (2.0f * l1 * l2);
+        c.two_l1 = 2.0f * l1;
+        return c;
+    }
+
+    float clamp_unit(float v) {
+        //also maps NaN to 1 so angles stay finite
+        if (!(v <= 1.0f)) return 1.0f;
+        if (v < -1.0f) return -1.0f;
+        return v;
+    }
+
+    bool in_unit(float v) {
+        return v >= -1.0f && v <= 1.0f;     //false for NaN
+    }
+
+    //scalar solver for one lane (reference path and tail of the SIMD loops)
+    uint8_t solve_lane(const ik_consts& c, const ik_batch_in& in, ik_batch_out& out, size_t i) {
+        float x = in.x[i];
+        float y = in.y[i];
+        float z = in.z[i];
+        float g = in.gamma[i];
+
+        float x0 = x - (c.l3 * cosf(g * DEG_TO_RAD));
+        float y0 = y - (c.l3 * sinf(g * DEG_TO_RAD));
+        float r0_sqrd = (x0 * x0) + (y0 * y0);
+        float r0 = sqrtf(r0_sqrd);
+        float rz = sqrtf((x * x) + (y * y));
+
+        float cos_b = (c.l1_l2_sqrd - r0_sqrd) * c.inv_2l1l2;
+        float cos_a = (r0_sqrd + c.l1_sqrd_sub_l2) / (c.two_l1 * r0);
+        float cos_t0 = z / rz;
+        uint8_t ok = in_unit(cos_b) && in_unit(cos_a) && in_unit(cos_t0);
+
+        float b = 180.0f - acosf(clamp_unit(cos_b)) * RAD_TO_DEG;
+        float a = atanf(y0 / x0) * RAD_TO_DEG + acosf(clamp_unit(cos_a)) * RAD_TO_DEG;
+        if (!ok && a != a) a = 0.0f;        //x0 == y0 == 0
+
+        out.alpha[i] = a;
+        out.beta[i] = -b;
+        out.theta[i] = g - a + b;
+        out.theta_0[i] = acosf(clamp_unit(cos_t0)) * RAD_TO_DEG;
+        out.reachable[i] = ok;
+        return ok;
+    }
+
+#if defined(IK_BATCH_AVX) || defined(IK_BATCH_SSE2)
+
+    //thin wrappers so the kernel below is written once for every register width
+
+#if defined(IK_BATCH_SSE2)
+    struct simd_sse {
+        typedef __m128 v;
+        static const int width = 4;
+        static v load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, v a) { _mm_storeu_ps(p, a); }
+        static v set1(float f) { return _mm_set1_ps(f); }
+        static v add(v a, v b) { return _mm_add_ps(a, b); }
+        static v sub(v a, v b) { return _mm_sub_ps(a, b); }
+        static v mul(v a, v b) { return _mm_mul_ps(a, b); }
+        static v div(v a, v b) { return _mm_div_ps(a, b); }
+        static v sqrt(v a) { return _mm_sqrt_ps(a); }
+        static v min(v a, v b) { return _mm_min_ps(a, b); }
+        static v max(v a, v b) { return _mm_max_ps(a, b); }
+        static v and_(v a, v b) { return _mm_and_ps(a, b); }
+        static v or_(v a, v b) { return _mm_or_ps(a, b); }
+        static v xor_(v a, v b) { return _mm_xor_ps(a, b); }
+        static v andnot(v a, v b) { return _mm_andnot_ps(a, b); }
+        static v cmpge(v a, v b) { return _mm_cmpge_ps(a, b); }
+        static v cmple(v a, v b) { return _mm_cmple_ps(a, b); }
+        static v cmplt(v a, v b) { return _mm_cmplt_ps(a, b); }
+        static v cmpgt(v a, v b) { return _mm_cmpgt_ps(a, b); }
+        static v cmpeq(v a, v b) { return _mm_cmpeq_ps(a, b); }
+        static int movemask(v a) { return _mm_movemask_ps(a); }
+    };
+#endif
+
+#if defined(IK_BATCH_AVX)
+    //Note: only AVX1 instructions are used (no integer ops) so this runs on Sandy Bridge and newer
+    struct simd_avx {
+        typedef __m256 v;
+        static const int width = 8;
+        static v load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, v a) { _mm256_storeu_ps(p, a); }
+        static v set1(float f) { return _mm256_set1_ps(f); }
+        static v add(v a, v b) { return _mm256_add_ps(a, b); }
+        static v sub(v a, v b) { return _mm256_sub_ps(a, b); }
+        static v mul(v a, v b) { return _mm256_mul_ps(a, b); }
+        static v div(v a, v b) { return _mm256_div_ps(a, b); }
+        static v sqrt(v a) { return _mm256_sqrt_ps(a); }
+        static v min(v a, v b) { return _mm256_min_ps(a, b); }
+        static v max(v a, v b) { return _mm256_max_ps(a, b); }
+        static v and_(v a, v b) { return _mm256_and_ps(a, b); }
+        static v or_(v a, v b) { return _mm256_or_ps(a, b); }
+        static v xor_(v a, v b) { return _mm256_xor_ps(a, b); }
+        static v andnot(v a, v b) { return _mm256_andnot_ps(a, b); }
+        static v cmpge(v a, v b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static v cmple(v a, v b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static v cmplt(v a, v b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static v cmpgt(v a, v b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static v cmpeq(v a, v b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        static int movemask(v a) { return _mm256_movemask_ps(a); }
+    };
+#endif
+
+    //per-lane select: mask ? a : b
+    template <class S>
+    typename S::v select(typename S::v mask, typename S::v a, typename S::v b) {
+        return S::or_(S::and_(mask, a), S::andnot(mask, b));
+    }
+
+    template <class S>
+    typename S::v abs_v(typename S::v a) {
+        return S::andnot(S::set1(-0.0f), a);
+    }
+
+    //round to nearest integer valued float, valid for |a| < 2^22
+    template <class S>
+    typename S::v round_v(typename S::v a) {
+        typename S::v magic = S::set1(12582912.0f);     //1.5 * 2^23
+        return S::sub(S::add(a, magic), magic);
+    }
+
+    //sin and cos of a (radians)
+    //quadrant reduction with a 3 part Cody-Waite split of pi/2, then Cephes polynomials on [-pi/4, pi/4]
+    //|err| <= 1.2e-7 for |a| < 8192
+    template <class S>
+    void sincos_v(typename S::v a, typename S::v& s_out, typename S::v& c_out) {
+        typedef typename S::v v;
+        v q = round_v<S>(S::mul(a, S::set1(0.636619772f)));            //a * 2/pi
+        v r = S::sub(a, S::mul(q, S::set1(1.5703125f)));
+        r = S::sub(r, S::mul(q, S::set1(4.837512969970703125e-4f)));
+        r = S::sub(r, S::mul(q, S::set1(7.54978995489188216e-8f)));
+
+        //quadrant k = q mod 4 computed in float (AVX1 has no 256 bit integer ops)
+        v q4 = S::mul(q, S::set1(0.25f));
+        v fl = round_v<S>(q4);
+        fl = S::sub(fl, S::and_(S::cmpgt(fl, q4), S::set1(1.0f)));        //floor
+        v k = S::sub(q, S::mul(fl, S::set1(4.0f)));
+
+        v z = S::mul(r, r);
+        v sp = S::add(S::set1(8.3321608736e-3f), S::mul(z, S::set1(-1.9515295891e-4f)));
+        sp = S::add(S::set1(-1.6666654611e-1f), S::mul(z, sp));
+        v sn = S::add(r, S::mul(S::mul(r, z), sp));
+
+        v cp = S::add(S::set1(-1.388731625493765e-3f), S::mul(z, S::set1(2.443315711809948e-5f)));
+        cp = S::add(S::set1(4.166664568298827e-2f), S::mul(z, cp));
+        v cs = S::add(S::sub(S::set1(1.0f), S::mul(z, S::set1(0.5f))), S::mul(S::mul(z, z), cp));
+
+        v k1 = S::cmpeq(k, S::set1(1.0f));
+        v k2 = S::cmpeq(k, S::set1(2.0f));
+        v k3 = S::cmpeq(k, S::set1(3.0f));
+        v swap = S::or_(k1, k3);
+        v sign = S::set1(-0.0f);
+
+        v s = select<S>(swap, cs, sn);
+        v c = select<S>(swap, sn, cs);
+        s_out = S::xor_(s, S::and_(S::or_(k2, k3), sign));
+        c_out = S::xor_(c, S::and_(S::or_(k1, k2), sign));
+    }
+
+    //acos(a) for a in [-1, 1]
+    //Abramowitz & Stegun 4.4.46: acos(x) = sqrt(1 - x) * P7(x) on [0, 1], |err| <= 2e-8 (plus float rounding)
+    template <class S>
+    typename S::v acos_v(typename S::v a) {
+        typedef typename S::v v;
+        v x = abs_v<S>(a);
+        v p = S::set1(-0.0012624911f);
+        p = S::add(S::mul(p, x), S::set1(0.0066700901f));
+        p = S::add(S::mul(p, x), S::set1(-0.0170881256f));
+        p = S::add(S::mul(p, x), S::set1(0.0308918810f));
+        p = S::add(S::mul(p, x), S::set1(-0.0501743046f));
+        p = S::add(S::mul(p, x), S::set1(0.0889789874f));
+        p = S::add(S::mul(p, x), S::set1(-0.2145988016f));
+        p = S::add(S::mul(p, x), S::set1(1.5707963050f));
+        v r = S::mul(S::sqrt(S::sub(S::set1(1.0f), x)), p);
+        return select<S>(S::cmplt(a, S::set1(0.0f)), S::sub(S::set1(PI_F), r), r);
+    }
+
+    //atan2(y, x)
+    //octant reduction to t = min/max in [0, 1] then Abramowitz & Stegun 4.4.49, |err| <= 2e-8 (plus float rounding)
+    template <class S>
+    typename S::v atan2_v(typename S::v y, typename S::v x) {
+        typedef typename S::v v;
+        v ax = abs_v<S>(x);
+        v ay = abs_v<S>(y);
+        v mx = S::max(S::max(ax, ay), S::set1(1e-30f));
+        v t = S::div(S::min(ax, ay), mx);
+        v s = S::mul(t, t);
+
+        v p = S::set1(0.0028662257f);
+        p = S::add(S::mul(p, s), S::set1(-0.0161657367f));
+        p = S::add(S::mul(p, s), S::set1(0.0429096138f));
+        p = S::add(S::mul(p, s), S::set1(-0.0752896400f));
+        p = S::add(S::mul(p, s), S::set1(0.1065626393f));
+        p = S::add(S::mul(p, s), S::set1(-0.1420889944f));
+        p = S::add(S::mul(p, s), S::set1(0.1999355085f));
+        p = S::add(S::mul(p, s), S::set1(-0.3333314528f));
+        p = S::add(S::mul(p, s), S::set1(1.0f));
+        v r = S::mul(t, p);
+
+        r = select<S>(S::cmpgt(ay, ax), S::sub(S::set1(HALF_PI_F), r), r);
+        r = select<S>(S::cmplt(x, S::set1(0.0f)), S::sub(S::set1(PI_F), r), r);
+        return S::xor_(r, S::and_(y, S::set1(-0.0f)));     //copy sign of y
+    }
+
+    //solves S::width lanes starting at i, returns reachable bitmask
+    template <class S>
+    int solve_block(const ik_consts& c, const ik_batch_in& in, ik_batch_out& out, size_t i) {
+        typedef typename S::v v;
+        v one = S::set1(1.0f);
+        v neg_one = S::set1(-1.0f);
+        v r2d = S::set1(RAD_TO_DEG);
+
+        v x = S::load(in.x + i);
+        v y = S::load(in.y + i);
+        v z = S::load(in.z + i);
+        v g = S::load(in.gamma + i);
+
+        v sg, cg;
+        sincos_v<S>(S::mul(g, S::set1(DEG_TO_RAD)), sg, cg);
+
+        v l3 = S::set1(c.l3);
+        v x0 = S::sub(x, S::mul(l3, cg));
+        v y0 = S::sub(y, S::mul(l3, sg));
+        v r0_sqrd = S::add(S::mul(x0, x0), S::mul(y0, y0));
+        v r0 = S::sqrt(r0_sqrd);
+        v rz = S::sqrt(S::add(S::mul(x, x), S::mul(y, y)));
+
+        v cos_b = S::mul(S::sub(S::set1(c.l1_l2_sqrd), r0_sqrd), S::set1(c.inv_2l1l2));
+        v cos_a = S::div(S::add(r0_sqrd, S::set1(c.l1_sqrd_sub_l2)), S::mul(S::set1(c.two_l1), r0));
+        v cos_t0 = S::div(z, rz);
+
+        //ordered compares are false for NaN so division by zero lanes drop out here
+        v ok = S::and_(S::cmpge(cos_b, neg_one), S::cmple(cos_b, one));
+        ok = S::and_(ok, S::and_(S::cmpge(cos_a, neg_one), S::cmple(cos_a, one)));
+        ok = S::and_(ok, S::and_(S::cmpge(cos_t0, neg_one), S::cmple(cos_t0, one)));
+
+        //min returns its second operand for NaN so clamped values are always finite
+        cos_b = S::max(S::min(cos_b, one), neg_one);
+        cos_a = S::max(S::min(cos_a, one), neg_one);
+        cos_t0 = S::max(S::min(cos_t0, one), neg_one);
+
+        //atan(y0 / x0) == atan2(y0 * sign(x0), |x0|), keeps calcIK's branch choice
+        v sign_x0 = S::and_(x0, S::set1(-0.0f));
+        v ang = atan2_v<S>(S::xor_(y0, sign_x0), abs_v<S>(x0));
+
+        v b = S::sub(S::set1(180.0f), S::mul(acos_v<S>(cos_b), r2d));
+        v a = S::mul(S::add(ang, acos_v<S>(cos_a)), r2d);
+
+        S::store(out.alpha + i, a);
+        S::store(out.beta + i, S::sub(S::set1(0.0f), b));
+        S::store(out.theta + i, S::add(S::sub(g, a), b));
+        S::store(out.theta_0 + i, S::mul(acos_v<S>(cos_t0), r2d));
+
+        int mask = S::movemask(ok);
+        for (int k = 0; k < S::width; k++) out.reachable[i + k] = (mask >> k) & 1;
+        return mask;
+    }
+
+    int popcount(int m) {
+        int n = 0;
+        for (; m; m &= m - 1) n++;
+        return n;
+    }
+
+    template <class S>
+    size_t solve_simd(const ik_consts& c, const ik_batch_in& in, ik_batch_out& out) {
+        size_t n_ok = 0;
+        size_t i = 0;
+        for (; i + S::width <= in.count; i += S::width)
+            n_ok += popcount(solve_block<S>(c, in, out, i));
+        for (; i < in.count; i++)
+            n_ok += solve_lane(c, in, out, i);
+        return n_ok;
+    }
+
+#endif
+}
+
+size_t ik_batch_solve(const ik_batch_in& in, ik_batch_out& out, float l1_len, float l2_len, float l3_len)
+{
+    ik_consts c = make_consts(l1_len, l2_len, l3_len);
+
+#if defined(IK_BATCH_AVX)
+    return solve_simd<simd_avx>(c, in, out);
+#elif defined(IK_BATCH_SSE2)
+    return solve_simd<simd_sse>(c, in, out);
+#else
+    return ik_batch_solve_scalar(in, out, l1_len, l2_len, l3_len);
+#endif
+}
+
+size_t ik_batch_solve_scalar(const ik_batch_in& in, ik_batch_out& out, float l1_len, float l2_len, float l3_len)
+{
+    ik_consts c = make_consts(l1_len, l2_len, l3_len);
+
+    size_t n_ok = 0;
+    for (size_t i = 0; i < in.count; i++)
+        n_ok += solve_lane(c, in, out, i);
+    return n_ok;
+}
+
+const char* ik_batch_kernel_name()
+{
+#if defined(IK_BATCH_AVX)
+    return "AVX";
+#elif defined(IK_BATCH_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Batched inverse kinematics for the 4DOF arm (same convention as robot_manipulator::calcIK)
+//Note: all lengths in milimeters and all angles in degrees
+
+//structure-of-arrays input, every pointer must hold count elements
+struct ik_batch_in {
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* gamma;		//tool angle
+	size_t count;
+};
+
+//structure-of-arrays output, every pointer must hold count elements
+struct ik_batch_out {
+	float* alpha;			//angle at the shoulder
+	float* beta;			//angle at the elbow
+	float* theta;			//angle at the wrist
+	float* theta_0;			//angle at the base joint
+	uint8_t* reachable;		//1 if the lane has a valid solution, 0 otherwise
+};
+
+//Solves every lane using the widest kernel compiled in (AVX, SSE2 or scalar)
+//Unreachable lanes get reachable = 0 and angles computed from clamped acos arguments (never NaN)
+//returns number of reachable lanes
+size_t ik_batch_solve(const ik_batch_in& in, ik_batch_out& out, float l1_len, float l2_len, float l3_len);
+
+//Reference scalar path using libm, same outputs and reachability rules as ik_batch_solve
+size_t ik_batch_solve_scalar(const ik_batch_in& in, ik_batch_out& out, float l1_len, float l2_len, float l3_len);
+
+//returns name of the kernel ik_batch_solve dispatches to ("AVX", "SSE2" or "scalar")
+const char* ik_batch_kernel_name();
+
+//Error bounds of the vectorized approximations (absolute, radians) measured against libm
+//acos: Abramowitz & Stegun 4.4.46 polynomial, |err| <= 2e-8 in exact arithmetic, ~2.4e-7 in float
+//atan2: Abramowitz & Stegun 4.4.49 polynomial after octant reduction, |err| <= 2e-8 exact, ~2.4e-7 in float
+//sin/cos: Cephes minimax polynomials on [-pi/4, pi/4] after quadrant reduction, |err| <= 1.2e-7 for |x| < 8192
+//Resulting joint angles agree with the scalar path to within ~3e-4 degrees for reachable lanes
@@ -0,0 +1,264 @@
+#include "ik_table.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Timer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+//table file header
+static const char IK_TABLE_MAGIC[4] = { 'K', 'X', 'I', 'K' };
+static const uint32_t IK_TABLE_VERSION = 1;
+
+//max spread of any angle between the corners of a cell (degrees)
+//larger spreads mean the atan branch flipped inside the cell or the angle is too steep (acos near +-1)
+//to interpolate accurately, those queries fall back to the closed form solver
+static const float IK_TABLE_MAX_SPREAD = 3.0f;
+
+ik_table::ik_table() {
+    l1_len = 0;
+    l2_len = 0;
+    l3_len = 0;
+    gamma = 0;
+    valid = false;
+    reachable_cnt = 0;
+    build_ms = 0;
+
+    set_box(vec3(-300, 250, 100), vec3(300, 500, 320), 5.0f);
+}
+
+void ik_table::set_box(vec3 box_min, vec3 box_max, float step)
+{
+    this->box_min = box_min;
+    this->box_max = box_max;
+    this->step = step;
+
+    //one extra sample so the upper face of the box is inside the table
+    nx = (int)ceil((box_max.x - box_min.x) / step) + 1;
+    ny = (int)ceil((box_max.y - box_min.y) / step) + 1;
+    nz = (int)ceil((box_max.z - box_min.z) / step) + 1;
+
+    invalidate();
+}
+
+bool ik_table::prepare(float l1_len, float l2_len, float l3_len, float gamma, const string& cache_dir)
+{
+    if (matches(l1_len, l2_len, l3_len, gamma)) return false;
+
+    this->l1_len = l1_len;
+    this->l2_len = l2_len;
+    this->l3_len = l3_len;
+    this->gamma = gamma;
+
+    string path = (fs::path(cache_dir) / cache_name()).string();
+    if (load(path)) {
+        valid = true;
+        return true;
+    }
+
+    build();
+    valid = true;
+
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+    save(path);
+    return false;
+}
+
+bool ik_table::matches(float l1_len, float l2_len, float l3_len, float gamma) const
+{
+    return valid && this->l1_len == l1_len && this->l2_len == l2_len && this->l3_len == l3_len && this->gamma == gamma;
+}
+
+bool ik_table::is_valid() const
+{
+    return valid;
+}
+
+void ik_table::invalidate()
+{
+    valid = false;
+}
+
+size_t ik_table::get_cell_count() const
+{
+    return (size_t)nx * ny * nz;
+}
+
+size_t ik_table::get_reachable_count() const
+{
+    return reachable_cnt;
+}
+
+double ik_table::get_build_ms() const
+{
+    return build_ms;
+}
+
+size_t ik_table::index(int i, int j, int k) const
+{
+    return ((size_t)k * ny + j) * nx + i;
+}
+
+bool ik_table::is_reachable(size_t idx) const
+{
+    return (reachable[idx >> 3] >> (idx & 7)) & 1;
+}
+
+bool ik_table::lookup(vec3 dest, vec4& out) const
+{
+    if (!valid) return false;
+
+    //continuous cell coordinates
+    vec3 f = (dest - box_min) / step;
+    if (f.x < 0 || f.y < 0 || f.z < 0) return false;
+
+    if (f.x > nx - 1 || f.y > ny - 1 || f.z > nz - 1 || nx < 2 || ny < 2 || nz < 2) return false;
+
+    //a point on the last sample row belongs to the cell below it (t = 1) , that row exists so the upper face is covered
+    int i = std::min((int)f.x, nx - 2);
+    int j = std::min((int)f.y, ny - 2);
+    int k = std::min((int)f.z, nz - 2);
+
+    float tx = f.x - i;
+    float ty = f.y - j;
+    float tz = f.z - k;
+
+    //all 8 corners must be solvable
+    size_t c[8];
+    c[0] = index(i, j, k);
+    c[1] = c[0] + 1;
+    c[2] = c[0] + nx;
+    c[3] = c[2] + 1;
+    c[4] = c[0] + (size_t)nx * ny;
+    c[5] = c[4] + 1;
+    c[6] = c[4] + nx;
+    c[7] = c[6] + 1;
+
+    vec4 a_min = angles[c[0]];
+    vec4 a_max = a_min;
+    for (int n = 0; n < 8; n++) {
+        if (!is_reachable(c[n])) return false;
+        a_min = min(a_min, angles[c[n]]);
+        a_max = max(a_max, angles[c[n]]);
+    }
+    vec4 spread = a_max - a_min;
+    if (std::max(std::max(spread.x, spread.y), std::max(spread.z, spread.w)) > IK_TABLE_MAX_SPREAD) return false;
+
+    vec4 x00 = mix(angles[c[0]], angles[c[1]], tx);
+    vec4 x10 = mix(angles[c[2]], angles[c[3]], tx);
+    vec4 x01 = mix(angles[c[4]], angles[c[5]], tx);
+    vec4 x11 = mix(angles[c[6]], angles[c[7]], tx);
+    out = mix(mix(x00, x10, ty), mix(x01, x11, ty), tz);
+    return true;
+}
+
+void ik_table::build()
+{
+    Timer timer(true);
+
+    size_t cells = get_cell_count();
+    angles.resize(cells);
+    reachable.assign((cells + 7) / 8, 0);
+    reachable_cnt = 0;
+
+    //solve one z slice at a time with the batched solver
+    size_t slice = (size_t)nx * ny;
+    vector<float> x(slice), y(slice), z(slice), g(slice, gamma);
+    vector<float> a(slice), b(slice), t(slice), t0(slice);
+    vector<uint8_t> ok(slice);
+
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            x[j * nx + i] = box_min.x + i * step;
+            y[j * nx + i] = box_min.y + j * step;
+        }
+    }
+
+    ik_batch_in in = { x.data(), y.data(), z.data(), g.data(), slice };
+    ik_batch_out out = { a.data(), b.data(), t.data(), t0.data(), ok.data() };
+
+    for (int k = 0; k < nz; k++) {
+        std::fill(z.begin(), z.end(), box_min.z + k * step);
+        reachable_cnt += ik_batch_solve(in, out, l1_len, l2_len, l3_len);
+
+        size_t base = (size_t)k * slice;
+        for (size_t n = 0; n < slice; n++) {
+            angles[base + n] = vec4(a[n], b[n], t[n], t0[n]);
+            if (ok[n]) reachable[(base + n) >> 3] |= (uint8_t)(1 << ((base + n) & 7));
+        }
+    }
+
+    timer.stop();
+    build_ms = timer.getSeconds() * 1000.0;
+}
+
+string ik_table::cache_name() const
+{
+    char buff[128];
+    snprintf(buff, sizeof(buff), "ik_table_%.9g_%.9g_%.9g_g%.9g_s%.9g.bin", l1_len, l2_len, l3_len, gamma, step);
+    return string(buff);
+}
+
+bool ik_table::save(const string& path) const
+{
+    ofstream file(path, ios::binary);
+    if (!file) return false;
+
+    uint32_t dims[3] = { (uint32_t)nx, (uint32_t)ny, (uint32_t)nz };
+    float key[4] = { l1_len, l2_len, l3_len, gamma };
+    uint64_t cnt = reachable_cnt;
+
+    file.write(IK_TABLE_MAGIC, sizeof(IK_TABLE_MAGIC));
+    file.write((const char*)&IK_TABLE_VERSION, sizeof(IK_TABLE_VERSION));
+    file.write((const char*)key, sizeof(key));
+    file.write((const char*)&box_min, sizeof(box_min));
+    file.write((const char*)&step, sizeof(step));
+    file.write((const char*)dims, sizeof(dims));
+    file.write((const char*)&cnt, sizeof(cnt));
+    file.write((const char*)angles.data(), angles.size() * sizeof(vec4));
+    file.write((const char*)reachable.data(), reachable.size());
+    return (bool)file;
+}
+
+bool ik_table::load(const string& path)
+{
+    ifstream file(path, ios::binary);
+    if (!file) return false;
+
+    char magic[4];
+    uint32_t version;
+    float key[4];
+    vec3 file_min;
+    float file_step;
+    uint32_t dims[3];
+    uint64_t cnt;
+
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    file.read((char*)key, sizeof(key));
+    file.read((char*)&file_min, sizeof(file_min));
+    file.read((char*)&file_step, sizeof(file_step));
+    file.read((char*)dims, sizeof(dims));
+    file.read((char*)&cnt, sizeof(cnt));
+    if (!file) return false;
+
+    //reject anything that does not match the current key and box exactly
+    if (memcmp(magic, IK_TABLE_MAGIC, sizeof(magic)) != 0 || version != IK_TABLE_VERSION) return false;
+    if (key[0] != l1_len || key[1] != l2_len || key[2] != l3_len || key[3] != gamma) return false;
+    if (file_min != box_min || file_step != step) return false;
+    if (dims[0] != (uint32_t)nx || dims[1] != (uint32_t)ny || dims[2] != (uint32_t)nz) return false;
+
+    size_t cells = get_cell_count();
+    angles.resize(cells);
+    reachable.resize((cells + 7) / 8);
+    file.read((char*)angles.data(), cells * sizeof(vec4));
+    file.read((char*)reachable.data(), reachable.size());
+    if (!file) return false;
+
+    reachable_cnt = (size_t)cnt;
+    build_ms = 0;
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ik_batch.h"
+
+using namespace ci;
+using namespace std;
+
+//Voxelized joint angle table for a fixed limb geometry and tool angle
+//Answers IK queries inside a box in O(1) by trilinear interpolation of precomputed angles
+//Note: same convention as robot_manipulator::calcIK (milimeters and degrees)
+class ik_table
+{
+	public:
+
+		ik_table();		//default box matches the gcode streaming clamps (x +-300, y 250-500, z 100-320)
+
+		void set_box(vec3 box_min, vec3 box_max, float step);	//change sampled region (invalidates table)
+
+		//make table valid for the given geometry, loads it from cache_dir if a matching file exists
+		//otherwise builds it and saves it. returns true if the table was loaded from disk
+		bool prepare(float l1_len, float l2_len, float l3_len, float gamma, const string& cache_dir);
+
+		bool matches(float l1_len, float l2_len, float l3_len, float gamma) const;	//true if table is valid for this key
+		bool is_valid() const;
+		void invalidate();
+
+		//interpolated angles (alpha , beta , theta , theta_0) for dest (x , y , z)
+		//returns false if dest is outside the box, near an unreachable cell or across an IK branch change
+		bool lookup(vec3 dest, vec4& angles) const;
+
+		size_t get_cell_count() const;
+		size_t get_reachable_count() const;
+		double get_build_ms() const;
+
+	private:
+
+		//table key
+		float l1_len;
+		float l2_len;
+		float l3_len;
+		float gamma;
+		bool valid;
+
+		//sampled region
+		vec3 box_min;
+		vec3 box_max;
+		float step;
+		int nx, ny, nz;		//samples per axis
+
+		vector<vec4> angles;			//(alpha , beta , theta , theta_0) per cell, x fastest
+		vector<uint8_t> reachable;		//one bit per cell
+		size_t reachable_cnt;
+		double build_ms;
+
+		size_t index(int i, int j, int k) const;
+		bool is_reachable(size_t idx) const;
+
+		void build();
+		bool load(const string& path);
+		bool save(const string& path) const;
+		string cache_name() const;		//file name derived from the exact key , so two keys never share a file
+};
@@ -0,0 +1,130 @@
+#include "joint_retarget.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <math.h>
+
+retarget_params::retarget_params() {
+    gain = vec4(1.0f);
+    min_angle = vec4(-10.0f, -170.0f, -150.0f, -90.0f);
+    max_angle = vec4(170.0f, 0.0f, 150.0f, 90.0f);
+    max_speed = 180.0f;
+    min_yaw_reach = 10.0f;
+}
+
+//shortest signed difference of two angles (degrees)
+static float angle_diff(float a, float b)
+{
+    float d = fmodf(a - b + 180.0f, 360.0f);
+    if (d < 0) d += 360.0f;
+    return d - 180.0f;
+}
+
+joint_retarget::joint_retarget() {
+    neutral_set = false;
+    neutral = vec4(0);
+    base = vec4(0);
+    op_angles = vec4(0);
+    output = vec4(0);
+    last_time = 0;
+    limited = false;
+}
+
+void joint_retarget::set_params(const retarget_params& params)
+{
+    this->params = params;
+}
+
+const retarget_params& joint_retarget::get_params() const
+{
+    return params;
+}
+
+bool joint_retarget::measure(const skeleton_pose& pose, int side, vec4& angles) const
+{
+    int shoulder = side == RETARGET_RIGHT ? SKEL_SHOULDER_RIGHT : SKEL_SHOULDER_LEFT;
+    int elbow = side == RETARGET_RIGHT ? SKEL_ELBOW_RIGHT : SKEL_ELBOW_LEFT;
+    int wrist = side == RETARGET_RIGHT ? SKEL_WRIST_RIGHT : SKEL_WRIST_LEFT;
+    int hand = side == RETARGET_RIGHT ? SKEL_HAND_RIGHT : SKEL_HAND_LEFT;
+    if (!pose.valid || pose.state[shoulder] == SKEL_NOT_TRACKED || pose.state[elbow] == SKEL_NOT_TRACKED
+        || pose.state[wrist] == SKEL_NOT_TRACKED || pose.state[hand] == SKEL_NOT_TRACKED) return false;
+
+    vec3 s = pose.joint(shoulder), e = pose.joint(elbow), w = pose.joint(wrist), h = pose.joint(hand);
+
+    //heading of the arm on the floor plane , same convention as the model (reach along (sin th0 , 0 , cos th0))
+    vec3 reach = w - s;
+    float floor_reach = sqrtf(reach.x * reach.x + reach.z * reach.z);
+    if (floor_reach >= params.min_yaw_reach) angles.w = toDegrees(atan2f(reach.x, reach.z));
+    float yaw = toRadians(angles.w);
+    vec3 plane = vec3(sinf(yaw), 0, cosf(yaw));
+
+    //link elevations in that plane , relative angles like the model's chain
+    vec3 upper = e - s, fore = w - e, palm = h - w;
+    float a1 = toDegrees(atan2f(upper.y, dot(upper, plane)));
+    float a2 = toDegrees(atan2f(fore.y, dot(fore, plane)));
+    float a3 = toDegrees(atan2f(palm.y, dot(palm, plane)));
+
+    angles.x = a1;
+    angles.y = angle_diff(a2, a1);
+    angles.z = angle_diff(a3, a2);
+    return true;
+}
+
+float joint_retarget::get_tool_angle(vec4 angles)
+{
+    return angle_diff(angles.x + angles.y + angles.z, 0);
+}
+
+bool joint_retarget::set_neutral(const skeleton_pose& pose, int side, vec4 robot_angles, double now)
+{
+    vec4 angles = op_angles;
+    if (!measure(pose, side, angles)) return false;
+
+    neutral = angles;
+    op_angles = angles;
+    base = robot_angles;
+    output = robot_angles;
+    last_time = now;
+    neutral_set = true;
+    limited = false;
+    return true;
+}
+
+bool joint_retarget::has_neutral() const
+{
+    return neutral_set;
+}
+
+vec4 joint_retarget::apply(const skeleton_pose& pose, int side, double now)
+{
+    float dt = (float)std::max(now - last_time, 0.0);
+    last_time = now;
+    if (!neutral_set || !measure(pose, side, op_angles)) return output;
+
+    limited = false;
+    float step = params.max_speed > 0 ? params.max_speed * dt : 1e9f;
+    for (int i = 0; i < 4; i++) {
+        float target = base[i] + params.gain[i] * angle_diff(op_angles[i], neutral[i]);
+        float clamped = glm::clamp(target, params.min_angle[i], params.max_angle[i]);
+        float moved = output[i] + glm::clamp(clamped - output[i], -step, step);
+        if (clamped != target || moved != clamped) limited = true;
+        output[i] = moved;
+    }
+    return output;
+}
+
+void joint_retarget::set_output(vec4 angles)
+{
+    output = angles;
+    limited = true;
+}
+
+vec4 joint_retarget::get_operator_angles() const
+{
+    return op_angles;
+}
+
+bool joint_retarget::is_limited() const
+{
+    return limited;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cinder/Vector.h"
+
+#include "skeleton_frame.h"
+
+using namespace ci;
+
+//operator arm the joints are read from
+enum retarget_side {
+	RETARGET_LEFT = 0,
+	RETARGET_RIGHT
+};
+
+//per robot joint , all (alpha , beta , theta , theta_0) in degrees
+struct retarget_params {
+	vec4 gain;					//robot degrees per operator degree away from the neutral pose (negative mirrors a joint)
+	vec4 min_angle;				//robot joint limits , theta_0 within the +-90 degrees the firmware base reaches
+	vec4 max_angle;
+	float max_speed;			//deg/s any joint may move , 0 for no limit
+	float min_yaw_reach;		//shoulder to wrist distance (cm , floor plane) below which the base keeps its last yaw
+
+	retarget_params();
+};
+
+//Joint space teleop: the operator's own shoulder , elbow and wrist angles drive alpha , beta and theta , the arm's heading drives theta_0
+//Angles are read in the vertical plane through the shoulder and wrist (robot axes , y up) the same way the robot model measures them:
+//alpha is the upper arm elevation , beta the elbow bend , theta the hand against the forearm
+//The operator's pose when set_neutral is called maps to the robot angles at that moment , from there each joint follows
+//the operator's change times its gain , clamped to its limits and slew limited. No IK is solved so there is nothing to be out of reach
+class joint_retarget
+{
+	public:
+
+		joint_retarget();
+
+		void set_params(const retarget_params& params);
+		const retarget_params& get_params() const;
+
+		//operator arm angles in pose (robot axes) , false if a joint of the arm is not tracked
+		//yaw is only updated while the arm reaches out far enough to have a heading
+		bool measure(const skeleton_pose& pose, int side, vec4& angles) const;
+
+		//absolute angle of the hand (wrist -> hand) in that plane from measured arm angles , the operator's alpha + beta + theta
+		static float get_tool_angle(vec4 angles);
+
+		//pair the operator's current pose with robot_angles at time now (same clock as apply) , false if the arm is not visible
+		bool set_neutral(const skeleton_pose& pose, int side, vec4 robot_angles, double now);
+		bool has_neutral() const;
+
+		//robot angles for the operator's pose at time now (seconds) , the last output is held while the arm is not visible
+		vec4 apply(const skeleton_pose& pose, int side, double now);
+
+		//replace the last output (e.g. projected back into a workspace box) , the next apply slews on from there
+		void set_output(vec4 angles);
+
+		vec4 get_operator_angles() const;		//last measured operator arm
+		bool is_limited() const;				//last output was clamped or slew limited
+
+	private:
+
+		retarget_params params;
+
+		bool neutral_set;
+		vec4 neutral;				//operator angles paired with base
+		vec4 base;					//robot angles at set_neutral
+		vec4 op_angles;
+		vec4 output;
+		double last_time;
+		bool limited;
+};
@@ -0,0 +1,104 @@
+#include "joint_transform.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define JOINT_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+//poses are transformed four joints at a time (unaligned loads, heap objects are only 8 byte aligned on 32 bit builds)
+static_assert(SKEL_JOINT_COUNT % 4 == 0, "joint arrays must be a multiple of 4 floats");
+
+transform_params::transform_params() {
+    scale = 100.0f;
+    axes = ivec3(0, 1, 2);
+    mirror = glm::bvec3(false);
+    offset = vec3(0);
+}
+
+joint_transform::joint_transform() {
+    set_matrix(mat4(1.0f));
+}
+
+void joint_transform::set(const transform_params& params)
+{
+    //glm matrices are column major: m[sensor axis][robot axis]
+    mat4 map(0.0f);
+    for (int i = 0; i < 3; i++) {
+        int axis = glm::clamp(params.axes[i], 0, 2);
+        map[axis][i] = params.mirror[i] ? -params.scale : params.scale;
+    }
+    map[3] = vec4(params.offset, 1.0f);
+    set_matrix(map);
+}
+
+void joint_transform::set_matrix(const mat4& m)
+{
+    this->m = m;
+    for (int i = 0; i < 3; i++) {
+        rows[i][0] = m[0][i];
+        rows[i][1] = m[1][i];
+        rows[i][2] = m[2][i];
+        rows[i][3] = m[3][i];
+    }
+}
+
+const mat4& joint_transform::get_matrix() const
+{
+    return m;
+}
+
+void joint_transform::apply(skeleton_pose& pose) const
+{
+#ifdef JOINT_TRANSFORM_SSE
+    __m128 r[3][4];
+    for (int i = 0; i < 3; i++)
+        for (int k = 0; k < 4; k++) r[i][k] = _mm_set1_ps(rows[i][k]);
+
+    for (int j = 0; j < SKEL_JOINT_COUNT; j += 4) {
+        __m128 x = _mm_loadu_ps(pose.x + j);
+        __m128 y = _mm_loadu_ps(pose.y + j);
+        __m128 z = _mm_loadu_ps(pose.z + j);
+
+        __m128 out[3];
+        for (int i = 0; i < 3; i++) {
+            out[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[i][0], x), _mm_mul_ps(r[i][1], y)),
+                                _mm_add_ps(_mm_mul_ps(r[i][2], z), r[i][3]));
+        }
+
+        _mm_storeu_ps(pose.x + j, out[0]);
+        _mm_storeu_ps(pose.y + j, out[1]);
+        _mm_storeu_ps(pose.z + j, out[2]);
+    }
+#else
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        float x = pose.x[j], y = pose.y[j], z = pose.z[j];
+        pose.x[j] = rows[0][0] * x + rows[0][1] * y + rows[0][2] * z + rows[0][3];
+        pose.y[j] = rows[1][0] * x + rows[1][1] * y + rows[1][2] * z + rows[1][3];
+        pose.z[j] = rows[2][0] * x + rows[2][1] * y + rows[2][2] * z + rows[2][3];
+    }
+#endif
+}
+
+vec3 joint_transform::apply(vec3 p) const
+{
+    return vec3(m * vec4(p, 1.0f));
+}
+
+vec3 joint_transform::apply_vector(vec3 v) const
+{
+    return vec3(m * vec4(v, 0.0f));
+}
+
+const char* joint_transform::get_axis_name(int axis)
+{
+    switch (axis) {
+        case 0:
+            return "sensor x";
+        case 1:
+            return "sensor y";
+        case 2:
+            return "sensor z";
+        default:
+            return "sensor x";
+    }
+}
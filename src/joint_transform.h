@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+
+#include "skeleton_frame.h"
+
+using namespace ci;
+
+//how sensor joints map onto robot axes
+struct transform_params {
+	float scale;				//robot units per sensor unit (cm per m)
+	ivec3 axes;					//sensor axis (0 x , 1 y , 2 z) feeding each robot axis
+	glm::bvec3 mirror;			//negate a robot axis after the remap
+	vec3 offset;				//added last (robot units)
+
+	transform_params();
+};
+
+//One affine map applied to every joint of a pose in a single pass
+//Poses are stored as x , y , z arrays so four joints go through the matrix per SSE instruction
+//(scalar loop on targets without SSE)
+class joint_transform
+{
+	public:
+
+		joint_transform();							//identity
+
+		void set(const transform_params& params);	//scale , remap , mirror then offset
+		void set_matrix(const mat4& m);				//any affine map (the last row is ignored)
+		const mat4& get_matrix() const;
+
+		void apply(skeleton_pose& pose) const;		//all joints in place
+		vec3 apply(vec3 p) const;					//one point
+		vec3 apply_vector(vec3 v) const;			//one direction (no offset)
+
+		static const char* get_axis_name(int axis);
+
+	private:
+
+		mat4 m;
+
+		//rows of the 3x4 part (r0 r1 r2 t) per output axis , laid out for broadcasting
+		float rows[3][4];
+};
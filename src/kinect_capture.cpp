@@ -0,0 +1,182 @@
+#include "kinect_capture.h"
+#include "cinder/app/App.h"
+
+//frames buffered between capture and control loop (about a second at 30 fps)
+#define CAPTURE_RING_SIZE 32
+
+//wake up this often without a frame to check for stop and mode changes (milliseconds)
+#define CAPTURE_WAIT_MS 100
+
+kinect_capture::kinect_capture() : ring(CAPTURE_RING_SIZE) {
+    sensor = NULL;
+    frame_ready = NULL;
+    running = false;
+    seated_req = true;
+    seated = true;
+    smoothing = false;
+    captured = 0;
+    dropped = 0;
+    delivered = 0;
+}
+
+kinect_capture::~kinect_capture() {
+    stop();
+}
+
+bool kinect_capture::start()
+{
+    stop();
+
+    //Checking for sensor number
+    int sensor_cnt = 0;
+    if (NuiGetSensorCount(&sensor_cnt) < 0 || sensor_cnt < 1) {
+        error = "No Kinects found";
+        OutputDebugStringA("No Kinects found\n");
+        return false;
+    }
+
+    //Connect to kinect found (only first one)
+    if (FAILED(NuiCreateSensorByIndex(0, &sensor))) {
+        error = "Failed to connect to kinect";
+        OutputDebugStringA("Failed to connect to kinect\n");
+        sensor = NULL;
+        return false;
+    }
+    OutputDebugStringA("Kinect object created\n");
+
+    //Initialize kinect for skeleton tracking
+    sensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_SKELETON);
+    frame_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    //tracking mode requested before start is applied right away
+    seated = seated_req;
+    sensor->NuiSkeletonTrackingEnable(frame_ready, seated ? NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT : 0);
+
+    error = "";
+    captured = 0;
+    dropped = 0;
+    delivered = 0;
+
+    running = true;
+    thread = std::thread(&kinect_capture::run, this);
+    return true;
+}
+
+void kinect_capture::stop()
+{
+    running = false;
+    if (thread.joinable()) thread.join();
+
+    //capture thread must be done with the sensor first
+    if (sensor) {
+        sensor->Release();			//Release sensor (might cause some detection errors if not)
+        sensor = NULL;
+        OutputDebugStringA("Kinect cleaned up\n");
+    }
+    if (frame_ready) {
+        CloseHandle(frame_ready);
+        frame_ready = NULL;
+    }
+}
+
+void kinect_capture::set_seated(bool seated)
+{
+    seated_req = seated;
+}
+
+void kinect_capture::set_sensor_smoothing(bool smoothing)
+{
+    this->smoothing = smoothing;
+}
+
+bool kinect_capture::pop(skeleton_frame& frame)
+{
+    if (!ring.tryPopBack(&frame)) return false;
+    delivered++;
+    return true;
+}
+
+const char* kinect_capture::get_name() const
+{
+    return "Kinect";
+}
+
+uint32_t kinect_capture::get_delivered() const
+{
+    return delivered;
+}
+
+string kinect_capture::get_error() const
+{
+    return error;
+}
+
+uint32_t kinect_capture::get_captured() const
+{
+    return captured;
+}
+
+uint32_t kinect_capture::get_dropped() const
+{
+    return dropped;
+}
+
+size_t kinect_capture::get_queued() const
+{
+    return ring.getSize();
+}
+
+void kinect_capture::convert(const NUI_SKELETON_FRAME& in, skeleton_frame& out)
+{
+    out.timestamp = in.liTimeStamp.QuadPart;
+    out.number = in.dwFrameNumber;
+    out.floor = vec4(in.vFloorClipPlane.x, in.vFloorClipPlane.y, in.vFloorClipPlane.z, in.vFloorClipPlane.w);
+
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        const NUI_SKELETON_DATA& data = in.SkeletonData[b];
+        skeleton_body& body = out.bodies[b];
+        body.tracked = data.eTrackingState == NUI_SKELETON_TRACKED;
+        body.id = data.dwTrackingID;
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+            const Vector4& p = data.SkeletonPositions[j];
+            body.joints[j] = vec3(p.x, p.y, p.z);
+            body.state[j] = (uint8_t)data.eSkeletonPositionTrackingState[j];
+        }
+    }
+}
+
+void kinect_capture::run()
+{
+    NUI_SKELETON_FRAME nui_frame = { 0 };
+    skeleton_frame frame;
+
+    while (running) {
+        //tracking is reconfigured only when the seated flag actually changed
+        bool want_seated = seated_req;
+        if (want_seated != seated) {
+            sensor->NuiSkeletonTrackingEnable(frame_ready, want_seated ? NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT : 0);
+            seated = want_seated;
+        }
+
+        if (WaitForSingleObject(frame_ready, CAPTURE_WAIT_MS) != WAIT_OBJECT_0) continue;
+
+        if (FAILED(sensor->NuiSkeletonGetNextFrame(0, &nui_frame))) {
+            OutputDebugStringA("Couldn't get next frame\n");
+            continue;
+        }
+        frame.time = app::getElapsedSeconds();
+
+        //sensor side smoothing only if asked for, the pipeline's joint filter does it with known lag
+        if (smoothing) sensor->NuiTransformSmooth(&nui_frame, 0);
+        convert(nui_frame, frame);
+
+        //ring full: drop the oldest frame, fresh data matters more than history
+        captured++;
+        if (!ring.tryPushFront(frame)) {
+            skeleton_frame oldest;
+            ring.tryPopBack(&oldest);
+            ring.tryPushFront(frame);
+            dropped++;
+        }
+    }
+}
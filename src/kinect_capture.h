@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <thread>
+
+#include "NuiApi.h"
+#include "cinder/ConcurrentCircularBuffer.h"
+#include "skeleton_source.h"
+
+using namespace ci;
+
+//Kinect v1 skeleton source, capture on its own thread
+//Blocks on the skeleton event, converts and timestamps every frame and pushes it into a single producer / single consumer ring
+//The control loop drains the ring every update so no sensor frame is lost while rendering or ImGui is slow
+class kinect_capture : public skeleton_source
+{
+	public:
+
+		kinect_capture();
+		~kinect_capture();
+
+		bool start() override;			//connects to the first sensor and starts the capture thread
+		void stop() override;			//joins the capture thread and releases the sensor, safe to call if never started
+
+		void set_seated(bool seated) override;	//re-enables tracking on the capture thread only if the mode changed
+		void set_sensor_smoothing(bool smoothing) override;	//NuiTransformSmooth with default parameters, off by default (adds latency)
+		bool pop(skeleton_frame& frame) override;	//oldest queued frame, false if the ring is empty
+
+		const char* get_name() const override;
+		uint32_t get_delivered() const override;
+		uint32_t get_dropped() const override;	//frames lost because the ring was full
+		string get_error() const override;
+
+		uint32_t get_captured() const;	//frames fetched from the sensor
+		size_t get_queued() const;		//frames waiting to be drained
+
+	private:
+
+		INuiSensor* sensor;
+		HANDLE frame_ready;
+		string error;
+
+		ConcurrentCircularBuffer<skeleton_frame> ring;
+		std::thread thread;
+		std::atomic<bool> running;
+		std::atomic<bool> seated_req;	//requested by the ui
+		bool seated;					//applied to the sensor (capture thread only)
+		std::atomic<bool> smoothing;
+
+		std::atomic<uint32_t> captured;
+		std::atomic<uint32_t> dropped;
+		uint32_t delivered;
+
+		void run();
+		static void convert(const NUI_SKELETON_FRAME& in, skeleton_frame& out);
+};
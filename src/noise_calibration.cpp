@@ -0,0 +1,341 @@
+#include "noise_calibration.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+
+//profile file header
+static const char* FILTER_PROFILE_MAGIC = "KXRFILTER";
+static const int FILTER_PROFILE_VERSION = 1;
+
+//fewer tracked frames than this is not a measurement
+static const size_t CALIB_MIN_FRAMES = 30;
+
+//joint noise above this (mm) means the operator did not hold still
+static const float CALIB_MAX_NOISE_MM = 30.0f;
+
+//candidate settings, One-Euro as (min_cutoff , beta) pairs and Kalman by process noise
+static const float CALIB_MIN_CUTOFFS[] = { 0.3f, 0.5f, 0.8f, 1.2f, 1.8f, 2.5f, 3.5f, 5.0f, 8.0f };
+static const float CALIB_BETAS[] = { 0.0f, 1.0f, 2.0f, 5.0f, 10.0f, 20.0f, 40.0f };
+static const float CALIB_PROCESS_NOISES[] = { 0.1f, 0.2f, 0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 20.0f };
+
+calib_params::calib_params() {
+    duration = 5.0f;
+    latency_budget_ms = 60.0f;
+    max_jitter_mm = 1.5f;
+    test_speed = 0.5f;
+}
+
+noise_calibration::noise_calibration() {
+    running = false;
+    done = false;
+    start_time = 0;
+    follow_id = 0;
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        noise[j].noise_mm = 0;
+        noise[j].drift_mm_s = 0;
+        noise[j].samples = 0;
+    }
+    result_lag = 0;
+    result_jitter = 0;
+    budget_met = false;
+}
+
+void noise_calibration::set_params(const calib_params& params)
+{
+    this->params = params;
+}
+
+const calib_params& noise_calibration::get_params() const
+{
+    return params;
+}
+
+void noise_calibration::start(const filter_params& base)
+{
+    this->base = base;
+    frames.clear();
+    frames.reserve((size_t)(params.duration * 30.0f) + 1);
+    follow_id = 0;
+    start_time = -1;
+    error = "";
+    done = false;
+    running = true;
+}
+
+void noise_calibration::cancel()
+{
+    running = false;
+    frames.clear();
+}
+
+bool noise_calibration::add_frame(const skeleton_frame& frame)
+{
+    if (!running) return false;
+
+    //the clock starts with the first frame of the run , tracked or not , so an empty room still times out
+    if (start_time < 0) start_time = frame.time;
+
+    //keep measuring the same person
+    const skeleton_body* body = NULL;
+    for (int b = 0; b < SKEL_BODY_COUNT && !body; b++) {
+        if (frame.bodies[b].tracked && (follow_id == 0 || frame.bodies[b].id == follow_id)) body = &frame.bodies[b];
+    }
+    if (body) {
+        follow_id = body->id;
+
+        skeleton_frame kept;
+        kept.time = frame.time;
+        kept.timestamp = frame.timestamp;
+        kept.number = frame.number;
+        kept.floor = frame.floor;
+        kept.bodies[0] = *body;
+        frames.push_back(kept);
+    }
+
+    if (frame.time - start_time < params.duration) return false;
+
+    //done collecting
+    running = false;
+    if (frames.size() < CALIB_MIN_FRAMES) {
+        error = "Nobody was tracked during calibration";
+        frames.clear();
+        return true;
+    }
+
+    measure_noise();
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        if (noise[j].samples > 0 && noise[j].noise_mm > CALIB_MAX_NOISE_MM) {
+            error = "Too much movement , hold still and try again";
+            frames.clear();
+            return true;
+        }
+    }
+
+    tune();
+    frames.clear();
+    done = true;
+    return true;
+}
+
+bool noise_calibration::is_running() const
+{
+    return running;
+}
+
+bool noise_calibration::is_done() const
+{
+    return done;
+}
+
+float noise_calibration::get_progress() const
+{
+    if (!running || frames.empty() || params.duration <= 0) return done ? 1.0f : 0.0f;
+    return std::min((float)((frames.back().time - start_time) / params.duration), 1.0f);
+}
+
+string noise_calibration::get_error() const
+{
+    return error;
+}
+
+const joint_noise& noise_calibration::get_noise(int joint) const
+{
+    return noise[joint];
+}
+
+const filter_params& noise_calibration::get_result() const
+{
+    return result;
+}
+
+float noise_calibration::get_result_lag() const
+{
+    return result_lag;
+}
+
+float noise_calibration::get_result_jitter() const
+{
+    return result_jitter;
+}
+
+bool noise_calibration::is_budget_met() const
+{
+    return budget_met;
+}
+
+void noise_calibration::measure_noise()
+{
+    //per joint and axis: least squares line through the tracked samples, noise is what is left around it
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        double n = 0, st = 0, stt = 0;
+        dvec3 sx(0), sxt(0), sxx(0);
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            const skeleton_body& body = frames[i].bodies[0];
+            if (body.state[j] != SKEL_TRACKED) continue;
+
+            double t = frames[i].time - start_time;
+            dvec3 p = dvec3(body.joints[j]);
+            n += 1;
+            st += t;
+            stt += t * t;
+            sx += p;
+            sxt += p * t;
+            sxx += p * p;
+        }
+
+        noise[j].samples = (uint32_t)n;
+        noise[j].noise_mm = 0;
+        noise[j].drift_mm_s = 0;
+        if (n < 2) continue;
+
+        double var_t = stt / n - (st / n) * (st / n);
+        dvec3 mean = sx / n;
+        dvec3 var = sxx / n - mean * mean;
+        dvec3 cov = sxt / n - mean * (st / n);
+        dvec3 slope = var_t > 0 ? cov / var_t : dvec3(0);
+        dvec3 resid = glm::max(var - slope * slope * var_t, dvec3(0));
+
+        noise[j].noise_mm = (float)(sqrt(resid.x + resid.y + resid.z) * 1000.0);
+        noise[j].drift_mm_s = (float)(length(slope) * 1000.0);
+    }
+}
+
+void noise_calibration::evaluate(const filter_params& candidate, float& lag, float& jitter) const
+{
+    //at rest: the frames as recorded
+    skeleton_filter rest;
+    rest.set_params(candidate);
+    rest.reset();
+    for (size_t i = 0; i < frames.size(); i++) {
+        skeleton_frame frame = frames[i];
+        rest.filter(frame);
+    }
+    jitter = rest.get_stats().jitter_mm;
+
+    //moving: the same noise on a body sliding sideways at test_speed
+    skeleton_filter moving;
+    moving.set_params(candidate);
+    moving.reset();
+    for (size_t i = 0; i < frames.size(); i++) {
+        skeleton_frame frame = frames[i];
+        vec3 offset = vec3(params.test_speed * (float)(frame.time - start_time), 0, 0);
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) frame.bodies[0].joints[j] += offset;
+        moving.filter(frame);
+    }
+    lag = moving.get_stats().lag_ms;
+}
+
+void noise_calibration::tune()
+{
+    //Kalman measurement noise from the median tracked joint (per axis , m)
+    vector<float> joint_noise_m;
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++)
+        if (noise[j].samples > 0) joint_noise_m.push_back(noise[j].noise_mm / 1000.0f / sqrtf(3.0f));
+    std::sort(joint_noise_m.begin(), joint_noise_m.end());
+    float sigma = joint_noise_m.empty() ? base.measurement_noise : std::max(joint_noise_m[joint_noise_m.size() / 2], 0.001f);
+
+    vector<filter_params> candidates;
+    for (float cutoff : CALIB_MIN_CUTOFFS) {
+        for (float beta : CALIB_BETAS) {
+            filter_params c = base;
+            c.kind = FILTER_ONE_EURO;
+            c.min_cutoff = cutoff;
+            c.beta = beta;
+            candidates.push_back(c);
+        }
+    }
+    for (float q : CALIB_PROCESS_NOISES) {
+        filter_params c = base;
+        c.kind = FILTER_KALMAN;
+        c.process_noise = q;
+        c.measurement_noise = sigma;
+        candidates.push_back(c);
+    }
+
+    //lowest lag without chatter , otherwise the quietest setting inside the latency budget , otherwise the quietest overall
+    int best_quiet = -1, best_budget = -1, best_any = -1;
+    float lag_quiet = 0, jitter_budget = 0, jitter_any = 0;
+    vector<float> lags(candidates.size()), jitters(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+        evaluate(candidates[i], lags[i], jitters[i]);
+        if (jitters[i] <= params.max_jitter_mm && (best_quiet < 0 || lags[i] < lag_quiet)) {
+            best_quiet = (int)i;
+            lag_quiet = lags[i];
+        }
+        if (lags[i] <= params.latency_budget_ms && (best_budget < 0 || jitters[i] < jitter_budget)) {
+            best_budget = (int)i;
+            jitter_budget = jitters[i];
+        }
+        if (best_any < 0 || jitters[i] < jitter_any) {
+            best_any = (int)i;
+            jitter_any = jitters[i];
+        }
+    }
+
+    int best = best_quiet >= 0 ? best_quiet : (best_budget >= 0 ? best_budget : best_any);
+    result = candidates[best];
+    result_lag = lags[best];
+    result_jitter = jitters[best];
+    budget_met = result_lag <= params.latency_budget_ms && result_jitter <= params.max_jitter_mm;
+}
+
+bool noise_calibration::save_profile(const string& path) const
+{
+    if (!done) return false;
+
+    ofstream file(path);
+    if (!file) return false;
+
+    file << FILTER_PROFILE_MAGIC << " " << FILTER_PROFILE_VERSION << "\n";
+    file << "kind " << result.kind << "\n";
+    file << "min_cutoff " << result.min_cutoff << "\n";
+    file << "beta " << result.beta << "\n";
+    file << "d_cutoff " << result.d_cutoff << "\n";
+    file << "process_noise " << result.process_noise << "\n";
+    file << "measurement_noise " << result.measurement_noise << "\n";
+    file << "inferred_weight " << result.inferred_weight << "\n";
+
+    //what the choice was based on (ignored when loading)
+    file << "lag_ms " << result_lag << "\n";
+    file << "jitter_mm " << result_jitter << "\n";
+    file << "latency_budget_ms " << params.latency_budget_ms << "\n";
+    file << "max_jitter_mm " << params.max_jitter_mm << "\n";
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++)
+        file << "noise " << j << " " << noise[j].noise_mm << " " << noise[j].drift_mm_s << " " << noise[j].samples << "\n";
+    return (bool)file;
+}
+
+bool noise_calibration::load_profile(const string& path, filter_params& params)
+{
+    ifstream file(path);
+    if (!file) return false;
+
+    string magic;
+    int version = 0;
+    file >> magic >> version;
+    if (magic != FILTER_PROFILE_MAGIC || version != FILTER_PROFILE_VERSION) return false;
+
+    filter_params loaded = params;
+    string key;
+    while (file >> key) {
+        if (key == "kind") file >> loaded.kind;
+        else if (key == "min_cutoff") file >> loaded.min_cutoff;
+        else if (key == "beta") file >> loaded.beta;
+        else if (key == "d_cutoff") file >> loaded.d_cutoff;
+        else if (key == "process_noise") file >> loaded.process_noise;
+        else if (key == "measurement_noise") file >> loaded.measurement_noise;
+        else if (key == "inferred_weight") file >> loaded.inferred_weight;
+        else {
+            //informational line
+            string rest;
+            getline(file, rest);
+        }
+        if (!file) return false;
+    }
+    if (loaded.kind < 0 || loaded.kind >= FILTER_KIND_COUNT) return false;
+
+    params = loaded;
+    return true;
+}
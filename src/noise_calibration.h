@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "skeleton_filter.h"
+#include "skeleton_frame.h"
+
+using namespace std;
+
+struct calib_params {
+	float duration;				//seconds the operator holds still
+	float latency_budget_ms;	//lag the chosen filter should stay under while the arm moves
+	float max_jitter_mm;		//output jitter (filter_stats::jitter_mm) at rest above which the arm chatters
+	float test_speed;			//joint speed the lag is measured at (m/s)
+
+	calib_params();
+};
+
+//noise of one joint while the operator held still
+struct joint_noise {
+	float noise_mm;				//rms distance from the joint's drift line
+	float drift_mm_s;			//speed of the drift line (slow sway , sensor warm up)
+	uint32_t samples;			//tracked frames measured
+};
+
+//Sensor noise characterization and filter auto tuning
+//While running every frame of the followed body is kept. At the end each joint gets a noise and a drift figure and
+//every candidate filter setting is run over the recorded frames twice: as recorded (chatter at rest) and with the body
+//moved at test_speed (lag). The lowest lag setting that stays under max_jitter_mm wins
+class noise_calibration
+{
+	public:
+
+		noise_calibration();
+
+		void set_params(const calib_params& params);
+		const calib_params& get_params() const;
+
+		//start collecting , base carries the settings the tuning does not touch (inferred weight)
+		void start(const filter_params& base);
+		void cancel();
+
+		//feed one raw frame (before the bone constraint and the joint filter), true on the frame that finished the run
+		bool add_frame(const skeleton_frame& frame);
+
+		bool is_running() const;
+		bool is_done() const;			//finished with a result
+		float get_progress() const;		//0..1 of duration
+		string get_error() const;		//why the last run produced no result
+
+		const joint_noise& get_noise(int joint) const;
+		const filter_params& get_result() const;
+		float get_result_lag() const;		//ms at test_speed
+		float get_result_jitter() const;	//mm at rest
+		bool is_budget_met() const;			//result lag within latency_budget_ms and jitter within max_jitter_mm
+
+		//filter profile (text): the chosen params plus the noise figures they came from
+		bool save_profile(const string& path) const;
+		static bool load_profile(const string& path, filter_params& params);
+
+	private:
+
+		calib_params params;
+		filter_params base;
+
+		bool running;
+		bool done;
+		string error;
+
+		vector<skeleton_frame> frames;		//followed body only , in slot 0
+		double start_time;					//first frame of the run , negative until it arrives
+		uint32_t follow_id;
+
+		joint_noise noise[SKEL_JOINT_COUNT];
+		filter_params result;
+		float result_lag;
+		float result_jitter;
+		bool budget_met;
+
+		void measure_noise();
+		void tune();
+		void evaluate(const filter_params& candidate, float& lag, float& jitter) const;
+};
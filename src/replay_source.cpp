@@ -0,0 +1,300 @@
+#include "replay_source.h"
+
+#include <sstream>
+#include <stdio.h>
+
+//first line of every recording
+#define SKEL_TEXT_MAGIC "KXRSKEL"
+#define SKEL_TEXT_VERSION 1
+
+//gap inserted between the last and first frame when looping (one Kinect frame)
+static const double REPLAY_LOOP_GAP = 1.0 / 30.0;
+
+replay_source::replay_source(const string& path) {
+    this->path = path;
+    realtime = false;
+    loop = false;
+    has_next = false;
+    binary = false;
+    archive = false;
+    cursor = 0;
+    first_time = 0;
+    loop_offset = 0;
+    clock_offset = 0;
+    delivered = 0;
+}
+
+void replay_source::set_realtime(bool realtime)
+{
+    this->realtime = realtime;
+}
+
+void replay_source::set_loop(bool loop)
+{
+    this->loop = loop;
+}
+
+bool replay_source::start()
+{
+    stop();
+
+    error = "";
+    delivered = 0;
+    loop_offset = 0;
+    clock_offset = 0;
+
+    //binary recordings are mapped , everything else is taken as text
+    binary = recording_reader::is_recording(path);
+    if (binary) {
+        if (!reader.open(path)) {
+            error = reader.get_error();
+            return false;
+        }
+        if (reader.get_count() == 0) {
+            error = path + " has no frames";
+            reader.close();
+            return false;
+        }
+        cursor = 0;
+        first_time = reader.get_start_time();
+        clock.start();
+        return true;
+    }
+
+    archive = archive_reader::is_archive(path);
+    if (!archive) file.open(path);
+    if (!archive && !file) {
+        error = "Could not open " + path;
+        return false;
+    }
+    if (!rewind()) {
+        file.close();
+        return false;
+    }
+
+    first_time = next.time;
+    clock.start();
+    return true;
+}
+
+void replay_source::stop()
+{
+    if (file.is_open()) file.close();
+    archive_in.close();
+    reader.close();
+    cursor = 0;
+    has_next = false;
+    clock.stop();
+}
+
+bool replay_source::rewind()
+{
+    //archives are streamed , start over by reopening
+    if (archive) {
+        if (!archive_in.open(path)) {
+            error = archive_in.get_error();
+            return false;
+        }
+        if (!read_next()) {
+            error = path + " has no frames";
+            return false;
+        }
+        return true;
+    }
+
+    file.clear();
+    file.seekg(0);
+
+    string line;
+    int version = 0;
+    string magic;
+    if (getline(file, line)) {
+        istringstream in(line);
+        in >> magic >> version;
+    }
+    if (magic != SKEL_TEXT_MAGIC || version != SKEL_TEXT_VERSION) {
+        error = path + " is not a skeleton recording";
+        return false;
+    }
+
+    if (!read_next()) {
+        if (error.empty()) error = path + " has no frames";
+        return false;
+    }
+    return true;
+}
+
+bool replay_source::read_next()
+{
+    if (archive) {
+        has_next = archive_in.next(next);
+        return has_next;
+    }
+
+    next = skeleton_frame();
+    has_next = false;
+
+    bool in_frame = false;
+    string line;
+    while (true) {
+        streampos pos = file.tellg();
+        if (!getline(file, line)) break;
+        if (line.empty() || line[0] == '#') continue;
+
+        istringstream in(line);
+        char tag = 0;
+        in >> tag;
+
+        if (tag == 'F') {
+            //start of the following frame, leave it for the next call
+            if (in_frame) {
+                file.seekg(pos);
+                break;
+            }
+            in >> next.time >> next.timestamp >> next.number >> next.floor.x >> next.floor.y >> next.floor.z >> next.floor.w;
+            if (!in) {
+                error = "Bad frame line in " + path;
+                return false;
+            }
+            in_frame = true;
+        }
+        else if (tag == 'B' && in_frame) {
+            int b;
+            uint32_t id;
+            in >> b >> id;
+            if (!in || b < 0 || b >= SKEL_BODY_COUNT) {
+                error = "Bad body line in " + path;
+                return false;
+            }
+
+            skeleton_body& body = next.bodies[b];
+            body.tracked = true;
+            body.id = id;
+            for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+                int state;
+                in >> body.joints[j].x >> body.joints[j].y >> body.joints[j].z >> state;
+                body.state[j] = (uint8_t)state;
+            }
+            if (!in) {
+                error = "Bad body line in " + path;
+                return false;
+            }
+        }
+    }
+
+    has_next = in_frame;
+    return in_frame;
+}
+
+double replay_source::next_time() const
+{
+    double t = binary ? reader.get_frame(cursor).time : next.time;
+    return t - first_time + loop_offset;
+}
+
+double replay_source::get_clock() const
+{
+    return clock.getSeconds() + clock_offset;
+}
+
+bool replay_source::pop(skeleton_frame& frame)
+{
+    if (finished()) return false;
+
+    double t = next_time();
+    if (realtime && get_clock() < t) return false;
+
+    delivered++;
+
+    //straight out of the mapping
+    if (binary) {
+        frame = reader.get_frame(cursor++);
+        frame.time = t;
+
+        if (cursor == reader.get_count() && loop) {
+            loop_offset = t + REPLAY_LOOP_GAP;
+            cursor = 0;
+        }
+        return true;
+    }
+
+    frame = next;
+    frame.time = t;
+
+    //end of file, keep going from the top if looping
+    if (!read_next() && loop && error.empty()) {
+        loop_offset = t + REPLAY_LOOP_GAP;
+        rewind();
+    }
+    return true;
+}
+
+bool replay_source::finished() const
+{
+    if (binary) return cursor >= reader.get_count();
+    return !has_next;
+}
+
+bool replay_source::seek(double t)
+{
+    if (!binary || !reader.is_open()) return false;
+
+    cursor = reader.find_time(first_time + t);
+    loop_offset = 0;
+    if (cursor == reader.get_count() && loop) cursor = 0;
+
+    //realtime playback continues from the new position
+    clock_offset = (finished() ? t : next_time()) - clock.getSeconds();
+    return true;
+}
+
+double replay_source::get_duration() const
+{
+    if (!binary || !reader.is_open()) return 0;
+    return reader.get_end_time() - first_time;
+}
+
+double replay_source::get_position() const
+{
+    return finished() ? get_duration() : next_time();
+}
+
+const char* replay_source::get_name() const
+{
+    return "Replay";
+}
+
+uint32_t replay_source::get_delivered() const
+{
+    return delivered;
+}
+
+string replay_source::get_error() const
+{
+    return error;
+}
+
+void write_skeleton_text_header(ostream& out)
+{
+    out << SKEL_TEXT_MAGIC << " " << SKEL_TEXT_VERSION << "\n";
+}
+
+void write_skeleton_text(ostream& out, const skeleton_frame& frame)
+{
+    char buff[64];
+
+    snprintf(buff, sizeof(buff), "F %.6f %lld %u", frame.time, (long long)frame.timestamp, frame.number);
+    out << buff << " " << frame.floor.x << " " << frame.floor.y << " " << frame.floor.z << " " << frame.floor.w << "\n";
+
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        const skeleton_body& body = frame.bodies[b];
+        if (!body.tracked) continue;
+
+        out << "B " << b << " " << body.id;
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+            snprintf(buff, sizeof(buff), " %.4f %.4f %.4f %d", body.joints[j].x, body.joints[j].y, body.joints[j].z, (int)body.state[j]);
+            out << buff;
+        }
+        out << "\n";
+    }
+}
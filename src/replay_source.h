@@ -0,0 +1,81 @@
+#pragma once
+
+#include "cinder/Timer.h"
+#include <fstream>
+#include <ostream>
+#include <string>
+
+#include "skeleton_archive.h"
+#include "skeleton_recording.h"
+#include "skeleton_source.h"
+
+using namespace ci;
+using namespace std;
+
+//Skeleton frames played back from a binary recording (.kxr, see recording_writer), an archive (.kxa, see archive_writer)
+//or a text recording (see write_skeleton_text)
+//Binary recordings are memory mapped and can be seeked , archives are decoded and text recordings parsed as they play
+//In realtime mode frames are released at their recorded spacing, otherwise as fast as they are popped
+//frame.time is rebased so the first frame of the file is at 0
+class replay_source : public skeleton_source
+{
+	public:
+
+		replay_source(const string& path);
+
+		void set_realtime(bool realtime);	//call before start
+		void set_loop(bool loop);			//start over at the end of the file instead of finishing
+
+		bool start() override;
+		void stop() override;
+		bool pop(skeleton_frame& frame) override;
+		bool finished() const override;
+
+		const char* get_name() const override;
+		uint32_t get_delivered() const override;
+		string get_error() const override;
+
+		//jump to t seconds from the start of the recording, binary recordings only
+		bool seek(double t);
+		double get_duration() const;	//binary recordings only, 0 for text
+		double get_position() const;	//time of the next frame from the start of the recording
+
+	private:
+
+		string path;
+		bool realtime;
+		bool loop;
+
+		//binary recording
+		bool binary;
+		recording_reader reader;
+		size_t cursor;			//next record
+
+		//archive
+		bool archive;
+		archive_reader archive_in;
+
+		ifstream file;
+		bool has_next;			//next holds a frame read ahead of time
+		skeleton_frame next;
+		double first_time;		//recorded time of the first frame
+		double loop_offset;		//added to frame times after every wrap around
+
+		Timer clock;
+		double clock_offset;	//playback position minus clock , changed by seek
+		uint32_t delivered;
+		string error;
+
+		bool rewind();
+		bool read_next();
+		double next_time() const;		//rebased time of the next frame
+		double get_clock() const;		//playback position in realtime mode
+};
+
+//text recording format, one frame per block:
+//  KXRSKEL 1                                  (once, first line)
+//  F <time> <timestamp> <number> <floor a b c d>
+//  B <body index> <id> then x y z state for each of the SKEL_JOINT_COUNT joints   (one line per tracked body)
+//lines starting with # are ignored
+void write_skeleton_text_header(ostream& out);
+void write_skeleton_text(ostream& out, const skeleton_frame& frame);
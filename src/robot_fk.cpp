@@ -0,0 +1,98 @@
+#include "robot_fk.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+
+fk_chain::fk_chain() {
+    base_pos = vec3(0);
+    base_sz = 0;
+    limb_lens = vec3(0);
+    angles = vec4(0);
+    valid = false;
+
+    for (int i = 0; i < FK_FRAME_COUNT; i++) frames[i] = mat4(1.0f);
+}
+
+bool fk_chain::update(vec3 base_pos, float base_sz, vec3 limb_lens, vec4 angles)
+{
+    //nothing changed since last rebuild
+    if (valid && this->base_pos == base_pos && this->base_sz == base_sz && this->limb_lens == limb_lens && this->angles == angles)
+        return false;
+
+    this->base_pos = base_pos;
+    this->base_sz = base_sz;
+    this->limb_lens = limb_lens;
+    this->angles = angles;
+    valid = true;
+
+    const vec3 y_axis = vec3(0, 1, 0);
+    const vec3 z_axis = vec3(0, 0, 1);
+
+    //base cube is drawn from its center so move up half the base length
+    frames[FK_BASE] = glm::translate(mat4(1.0f), base_pos + vec3(0, base_sz / 2, 0));
+
+    //top of the base, rotate by theta_0 then alpha (abt the z axis)
+    mat4 m = glm::translate(frames[FK_BASE], vec3(0, base_sz / 2, 0));
+    m = glm::rotate(m, toRadians(angles.w - 90.0f), y_axis);
+    frames[FK_SHOULDER] = glm::rotate(m, toRadians(angles.x - 90.0f), z_axis);
+
+    //end of first link, rotate by beta
+    m = glm::translate(frames[FK_SHOULDER], vec3(0, limb_lens.x, 0));
+    frames[FK_ELBOW] = glm::rotate(m, toRadians(angles.y), z_axis);
+
+    //end of second link, rotate by theta
+    m = glm::translate(frames[FK_ELBOW], vec3(0, limb_lens.y, 0));
+    frames[FK_WRIST] = glm::rotate(m, toRadians(angles.z), z_axis);
+
+    //tip of the third link
+    frames[FK_END] = glm::translate(frames[FK_WRIST], vec3(0, limb_lens.z, 0));
+
+    return true;
+}
+
+const mat4& fk_chain::get_frame(int idx) const
+{
+    return frames[idx];
+}
+
+vec3 fk_chain::get_joint_pos(int idx) const
+{
+    return vec3(frames[idx][3]);
+}
+
+const mat4& fk_chain::get_end_pose() const
+{
+    return frames[FK_END];
+}
+
+vec3 fk_chain::get_end_planar() const
+{
+    //direction of the arm plane in world coordinates (local +x after the base rotation)
+    float psi = toRadians(angles.w - 90.0f);
+    vec3 plane_dir = vec3(cos(psi), 0, -sin(psi));
+
+    vec3 d = get_joint_pos(FK_END) - get_joint_pos(FK_SHOULDER);
+    vec3 tool_dir = vec3(frames[FK_WRIST][1]);      //third link runs along local +y of the wrist frame
+
+    float reach = dot(d, plane_dir);
+    float height = d.y;
+    float tool_angle = toDegrees(atan2(tool_dir.y, dot(tool_dir, plane_dir)));
+    return vec3(reach, height, tool_angle);
+}
+
+void fk_chain::get_link_segment(int link, vec3& from, vec3& to) const
+{
+    from = get_joint_pos(FK_SHOULDER + link);
+    to = get_joint_pos(FK_SHOULDER + link + 1);
+}
+
+float fk_chain::min_height(const float link_rads[3]) const
+{
+    float h = get_joint_pos(FK_SHOULDER).y;
+    for (int i = 0; i < 3; i++) {
+        vec3 from, to;
+        get_link_segment(i, from, to);
+        h = std::min(h, std::min(from.y, to.y) - link_rads[i]);
+    }
+    return h;
+}
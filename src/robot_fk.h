@@ -0,0 +1,51 @@
+#pragma once
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+
+using namespace ci;
+
+//indices of the cached link frames
+enum fk_frame_index {
+	FK_BASE = 0,		//center of the base cube
+	FK_SHOULDER,		//first joint after base rotation and alpha
+	FK_ELBOW,			//second joint after beta
+	FK_WRIST,			//third joint after theta
+	FK_END,				//tip of the third link
+	FK_FRAME_COUNT
+};
+
+//Forward kinematics of the 4DOF arm as a chain of cached world frames
+//Frames are only recomputed when the geometry or the joint angles change
+//Convention matches robot_manipulator::draw (Y up, links extend along local +Y, angles in degrees)
+class fk_chain
+{
+	public:
+
+		fk_chain();
+
+		//recompute frames if any input changed, returns true if frames were rebuilt
+		//limb_lens is (l1 , l2 , l3) and angles is (alpha , beta , theta , theta_0)
+		bool update(vec3 base_pos, float base_sz, vec3 limb_lens, vec4 angles);
+
+		const mat4& get_frame(int idx) const;		//world transform of frame idx
+		vec3 get_joint_pos(int idx) const;			//world origin of frame idx
+		const mat4& get_end_pose() const;			//world transform of the end effector
+		vec3 get_end_planar() const;				//(reach , height , tool angle) of the end effector in the arm plane relative to the shoulder
+
+		//link 0..2 runs from joint FK_SHOULDER + link to the next frame
+		void get_link_segment(int link, vec3& from, vec3& to) const;
+
+		float min_height(const float link_rads[3]) const;	//lowest point of the three links (world y)
+
+	private:
+
+		//inputs of the last rebuild
+		vec3 base_pos;
+		float base_sz;
+		vec3 limb_lens;
+		vec4 angles;
+		bool valid;
+
+		mat4 frames[FK_FRAME_COUNT];
+};
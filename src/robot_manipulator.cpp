@@ -1,15 +1,79 @@
 #include "robot_manipulator.h"
-#define deg_to_rad(deg) (((deg) * M_PI)/ 180.0f)
-#define rad_to_deg(rad) (((rad) * 180.0f) / M_PI)
+#include "cinder/Rand.h"
+#include "cinder/Timer.h"
+#include "rr_teleop.h"
+
+//directory for cached lookup tables relative to the working directory
+#define IK_CACHE_DIR "cache"
+
+//tool offset and lowest G1 z the firmware was built with , the same constants config.h uses
+#define FIRMWARE_EE_OFFSET kxr::KC_END_EFFECTOR_OFFSET
+#define FIRMWARE_Z_MIN kxr::KC_Z_MIN
+
+//joint limits (alpha , beta , theta , theta_0) in degrees , shared by the numerical chain and the gamma candidates
+static const vec4 JOINT_MIN_ANGLE = vec4(-10.0f, -175.0f, -180.0f, 0.0f);
+static const vec4 JOINT_MAX_ANGLE = vec4(190.0f, 0.0f, 180.0f, 180.0f);
+
+//keep conversions in single precision
+#define deg_to_rad(deg) ((deg) * (float)(M_PI / 180.0))
+#define rad_to_deg(rad) ((rad) * (float)(180.0 / M_PI))
 
 robot_manipulator::robot_manipulator() {
     //initialize model parameters
     base_pos = vec3(0, 0, 0);
+    dest_pos = vec4(0, 0, 0, 0);
 
     //forward kinematics testing stuff
     forward = vec4(70, -102, 34, 90);
     test_forward = false;
 
+    //batched IK benchmark
+    bench_points = 4096;
+    bench_scalar_ms = 0;
+    bench_batch_ms = 0;
+    bench_runtime_ms = 0;
+    bench_fixed_ms = 0;
+    bench_max_err = 0;
+    bench_mismatch = 0;
+
+    //lookup table is opt in
+    use_ik_table = false;
+    table_from_disk = false;
+    table_hits = 0;
+    table_misses = 0;
+
+    //tool angle is taken as requested unless automatic selection is turned on
+    gamma_mode = GAMMA_MANUAL;
+    gamma_sweep = 90.0f;
+    gamma_step = 5.0f;
+    gamma_chosen = 0;
+    gamma_rescued = 0;
+
+    //workspace map is built (or loaded) with the chains, safe box computed on demand
+    ws_from_disk = false;
+    show_workspace = false;
+    ws_margin = 20.0f;
+    ws_min_manip = 0.1f;
+    ws_cloud_version = -1;
+    ws_box_ok = false;
+    ws_box_version = -1;
+    ws_box_margin = 0;
+    ws_box_manip = 0;
+
+    //firmware check over the streaming box
+    fw_check_points = 0;
+    fw_check_reachable = 0;
+    fw_check_max_err = 0;
+    fw_check_ms = 0;
+
+    //numerical IK is opt in, allow enough iterations to converge from the home pose in one frame
+    use_dls = false;
+    dls_converged = false;
+    dls_params params;
+    params.max_iterations = 16;
+    params.tool_weight = 100.0f;
+    dls.set_params(params);
+
     //note all measurements are in milimeters
     float def_jsz = 50.0f;
     float def_base_sz = 150.0f;
@@ -33,35 +97,13 @@ robot_manipulator::robot_manipulator() {
     this->gamma = this->alpha + this->beta + this->theta;
 
 
-    //initialize shader
-    auto lambert = gl::ShaderDef().lambert().color();
-    shader = gl::getStockShader(lambert);
-
-    //initialize geometry for links joints and the base
-    auto link1 = geom::Cylinder();
-    link1.height(this->l1_len);
-    link1.radius(this->l1_rad);
-
-    auto link2 = geom::Cylinder();
-    link2.height(this->l2_len);
-    link2.radius(this->l2_rad);
-
-    auto link3 = geom::Cylinder();
-    link3.height(this->l3_len);
-    link3.radius(this->l3_rad);
-
-    auto joint_sphere = geom::Sphere();
-    joint_sphere.radius(joint_sz);
-
-    auto base_cube = geom::Cube();
-    base_cube.size(vec3(base_sz));
+    //model geometry is unit sized and shared, only the instance scales depend on the dimensions
+    update_mesh_dims();
 
-    //push geometry into batch container
-    model[0] = gl::Batch::create(base_cube, shader);
-    model[1] = gl::Batch::create(joint_sphere, shader);
-    model[2] = gl::Batch::create(link1, shader);
-    model[3] = gl::Batch::create(link2, shader);
-    model[4] = gl::Batch::create(link3, shader);
+    //numerical solver starts from the straight up pose
+    update_chains();
+    float seed[4] = { 90.0f, 90.0f, 0.0f, 0.0f };
+    dls.seed(seed);
 }
 
 void robot_manipulator::init(vec3 base_pos, float limb_lens[3] , float limb_rads[3], float joint_sz)
@@ -88,6 +130,9 @@ void robot_manipulator::init(vec3 base_pos, float limb_lens[3] , float limb_rads
 
     this->end_pos = vec3(0, 0, 0);
 
+    update_mesh_dims();
+    update_chains();
+    update_fk();
 }
 
 
@@ -118,6 +163,30 @@ vec4 robot_manipulator::get_angles()
     return vec4(alpha , beta , theta, theta_0);
 }
 
+const fk_chain& robot_manipulator::get_fk()
+{
+    update_fk();
+    return fk;
+}
+
+vec3 robot_manipulator::get_joint_pos(int idx)
+{
+    update_fk();
+    return fk.get_joint_pos(idx);
+}
+
+bool robot_manipulator::in_collision()
+{
+    update_fk();
+    float link_rads[3] = { l1_rad, l2_rad, l3_rad };
+    return fk.min_height(link_rads) < base_pos.y;
+}
+
+void robot_manipulator::update_fk()
+{
+    fk.update(base_pos, base_sz, vec3(l1_len, l2_len, l3_len), vec4(alpha, beta, theta, theta_0));
+}
+
 void robot_manipulator::display_info()
 {
     //use only for debugging otherwise use external functions to extract information
@@ -136,11 +205,126 @@ void robot_manipulator::display_info()
     ImGui::Text(theta_str.c_str());
     ImGui::Text(theta_0_str.c_str());
     ImGui::Text(end_pos_str.c_str());
+
+    //IK round trip through the cached frames: (reach , height , tool angle) should match the destination
+    vec3 planar = get_fk().get_end_planar();
+    vec3 round_trip = planar - vec3(dest_pos.x, dest_pos.y, dest_pos.w);
+    string round_trip_str = "IK round trip err: (" + std::to_string(round_trip.x) + " , " + std::to_string(round_trip.y) + " , "
+        + std::to_string(round_trip.z) + " )";
+    ImGui::Text(round_trip_str.c_str());
+    if (in_collision()) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "Link below base plane!");
+
+    //joint telemetry from the same cache
+    if (ImGui::TreeNode("Joint positions")) {
+        const char* names[FK_FRAME_COUNT] = { "Base", "Shoulder", "Elbow", "Wrist", "End" };
+        for (int i = 0; i < FK_FRAME_COUNT; i++) {
+            vec3 p = fk.get_joint_pos(i);
+            string joint_str = string(names[i]) + ": (" + std::to_string(p.x) + " , " + std::to_string(p.y) + " , " + std::to_string(p.z) + " )";
+            ImGui::Text(joint_str.c_str());
+        }
+        ImGui::TreePop();
+    }
+
+    //instance buffers should only be re-uploaded while the arm moves or dimensions change
+    string uploads_str = "Mesh instance uploads: " + std::to_string(mesh.get_upload_count());
+    ImGui::Text(uploads_str.c_str());
     
     ImGui::Checkbox("Test forward kinematics", &test_forward);
 
     if(test_forward) ImGui::DragFloat4("Input angles: ", &forward, 1.0f);
     if(ImGui::Button("Reset angle vector")) forward = vec4(70, -102, 34, 90);
+
+    //automatic tool angle
+    const char* gamma_modes[] = { "Manual", "Max manipulability", "Min joint motion" };
+    if (ImGui::Combo("Tool angle", &gamma_mode, gamma_modes, 3)) set_gamma_mode(gamma_mode);
+    if (gamma_mode != GAMMA_MANUAL) {
+        ImGui::DragFloat("sweep (deg)", &gamma_sweep, 1.0f, 0.0f, 180.0f);
+        ImGui::DragFloat("step (deg)", &gamma_step, 0.1f, 0.5f, 45.0f);
+        if (gamma_step < 0.5f) gamma_step = 0.5f;
+
+        string chosen_str = "Chosen gamma: " + std::to_string(gamma_chosen) + " , rescued targets: " + std::to_string(gamma_rescued);
+        ImGui::Text(chosen_str.c_str());
+    }
+
+    //numerical IK
+    if (ImGui::Checkbox("Numerical IK (DLS)", &use_dls)) set_use_dls(use_dls);
+    if (use_dls) {
+        dls_params params = dls.get_params();
+        bool changed = ImGui::InputInt("iteration budget", &params.max_iterations);
+        changed |= ImGui::DragFloat("damping", &params.damping, 0.05f, 0.0f, 50.0f);
+        if (changed) dls.set_params(params);
+
+        string dls_str = "Iterations: " + std::to_string(dls.get_iterations()) + "  error: " + std::to_string(dls.get_error()) + " mm"
+            + (dls_converged ? "" : " (not converged)");
+        ImGui::Text(dls_str.c_str());
+    }
+
+    //voxelized IK lookup table
+    if (ImGui::Checkbox("Use IK lookup table", &use_ik_table)) set_use_ik_table(use_ik_table);
+    if (use_ik_table && table.is_valid()) {
+        string cells_str = "Cells: " + std::to_string(table.get_reachable_count()) + " / " + std::to_string(table.get_cell_count()) + " reachable";
+        string source_str = table_from_disk ? string("Loaded from cache") : "Built in " + std::to_string(table.get_build_ms()) + " ms";
+        string hits_str = "Hits: " + std::to_string(table_hits) + "  Misses: " + std::to_string(table_misses);
+        ImGui::Text(cells_str.c_str());
+        ImGui::Text(source_str.c_str());
+        ImGui::Text(hits_str.c_str());
+    }
+
+    //compare batched IK against the scalar path
+    if (ImGui::TreeNode("IK batch benchmark")) {
+        ImGui::InputInt("points", &bench_points, 1024);
+        if (bench_points < 1) bench_points = 1;
+        if (ImGui::Button("Run benchmark")) run_ik_benchmark();
+
+        string kernel_str = "Kernel: " + string(ik_batch_kernel_name());
+        string scalar_str = "calcIK:  " + std::to_string(bench_scalar_ms) + " ms";
+        string batch_str = "batched: " + std::to_string(bench_batch_ms) + " ms";
+        string speedup_str = "speedup: " + std::to_string(bench_batch_ms > 0 ? bench_scalar_ms / bench_batch_ms : 0.0) + "x";
+        string runtime_str = "runtime chain:   " + std::to_string(bench_runtime_ms) + " ms";
+        string fixed_str = "constexpr chain: " + std::to_string(bench_fixed_ms) + " ms ("
+            + std::to_string(bench_fixed_ms > 0 ? bench_runtime_ms / bench_fixed_ms : 0.0) + "x)";
+        string err_str = "max err: " + std::to_string(bench_max_err) + " deg , reach mismatch: " + std::to_string(bench_mismatch);
+
+        ImGui::Text(kernel_str.c_str());
+        ImGui::Text(scalar_str.c_str());
+        ImGui::Text(batch_str.c_str());
+        ImGui::Text(speedup_str.c_str());
+        ImGui::Text(runtime_str.c_str());
+        ImGui::Text(fixed_str.c_str());
+        ImGui::Text(err_str.c_str());
+        ImGui::TreePop();
+    }
+
+    //workspace map and the safe G1 box derived from it
+    if (ImGui::TreeNode("Workspace map")) {
+        ImGui::Checkbox("Show point cloud", &show_workspace);
+        ImGui::DragFloat("margin (mm)", &ws_margin, 1.0f, 0.0f, 100.0f);
+        ImGui::DragFloat("min manipulability", &ws_min_manip, 0.01f, 0.0f, 1.0f);
+
+        string ws_cells_str = "Cells: " + std::to_string(ws_map.get_reachable_count()) + " / " + std::to_string(ws_map.get_cell_count()) + " reachable";
+        string ws_source_str = ws_from_disk ? string("Loaded from cache")
+            : "Built in " + std::to_string(ws_map.get_build_ms()) + " ms on " + std::to_string(ws_map.get_threads()) + " threads";
+        string ws_box_str = ws_box_ok ? "Safe box: (" + std::to_string((int)ws_box_min.x) + " , " + std::to_string((int)ws_box_min.y) + " , "
+            + std::to_string((int)ws_box_min.z) + ") - (" + std::to_string((int)ws_box_max.x) + " , " + std::to_string((int)ws_box_max.y) + " , "
+            + std::to_string((int)ws_box_max.z) + ")" : string("Safe box: none");
+        ImGui::Text(ws_cells_str.c_str());
+        ImGui::Text(ws_source_str.c_str());
+        ImGui::Text(ws_box_str.c_str());
+        ImGui::TreePop();
+    }
+
+    //run the firmware solver over the G1 streaming box and map the result back through the host FK
+    if (ImGui::TreeNode("Firmware kinematics")) {
+        if (ImGui::Button("Check streaming box")) run_firmware_check();
+
+        string fw_points_str = "Reachable: " + std::to_string(fw_check_reachable) + " / " + std::to_string(fw_check_points)
+            + " (" + std::to_string(fw_check_ms) + " ms)";
+        string fw_err_str = "Round trip err: " + std::to_string(fw_check_max_err) + " mm";
+
+        ImGui::Text(fw_points_str.c_str());
+        ImGui::Text(fw_err_str.c_str());
+        ImGui::TreePop();
+    }
     ImGui::End();
 
     
@@ -155,48 +339,412 @@ void robot_manipulator::set_limb_lens(vec4 lens) {
     this->l3_len = lens.z;
     this->base_sz = lens.w;
 
-    //update model geometry
-    auto link1 = geom::Cylinder();
-    link1.height(this->l1_len);
-    link1.radius(this->l1_rad);
+    //lookup table is keyed by limb lengths and the tool angle at this moment, rebuilds only if they actually changed
+    if (use_ik_table) prepare_table(dest_pos.w);
+
+    //no geometry rebuild, only the instance scales change
+    update_mesh_dims();
+
+    //keep solvers and cached frames in sync with the new lengths
+    update_chains();
+    update_fk();
+}
+
+void robot_manipulator::update_chains()
+{
+    rt_chain.dims.set(l1_len, l2_len, l3_len);
+    fw_chain.dims.set(l1_len, l2_len, FIRMWARE_EE_OFFSET);
+    dls.set_chain(make_dls_chain(0));
+
+    //rebuilds only if the shank lengths actually changed
+    if (!ws_map.matches(l1_len, l2_len, FIRMWARE_EE_OFFSET, FIRMWARE_Z_MIN))
+        ws_from_disk = ws_map.prepare(l1_len, l2_len, FIRMWARE_EE_OFFSET, FIRMWARE_Z_MIN, IK_CACHE_DIR);
+}
+
+bool robot_manipulator::get_safe_box(vec3 seed, vec3& box_min, vec3& box_max)
+{
+    //the search erodes the whole map, only redo it when something it depends on changed
+    if (ws_box_version != ws_map.get_version() || ws_box_seed != seed || ws_box_margin != ws_margin || ws_box_manip != ws_min_manip) {
+        ws_box_ok = ws_map.safe_box(seed, ws_margin, ws_min_manip, ws_box_min, ws_box_max);
+        ws_box_version = ws_map.get_version();
+        ws_box_seed = seed;
+        ws_box_margin = ws_margin;
+        ws_box_manip = ws_min_manip;
+    }
+    if (!ws_box_ok) return false;
+
+    box_min = ws_box_min;
+    box_max = ws_box_max;
+    return true;
+}
+
+void robot_manipulator::draw_workspace()
+{
+    if (!ws_map.is_valid()) return;
+
+    //point cloud (every other cell per axis) colored red -> green by manipulability, rebuilt only with the map
+    if (ws_cloud_version != ws_map.get_version()) {
+        gl::VertBatch cloud(GL_POINTS);
+        for (int k = 0; k < ws_map.get_dim(2); k += 2)
+            for (int j = 0; j < ws_map.get_dim(1); j += 2)
+                for (int i = 0; i < ws_map.get_dim(0); i += 2) {
+                    if (!ws_map.is_reachable(i, j, k)) continue;
+                    float m = std::min(ws_map.get_manip(i, j, k) * 2.0f, 1.0f);
+                    vec3 p = ws_map.get_pos(i, j, k);
+                    cloud.color(Color(1.0f - m, m, 0.2f));
+                    cloud.vertex(vec3(p.x, p.z, p.y));      //firmware (x , y , z up) -> host (x , y up , z)
+                }
+        ws_cloud = gl::Batch::create(cloud, gl::getStockShader(gl::ShaderDef().color()));
+        ws_cloud_version = ws_map.get_version();
+    }
+
+    //map is relative to the shoulder
+    gl::ScopedModelMatrix scp_model;
+    gl::translate(fk.get_joint_pos(FK_SHOULDER));
+    ws_cloud->draw();
+
+    if (ws_box_ok) {
+        vec3 b_min = vec3(ws_box_min.x, ws_box_min.z, ws_box_min.y);
+        vec3 b_max = vec3(ws_box_max.x, ws_box_max.z, ws_box_max.y);
+        gl::color(Color(0.3f, 0.6f, 1.0f));
+        gl::drawStrokedCube((b_min + b_max) * 0.5f, b_max - b_min);
+    }
+}
+
+bool robot_manipulator::predict_firmware(vec3 g1_pos, kxr::FirmwareJoints& joints)
+{
+    return fw_chain.inverse(g1_pos.x, g1_pos.y, g1_pos.z, joints);
+}
+
+size_t robot_manipulator::predict_firmware_batch(const float* x, const float* y, const float* z, size_t count, kxr::FirmwareJoints* joints, uint8_t* reachable)
+{
+    size_t reachable_cnt = 0;
+    for (size_t i = 0; i < count; i++) {
+        reachable[i] = fw_chain.inverse(x[i], y[i], z[i], joints[i]) ? 1 : 0;
+        reachable_cnt += reachable[i];
+    }
+    return reachable_cnt;
+}
+
+void robot_manipulator::run_firmware_check()
+{
+    //same box the G1 stream is clamped to (firmware frame)
+    const float step = 10.0f;
+    vec3 box_min = vec3(-300, 250, 100);
+    vec3 box_max = vec3(300, 500, 320);
+
+    vector<float> x, y, z;
+    for (float k = box_min.z; k <= box_max.z; k += step)
+        for (float j = box_min.y; j <= box_max.y; j += step)
+            for (float i = box_min.x; i <= box_max.x; i += step) {
+                x.push_back(i);
+                y.push_back(j);
+                z.push_back(k);
+            }
+
+    size_t n = x.size();
+    vector<kxr::FirmwareJoints> joints(n);
+    vector<uint8_t> ok(n);
+
+    Timer timer(true);
+    fw_check_reachable = (int)predict_firmware_batch(x.data(), y.data(), z.data(), n, joints.data(), ok.data());
+    timer.stop();
+    fw_check_ms = timer.getSeconds() * 1000.0;
+    fw_check_points = (int)n;
+
+    //firmware angles -> host angles -> host FK (tool offset as the level third link) -> firmware frame
+    runtime_chain host_chain(kxr::RuntimeArmDims(l1_len, l2_len, FIRMWARE_EE_OFFSET));
+    fw_check_max_err = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!ok[i]) continue;
+
+        float angles[4], host_pos[3], fw_pos[3];
+        kxr::firmwareToHostAngles(joints[i], angles);
+        host_chain.forward(angles, host_pos);
+        kxr::hostToFirmware(host_pos, fw_pos);
+
+        vec3 diff = abs(vec3(fw_pos[0], fw_pos[1], fw_pos[2]) - vec3(x[i], y[i], z[i]));
+        fw_check_max_err = std::max(fw_check_max_err, std::max(diff.x, std::max(diff.y, diff.z)));
+    }
+}
+
+void robot_manipulator::update_mesh_dims()
+{
+    float lens[3] = { l1_len, l2_len, l3_len };
+    float rads[3] = { l1_rad, l2_rad, l3_rad };
+    mesh.set_dims(base_sz, joint_sz, lens, rads);
+}
+
+size_t robot_manipulator::calcIK_batch(const ik_batch_in& in, ik_batch_out& out)
+{
+    return ik_batch_solve(in, out, l1_len, l2_len, l3_len);
+}
+
+void robot_manipulator::run_ik_benchmark()
+{
+    //random targets covering the gcode streaming box plus some unreachable points around it
+    int n = bench_points;
+    vector<float> x(n), y(n), z(n), g(n);
+    vector<float> a(n), b(n), t(n), t0(n);
+    vector<uint8_t> ok(n);
+    vector<vec4> scalar_angles(n);
+
+    Rand rng(1234);
+    for (int i = 0; i < n; i++) {
+        x[i] = rng.nextFloat(-400.0f, 400.0f);
+        y[i] = rng.nextFloat(150.0f, 600.0f);
+        z[i] = rng.nextFloat(0.0f, 420.0f);
+        g[i] = rng.nextFloat(-90.0f, 90.0f);
+    }
+
+    Timer timer(true);
+    for (int i = 0; i < n; i++)
+        scalar_angles[i] = calcIK(vec4(x[i], y[i], z[i], g[i]));
+    timer.stop();
+    bench_scalar_ms = timer.getSeconds() * 1000.0;
+
+    ik_batch_in in = { x.data(), y.data(), z.data(), g.data(), (size_t)n };
+    ik_batch_out out = { a.data(), b.data(), t.data(), t0.data(), ok.data() };
+
+    timer.start();
+    calcIK_batch(in, out);
+    timer.stop();
+    bench_batch_ms = timer.getSeconds() * 1000.0;
+
+    //runtime parameterized chain vs compile time specialized chain (production lengths)
+    float q[4];
+    float sink = 0;
+    runtime_chain bench_rt(kxr::RuntimeArmDims(production_chain().dims.l1(), production_chain().dims.l2(), production_chain().dims.l3()));
+
+    timer.start();
+    for (int i = 0; i < n; i++) {
+        bench_rt.inverse(x[i], y[i], z[i], g[i], q);
+        sink += q[0];
+    }
+    timer.stop();
+    bench_runtime_ms = timer.getSeconds() * 1000.0;
+
+    timer.start();
+    for (int i = 0; i < n; i++) {
+        prod_chain.inverse(x[i], y[i], z[i], g[i], q);
+        sink += q[0];
+    }
+    timer.stop();
+    bench_fixed_ms = timer.getSeconds() * 1000.0;
+    if (sink == 12345.0f) bench_fixed_ms += 0;      //keep the loops from being optimized away
+
+    //compare results, scalar path signals unreachable lanes with NaN
+    bench_max_err = 0;
+    bench_mismatch = 0;
+    for (int i = 0; i < n; i++) {
+        vec4 s = scalar_angles[i];
+        bool scalar_ok = !(isnan(s.x) || isnan(s.y) || isnan(s.z) || isnan(s.w));
+
+        if (scalar_ok != (ok[i] != 0)) {
+            bench_mismatch++;
+            continue;
+        }
+        if (!scalar_ok) continue;
+
+        vec4 diff = abs(s - vec4(a[i], b[i], t[i], t0[i]));
+        bench_max_err = std::max(bench_max_err, std::max(std::max(diff.x, diff.y), std::max(diff.z, diff.w)));
+    }
+}
+
+void robot_manipulator::set_use_ik_table(bool use)
+{
+    use_ik_table = use;
+    table_hits = 0;
+    table_misses = 0;
+    if (use) prepare_table(dest_pos.w);
+}
+
+void robot_manipulator::set_use_dls(bool use)
+{
+    use_dls = use;
+
+    //warm start from wherever the arm currently is
+    float q[4] = { theta_0, alpha, beta, theta };
+    if (use) dls.seed(q);
+}
+
+dls_chain robot_manipulator::make_dls_chain(float rail_len)
+{
+    const vec3 y_axis = vec3(0, 1, 0);
+    const vec3 z_axis = vec3(0, 0, 1);
+
+    dls_chain chain;
+    chain.base = glm::translate(mat4(1.0f), base_pos + vec3(0, base_sz, 0));   //top of the base
 
-    auto link2 = geom::Cylinder();
-    link2.height(this->l2_len);
-    link2.radius(this->l2_rad);
+    if (rail_len > 0) chain.add_joint(DLS_PRISMATIC, mat4(1.0f), z_axis, 0.0f, rail_len);
 
-    auto link3 = geom::Cylinder();
-    link3.height(this->l3_len);
-    link3.radius(this->l3_rad);
+    //same frames as fk_chain: rotate (theta_0 - 90) abt y then (alpha - 90) abt z
+    mat4 shoulder_offset = glm::rotate(mat4(1.0f), toRadians(-90.0f), y_axis) * glm::rotate(mat4(1.0f), toRadians(-90.0f), z_axis);
 
-    auto joint_sphere = geom::Sphere();
-    joint_sphere.radius(joint_sz);
+    chain.add_joint(DLS_REVOLUTE, mat4(1.0f), y_axis, JOINT_MIN_ANGLE.w, JOINT_MAX_ANGLE.w);                                        //theta_0
+    chain.add_joint(DLS_REVOLUTE, shoulder_offset, z_axis, JOINT_MIN_ANGLE.x, JOINT_MAX_ANGLE.x);                                   //alpha
+    chain.add_joint(DLS_REVOLUTE, glm::translate(mat4(1.0f), vec3(0, l1_len, 0)), z_axis, JOINT_MIN_ANGLE.y, JOINT_MAX_ANGLE.y);    //beta
+    chain.add_joint(DLS_REVOLUTE, glm::translate(mat4(1.0f), vec3(0, l2_len, 0)), z_axis, JOINT_MIN_ANGLE.z, JOINT_MAX_ANGLE.z);    //theta
 
-    auto base_cube = geom::Cube();
-    base_cube.size(vec3(base_sz));
+    chain.tool = glm::translate(mat4(1.0f), vec3(0, l3_len, 0));
+    chain.tool_axis = y_axis;
+    return chain;
+}
+
+vec4 robot_manipulator::solve_dls(vec4 dest)
+{
+    //target relative to the shoulder, x/z horizontal and y up (matches calcIK when z = 0)
+    vec3 shoulder = base_pos + vec3(0, base_sz, 0);
+    vec3 target = shoulder + vec3(dest.x, dest.y, dest.z);
+
+    //tool angle is measured from the horizontal inside the vertical plane through the target
+    vec3 horizontal = vec3(dest.x, 0, dest.z);
+    horizontal = length(horizontal) > 0 ? normalize(horizontal) : vec3(1, 0, 0);
+    float g = deg_to_rad(dest.w);
+    vec3 tool_dir = horizontal * cos(g) + vec3(0, 1, 0) * sin(g);
+
+    dls_converged = dls.solve(target, tool_dir);
 
-    //push geometry into batch container
-    model[0] = gl::Batch::create(base_cube, shader);
-    model[1] = gl::Batch::create(joint_sphere, shader);
-    model[2] = gl::Batch::create(link1, shader);
-    model[3] = gl::Batch::create(link2, shader);
-    model[4] = gl::Batch::create(link3, shader);
+    const float* q = dls.get_solution();
+    return vec4(q[1], q[2], q[3], q[0]);
+}
+
+void robot_manipulator::prepare_table(float gamma)
+{
+    if (table.matches(l1_len, l2_len, l3_len, gamma)) return;
+    table_from_disk = table.prepare(l1_len, l2_len, l3_len, gamma, IK_CACHE_DIR);
 }
 
 void robot_manipulator::set_dest(vec4 dest)
 {
     //update end effector position to be destination set
     this->end_pos = vec3(dest.x, dest.y, dest.z);
+    this->dest_pos = dest;
     
-    //instantaneously set angle
-    vec4 angles = calcIK(dest);
+    //instantaneously set angle (best tool angle candidate, numerically, from the lookup table if enabled and inside its box or closed form)
+    vec4 angles;
+    if (gamma_mode != GAMMA_MANUAL && select_gamma(dest, angles)) this->dest_pos.w = gamma_chosen;
+    else if (use_dls) angles = solve_dls(dest);
+    else if (use_ik_table) {
+        //the table only answers for the tool angle it was built with , any other angle goes to the closed form
+        if (table.matches(l1_len, l2_len, l3_len, dest.w) && table.lookup(end_pos, angles)) table_hits++;
+        else {
+            angles = calcIK(dest);
+            table_misses++;
+        }
+    }
+    else angles = calcIK(dest);
+    alpha = angles.x;
+    beta = angles.y;
+    theta = angles.z;
+    theta_0 = angles.w;
+
+    update_fk();
+}
+
+void robot_manipulator::set_gamma_mode(int mode)
+{
+    gamma_mode = mode;
+    gamma_rescued = 0;
+}
+
+bool robot_manipulator::select_gamma(vec4 dest, vec4& angles)
+{
+    //requested gamma first, then alternating further away on both sides
+    int steps = std::max(0, (int)(gamma_sweep / gamma_step));
+    size_t n = 1 + 2 * (size_t)steps;
+    cand_x.assign(n, dest.x);
+    cand_y.assign(n, dest.y);
+    cand_z.assign(n, dest.z);
+    cand_g.resize(n);
+    cand_a.resize(n);
+    cand_b.resize(n);
+    cand_t.resize(n);
+    cand_t0.resize(n);
+    cand_ok.resize(n);
+
+    cand_g[0] = dest.w;
+    for (int i = 1; i <= steps; i++) {
+        cand_g[2 * i - 1] = dest.w + i * gamma_step;
+        cand_g[2 * i] = dest.w - i * gamma_step;
+    }
+
+    ik_batch_in in = { cand_x.data(), cand_y.data(), cand_z.data(), cand_g.data(), n };
+    ik_batch_out out = { cand_a.data(), cand_b.data(), cand_t.data(), cand_t0.data(), cand_ok.data() };
+    if (ik_batch_solve(in, out, l1_len, l2_len, l3_len) == 0) return false;
+
+    vec3 lens = vec3(l1_len, l2_len, l3_len);
+    vec4 current = vec4(alpha, beta, theta, theta_0);
+    int best = -1;
+    float best_score = 0;
+    bool requested_ok = false;
+    for (size_t i = 0; i < n; i++) {
+        if (!cand_ok[i]) continue;
+
+        //same joint limits as the numerical chain , all four joints
+        vec4 q = vec4(cand_a[i], cand_b[i], cand_t[i], cand_t0[i]);
+        if (any(lessThan(q, JOINT_MIN_ANGLE)) || any(greaterThan(q, JOINT_MAX_ANGLE))) continue;
+        if (i == 0) requested_ok = true;
+
+        //higher is better, a small pull toward the requested gamma breaks ties
+        float score;
+        if (gamma_mode == GAMMA_MANIPULABILITY) {
+            float j[RR_TASK_ROWS][4];
+            rr_teleop::jacobian(lens, q, j);
+            mat3 jjt;
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++)
+                    jjt[c][r] = j[r][0] * j[c][0] + j[r][1] * j[c][1] + j[r][2] * j[c][2] + j[r][3] * j[c][3];
+            score = sqrt(std::max(determinant(jjt), 0.0f));
+        }
+        else {
+            vec4 d = q - current;
+            score = -dot(d, d);
+        }
+        score -= 0.01f * abs(cand_g[i] - dest.w);
+
+        if (best < 0 || score > best_score) {
+            best = (int)i;
+            best_score = score;
+        }
+    }
+    if (best < 0) return false;
+
+    //rescued when the requested gamma had no solution or only one outside the limits
+    if (!requested_ok) gamma_rescued++;
+    gamma_chosen = cand_g[best];
+    angles = vec4(cand_a[best], cand_b[best], cand_t[best], cand_t0[best]);
+    return true;
+}
+
+void robot_manipulator::set_angles(vec4 angles)
+{
     alpha = angles.x;
     beta = angles.y;
     theta = angles.z;
     theta_0 = angles.w;
+    gamma = alpha + beta + theta;
 
+    //keep end effector and destination consistent with where the joints put the tool
+    update_fk();
+    vec3 end = fk.get_joint_pos(FK_END) - fk.get_joint_pos(FK_SHOULDER);
+    end_pos = end;
+    dest_pos = vec4(end, gamma);
 }
 
-void robot_manipulator::draw()
+vec3 robot_manipulator::get_firmware_target()
+{
+    //the firmware has no wrist: convert shoulder/elbow/base and run its own FK
+    float angles[4] = { alpha, beta, theta, theta_0 };
+    kxr::FirmwareJoints joints;
+    kxr::hostToFirmwareAngles(angles, joints);
+
+    float pos[3];
+    fw_chain.forward(joints, pos);
+    return vec3(pos[0], pos[1], pos[2]);
+}
+
+void robot_manipulator::draw(Color color)
 {
 
     //set destination point and draw sphere there
@@ -215,118 +763,31 @@ void robot_manipulator::draw()
         theta = forward.z;
         theta_0 = forward.w;
     }
-    
-    //Coordinate frame dimensions
-    float cf_len = 150.0f;
-    float cf_head_len = 10.0f;
-    float cf_head_rad = 5.0f;
-   
-    
-    //translate to base render position
-    gl::translate(base_pos);
-
-    //translate up 1/2 the base length since cubes are drawn from the center
-    gl::translate(vec3(0, base_sz / 2, 0));
-
-    gl::color(Color(1, 1, 1));
-
-    gl::drawCoordinateFrame(cf_len, cf_head_len, cf_head_rad);      //draw some unit vectors for referrence
-    
-    model[0]->draw();                             //base cube
-    gl::translate(vec3(0, base_sz/2, 0));
-    
-    //rotate base by theta_0 
-    gl::rotate(deg_to_rad(theta_0 - 90.0), vec3(0, 1, 0));
 
-    //draw first joint accounting for alpha (rotate abt the z axis)
-    gl::rotate( deg_to_rad(alpha - 90.0), vec3(0, 0, 1));
-    
-
-    model[1]->draw();
-    gl::drawCoordinateFrame(cf_len, cf_head_len, cf_head_rad);      //draw some unit vectors for referrence
-
-    //draw first link
-    model[2]->draw();
-
-    
-    //draw second joint accounting for beta (rotate abt the z axis)
-    gl::translate(vec3(0, l1_len, 0));
-    gl::rotate(deg_to_rad(beta), vec3(0, 0, 1));
-    model[1]->draw();
-    gl::drawCoordinateFrame(cf_len, cf_head_len, cf_head_rad);      //draw some unit vectors for referrence
+    //frames are only recomputed if the angles changed, instance buffers only re-uploaded if a frame or dimension changed
+    update_fk();
+    mesh.update(fk);
 
-    //draw second link
-    model[3]->draw();
+    mesh.draw(color);
 
-    //draw third joint accounting for beta (rotate abt the z axis)
-    gl::translate(vec3(0, l2_len, 0));
-    gl::rotate(deg_to_rad(theta), vec3(0, 0, 1));
-    model[1]->draw();
-    gl::drawCoordinateFrame(cf_len, cf_head_len, cf_head_rad);      //draw some unit vectors for referrence
+    if (show_workspace) draw_workspace();
 
-    //draw third link
-    model[4]->draw();
+}
 
-    
 
+bool robot_manipulator::is_production_geometry()
+{
+    return l1_len == prod_chain.dims.l1() && l2_len == prod_chain.dims.l2() && l3_len == prod_chain.dims.l3();
 }
 
-
 vec4 robot_manipulator::calcIK(vec4 dest)
 {
     //dest is (x,y,z,gamma)
-    //Note: needed to convert all parameters to radians
-
-    //getting needed parameters to calculate angles
-    float L1_sqrd = l1_len * l1_len;
-    float L2_sqrd = l2_len * l2_len;
-    float x0 = dest.x - ( l3_len * cos ( deg_to_rad(dest.w) ));
-    float y0 = dest.y - ( l3_len * sin ( deg_to_rad(dest.w) ) );
-    float r0_sqrd = (x0 * x0) + (y0 * y0);
-    float r0 = sqrt(r0_sqrd);
-    float rz = sqrt((dest.x * dest.x) + (dest.y * dest.y));
-
-
-    //calculating actual angles in degrees
-    float b = 180 - rad_to_deg(acos( (L1_sqrd + L2_sqrd - r0_sqrd)/(2 * l1_len * l2_len) ));
-    float a = rad_to_deg(atan(y0/x0)) + rad_to_deg(acos( (r0_sqrd + L1_sqrd - L2_sqrd) / (2 * r0 * l1_len)));
-    float t = dest.w - a + b;
-    float t0 = rad_to_deg(acos(dest.z / rz));
-    
-
-
-    //ImGui panel for debuging 
-    //Note: can only use this if function not called in draw loop
-    /*
-    string x0_str = "x0: " + std::to_string(x0);
-    string y0_str = "y0: " + std::to_string(y0);
-    string r0_str = "r0: " + std::to_string(r0) + " r0_sqrd: " + std::to_string(r0_sqrd);
-    string rz_str = "rz: " + std::to_string(rz);
-    string l1_str = "L1: " + std::to_string(l1_len) + " L1_sqrd: " + std::to_string(L1_sqrd);
-    string l2_str = "L2: " + std::to_string(l2_len) + " L2_sqrd: " + std::to_string(L2_sqrd);
-    string l3_str = "L3: " + std::to_string(l3_len);
-
-    string input_str = "Input: (" + std::to_string(dest.x) + " , " + std::to_string(dest.y) + " , "
-        + std::to_string(dest.z) + " ) "
-        + "gamma : " + std::to_string(dest.w);
-
-
-    ImGui::Begin("Inverse kinematics debug");
-    ImGui::Text(x0_str.c_str());
-    ImGui::Text(y0_str.c_str());
-    ImGui::Text(r0_str.c_str());
-    ImGui::Text(rz_str.c_str());
-    ImGui::Text(l1_str.c_str());
-    ImGui::Text(l2_str.c_str());
-    ImGui::Text(l3_str.c_str());
-    ImGui::Text(input_str.c_str());
-    
-    ImGui::End();
-    */
-
-    
-    
+    //Note: unreachable destinations come back as NaN angles
 
+    float angles[4];
+    if (is_production_geometry()) prod_chain.inverse(dest.x, dest.y, dest.z, dest.w, angles);
+    else rt_chain.inverse(dest.x, dest.y, dest.z, dest.w, angles);
 
-    return vec4(a,-b,t,t0);
+    return vec4(angles[0], angles[1], angles[2], angles[3]);
 }
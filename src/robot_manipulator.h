@@ -6,11 +6,34 @@
 #include <string.h>
 #include <math.h>
 
+#include "ik_batch.h"
+#include "ik_table.h"
+#include "robot_fk.h"
+#include "robot_mesh.h"
+#include "workspace_map.h"
+#include "dls_ik.h"
+
+//header only FK/IK shared with the firmware
+#include "../arduino/Community_robot_firmware/robotArm_v0.41/kinematicChain.h"
 
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
+//production arm geometry, FK/IK constants are folded at compile time
+typedef kxr::KinematicChain<kxr::FixedArmDims<320, 320, 100> > production_chain;
+//any geometry set from the limb length panel
+typedef kxr::KinematicChain<kxr::RuntimeArmDims> runtime_chain;
+//what RobotGeometry on the MCU computes for a G1 move (Z up, radians, no wrist)
+typedef kxr::FirmwareChain<kxr::RuntimeArmDims> firmware_chain;
+
+//how set_dest picks the tool angle
+enum gamma_select_mode {
+	GAMMA_MANUAL = 0,		//use the requested gamma as is
+	GAMMA_MANIPULABILITY,	//reachable candidate farthest from singularities
+	GAMMA_MIN_MOTION		//reachable candidate closest to the current joint angles
+};
+
 class robot_manipulator
 {
 	public:
@@ -23,12 +46,37 @@ class robot_manipulator
 		vec4 get_angles();				// returns (a , b , th ,th0)
 		vec4 get_limb_lens();			// returns (l1 , l2 , l3 , base_height)
 		float get_tot_len();			// returns tot_len
+		const fk_chain& get_fk();		// returns cached link frames for the current angles
+		vec3 get_joint_pos(int idx);	// returns world position of frame idx (see fk_frame_index)
+		bool in_collision();			// true if any link dips below the base plane
 
 		void display_info();			// display robot controls
 		void set_dest(vec4 dest);		// sets end effector coordinates accepts (x , y , z , gamma)
 		void set_limb_lens(vec4 lens);	// sets limb lengths accepts (l1, l2, l3 , base_height ) 
+		void set_angles(vec4 angles);	// drive joints directly accepts (a , b , th , th0), end effector follows from FK
+		vec3 get_firmware_target();		// G1 X Y Z that makes the firmware reproduce the current shoulder/elbow/base angles
+
+		size_t calcIK_batch(const ik_batch_in& in, ik_batch_out& out);	//batched inverse kinematics using current limb lengths returns reachable count
+		
+		void draw(Color color);
+		
+		void set_use_ik_table(bool use);	//answer set_dest from the voxelized IK table when possible
+		void set_use_dls(bool use);			//solve set_dest numerically (damped least squares) instead of calcIK
+		void set_gamma_mode(int mode);		//see gamma_select_mode, the requested gamma stays the preference
+
+		//stepper angles the firmware will compute for G1 X Y Z (firmware frame, see kxr::hostToFirmware)
+		//returns false if the MCU would get an unreachable target
+		bool predict_firmware(vec3 g1_pos, kxr::FirmwareJoints& joints);
+		size_t predict_firmware_batch(const float* x, const float* y, const float* z, size_t count, kxr::FirmwareJoints* joints, uint8_t* reachable);	//returns reachable count
+
+		//G1 box around seed (firmware frame) derived from the workspace map (reachable, margin and manipulability settings from the panel)
+		//returns false if the map has no safe cell near seed
+		bool get_safe_box(vec3 seed, vec3& box_min, vec3& box_max);
+
+		//chain description of this arm for the numerical solver, joint order is (theta_0 , alpha , beta , theta)
+		//rail_len > 0 prepends a prismatic rail joint along the world z axis (E0 rail on the firmware)
+		dls_chain make_dls_chain(float rail_len);
 		
-		void draw();
 	private:
 		
 		float l1_len;		//Link lengths
@@ -61,10 +109,79 @@ class robot_manipulator
 		bool test_forward;	//flag for testing forward kinematics
 		vec4 forward;		//forward kinematics testing vector  
 		
-		gl::BatchRef model[5];	//shaders and model container
-		gl::GlslProgRef shader;
+		fk_chain fk;			//cached forward kinematics frames shared by drawing and queries
+		void update_fk();		//rebuild frames if angles or lengths changed
+
+		robot_mesh mesh;		//instanced unit meshes, scaled by per instance matrices
+		void update_mesh_dims();	//push current lengths and radii into the mesh
 		
 
 		vec4 calcIK(vec4 dest);	//calculate Inverse kinematics returns (alpha,beta,theta,theta_0)
+
+		production_chain prod_chain;	//used whenever limb lengths match the production arm
+		runtime_chain rt_chain;			//used otherwise, updated with the limb lengths
+		bool is_production_geometry();
+
+		firmware_chain fw_chain;		//mirror of the firmware solver with the current shank lengths
+		void update_chains();			//push current lengths into rt_chain, fw_chain and the numerical solver
+
+		//reachability / manipulability of G1 targets for the current shank lengths (cached on disk per geometry)
+		workspace_map ws_map;
+		bool ws_from_disk;
+		bool show_workspace;
+		float ws_margin;			//milimeters kept between the safe box and unreachable cells
+		float ws_min_manip;			//normalized manipulability required inside the safe box
+		int ws_cloud_version;		//map version the point cloud was built from
+		gl::BatchRef ws_cloud;
+		vec3 ws_box_seed;			//safe box cache
+		vec3 ws_box_min;
+		vec3 ws_box_max;
+		bool ws_box_ok;
+		int ws_box_version;
+		float ws_box_margin;
+		float ws_box_manip;
+		void draw_workspace();
+
+		//bulk check of the firmware solver over the G1 streaming box
+		int fw_check_points;
+		int fw_check_reachable;
+		float fw_check_max_err;		//firmware IK -> host FK round trip (milimeters)
+		double fw_check_ms;
+		void run_firmware_check();
+
+		//precomputed IK lookup table (rebuilt or reloaded when limb lengths or tool angle change)
+		ik_table table;
+		bool use_ik_table;
+		bool table_from_disk;	//last prepare was a warm start from the cache file
+		int table_hits;
+		int table_misses;
+		void prepare_table(float gamma);
+
+		//warm started numerical IK (works for any chain and gives closest approach outside the reachable shell)
+		dls_ik dls;
+		bool use_dls;
+		bool dls_converged;
+		vec4 solve_dls(vec4 dest);	//returns (alpha , beta , theta , theta_0)
+
+		//automatic tool angle: candidates around the requested gamma solved in one batched pass
+		int gamma_mode;
+		float gamma_sweep;		//candidates cover requested gamma +- gamma_sweep (degrees)
+		float gamma_step;		//spacing of the candidates (degrees)
+		float gamma_chosen;		//gamma of the last selection
+		int gamma_rescued;		//targets that were unreachable (or out of the joint limits) at the requested gamma but solved with another
+		vector<float> cand_x, cand_y, cand_z, cand_g;		//candidate buffers (structure of arrays)
+		vector<float> cand_a, cand_b, cand_t, cand_t0;
+		vector<uint8_t> cand_ok;
+		bool select_gamma(vec4 dest, vec4& angles);	//false if no candidate is reachable
+
+		//batched IK benchmark results (scalar calcIK vs ik_batch_solve)
+		int bench_points;
+		double bench_scalar_ms;
+		double bench_batch_ms;
+		double bench_runtime_ms;	//runtime_chain and production_chain on the same points
+		double bench_fixed_ms;
+		float bench_max_err;	//max angle difference on lanes both paths solved (degrees)
+		int bench_mismatch;		//lanes where reachability differs
+		void run_ik_benchmark();
 };
 
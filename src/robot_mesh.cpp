@@ -0,0 +1,298 @@
+#include "robot_mesh.h"
+#include "cinder/TriMesh.h"
+
+#include <string.h>
+
+//coordinate frame arrow dimensions (milimeters), same as the old drawCoordinateFrame call
+static const float CF_LEN = 150.0f;
+static const float CF_HEAD_LEN = 10.0f;
+static const float CF_HEAD_RAD = 5.0f;
+static const float CF_SHAFT_RAD = 1.0f;
+
+//joints and links in one draw: every vertex carries a part id (0 = joint sphere, 1 = link cylinder)
+//and picks its model matrix from the instance attributes, lighting matches the stock lambert + color shader
+static const char* ARM_VERT =
+    "#version 150\n"
+    "uniform mat4 ciModelView;\n"
+    "uniform mat4 ciProjectionMatrix;\n"
+    "in vec4 ciPosition;\n"
+    "in vec3 ciNormal;\n"
+    "in float aPart;\n"
+    "in vec4 aJoint0;\n"
+    "in vec4 aJoint1;\n"
+    "in vec4 aJoint2;\n"
+    "in vec4 aJoint3;\n"
+    "in vec4 aLink0;\n"
+    "in vec4 aLink1;\n"
+    "in vec4 aLink2;\n"
+    "in vec4 aLink3;\n"
+    "out vec3 vNormal;\n"
+    "void main() {\n"
+    "    mat4 model = aPart < 0.5 ? mat4(aJoint0, aJoint1, aJoint2, aJoint3) : mat4(aLink0, aLink1, aLink2, aLink3);\n"
+    "    mat4 mv = ciModelView * model;\n"
+    "    vNormal = transpose(inverse(mat3(mv))) * ciNormal;\n"
+    "    gl_Position = ciProjectionMatrix * mv * ciPosition;\n"
+    "}\n";
+
+static const char* ARM_FRAG =
+    "#version 150\n"
+    "uniform vec4 uColor;\n"
+    "in vec3 vNormal;\n"
+    "out vec4 oColor;\n"
+    "void main() {\n"
+    "    float diffuse = max(dot(normalize(vNormal), vec3(0, 0, 1)), 0.0);\n"
+    "    oColor = vec4(vec3(diffuse), 1.0) * uColor;\n"
+    "}\n";
+
+//unlit per vertex color like gl::drawCoordinateFrame
+static const char* FRAME_VERT =
+    "#version 150\n"
+    "uniform mat4 ciModelViewProjection;\n"
+    "in vec4 ciPosition;\n"
+    "in vec4 ciColor;\n"
+    "in vec4 aFrame0;\n"
+    "in vec4 aFrame1;\n"
+    "in vec4 aFrame2;\n"
+    "in vec4 aFrame3;\n"
+    "out vec4 vColor;\n"
+    "void main() {\n"
+    "    vColor = ciColor;\n"
+    "    gl_Position = ciModelViewProjection * mat4(aFrame0, aFrame1, aFrame2, aFrame3) * ciPosition;\n"
+    "}\n";
+
+static const char* FRAME_FRAG =
+    "#version 150\n"
+    "in vec4 vColor;\n"
+    "out vec4 oColor;\n"
+    "void main() {\n"
+    "    oColor = vColor;\n"
+    "}\n";
+
+//geometry shared by every robot_mesh, uploaded once on the first draw
+struct robot_mesh_shared {
+    gl::VboRef arm_verts;       //(position , normal , part) interleaved
+    gl::VboRef arm_indices;
+    uint32_t arm_vert_cnt;
+    uint32_t arm_index_cnt;
+
+    gl::VboRef frame_verts;     //(position , color) interleaved
+    gl::VboRef frame_indices;
+    uint32_t frame_vert_cnt;
+    uint32_t frame_index_cnt;
+
+    gl::GlslProgRef arm_shader;
+    gl::GlslProgRef frame_shader;
+    gl::BatchRef base;          //unit cube with the stock lambert shader
+};
+
+static robot_mesh_shared* shared_mesh = NULL;
+
+//append a geom source to an interleaved vertex array of 7 floats per vertex
+//arm: position , normal , part (extra.x) / frames: position , color (extra)
+static void append_part(const geom::Source& src, const vec4& extra, bool normals, vector<float>& verts, vector<uint32_t>& indices)
+{
+    TriMesh mesh(src, TriMesh::Format().positions().normals());
+    const vec3* pos = mesh.getPositions<3>();
+    const vector<vec3>& nrm = mesh.getNormals();
+
+    uint32_t first = (uint32_t)(verts.size() / 7);
+    for (size_t i = 0; i < mesh.getNumVertices(); i++) {
+        verts.push_back(pos[i].x);
+        verts.push_back(pos[i].y);
+        verts.push_back(pos[i].z);
+        if (normals) {
+            verts.push_back(nrm[i].x);
+            verts.push_back(nrm[i].y);
+            verts.push_back(nrm[i].z);
+            verts.push_back(extra.x);
+        }
+        else {
+            verts.push_back(extra.r);
+            verts.push_back(extra.g);
+            verts.push_back(extra.b);
+            verts.push_back(extra.a);
+        }
+    }
+    for (uint32_t idx : mesh.getIndices()) indices.push_back(first + idx);
+}
+
+static robot_mesh_shared* get_shared_mesh()
+{
+    if (shared_mesh) return shared_mesh;
+    shared_mesh = new robot_mesh_shared();
+
+    //unit joint sphere + unit link cylinder (radius 1, height 1 along +y starting at the joint)
+    vector<float> verts;
+    vector<uint32_t> indices;
+    append_part(geom::Sphere().radius(1.0f).subdivisions(24), vec4(0), true, verts, indices);
+    append_part(geom::Cylinder().radius(1.0f).height(1.0f).subdivisionsAxis(24), vec4(1), true, verts, indices);
+
+    shared_mesh->arm_vert_cnt = (uint32_t)(verts.size() / 7);
+    shared_mesh->arm_index_cnt = (uint32_t)indices.size();
+    shared_mesh->arm_verts = gl::Vbo::create(GL_ARRAY_BUFFER, verts, GL_STATIC_DRAW);
+    shared_mesh->arm_indices = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, indices, GL_STATIC_DRAW);
+
+    //x , y , z arrows: thin shaft + cone head
+    verts.clear();
+    indices.clear();
+    vec3 axes[3] = { vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1) };
+    for (int i = 0; i < 3; i++) {
+        vec4 color = vec4(axes[i], 1.0f);
+        float shaft_len = CF_LEN - CF_HEAD_LEN;
+        append_part(geom::Cylinder().radius(CF_SHAFT_RAD).height(shaft_len).direction(axes[i]).subdivisionsAxis(6), color, false, verts, indices);
+        append_part(geom::Cone().base(CF_HEAD_RAD).apex(0).height(CF_HEAD_LEN).origin(axes[i] * shaft_len).direction(axes[i]).subdivisionsAxis(12), color, false, verts, indices);
+    }
+
+    shared_mesh->frame_vert_cnt = (uint32_t)(verts.size() / 7);
+    shared_mesh->frame_index_cnt = (uint32_t)indices.size();
+    shared_mesh->frame_verts = gl::Vbo::create(GL_ARRAY_BUFFER, verts, GL_STATIC_DRAW);
+    shared_mesh->frame_indices = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, indices, GL_STATIC_DRAW);
+
+    shared_mesh->arm_shader = gl::GlslProg::create(ARM_VERT, ARM_FRAG);
+    shared_mesh->frame_shader = gl::GlslProg::create(FRAME_VERT, FRAME_FRAG);
+    shared_mesh->base = gl::Batch::create(geom::Cube().size(vec3(1.0f)), gl::getStockShader(gl::ShaderDef().lambert().color()));
+
+    return shared_mesh;
+}
+
+robot_mesh::robot_mesh() {
+    base_sz = 0;
+    joint_sz = 0;
+    for (int i = 0; i < 3; i++) {
+        link_lens[i] = 0;
+        link_rads[i] = 0;
+    }
+    dirty = true;
+    upload_cnt = 0;
+
+    for (int i = 0; i < 3; i++) {
+        arm_inst[i].joint = mat4(0.0f);
+        arm_inst[i].link = mat4(0.0f);
+    }
+    for (int i = 0; i < 4; i++) frame_inst[i] = mat4(0.0f);
+    base_model = mat4(1.0f);
+}
+
+void robot_mesh::set_dims(float base_sz, float joint_sz, const float link_lens[3], const float link_rads[3])
+{
+    this->base_sz = base_sz;
+    this->joint_sz = joint_sz;
+    for (int i = 0; i < 3; i++) {
+        this->link_lens[i] = link_lens[i];
+        this->link_rads[i] = link_rads[i];
+    }
+}
+
+bool robot_mesh::update(const fk_chain& fk)
+{
+    arm_instance arm[3];
+    mat4 frames[4];
+
+    frames[0] = fk.get_frame(FK_BASE);
+    for (int i = 0; i < 3; i++) {
+        const mat4& frame = fk.get_frame(FK_SHOULDER + i);
+        frames[1 + i] = frame;
+        arm[i].joint = glm::scale(frame, vec3(joint_sz));
+        arm[i].link = glm::scale(frame, vec3(link_rads[i], link_lens[i], link_rads[i]));
+    }
+    base_model = glm::scale(frames[0], vec3(base_sz));
+
+    //nothing to upload while the arm and its dimensions stay put
+    if (memcmp(arm, arm_inst, sizeof(arm)) == 0 && memcmp(frames, frame_inst, sizeof(frames)) == 0) return false;
+
+    for (int i = 0; i < 3; i++) arm_inst[i] = arm[i];
+    for (int i = 0; i < 4; i++) frame_inst[i] = frames[i];
+    dirty = true;
+    return true;
+}
+
+int robot_mesh::get_upload_count() const
+{
+    return upload_cnt;
+}
+
+void robot_mesh::create_batches()
+{
+    robot_mesh_shared* sh = get_shared_mesh();
+
+    //joints + links: shared vertices, own instance buffer (two mat4 per instance as 8 vec4 attributes)
+    arm_inst_vbo = gl::Vbo::create(GL_ARRAY_BUFFER, sizeof(arm_inst), arm_inst, GL_DYNAMIC_DRAW);
+
+    geom::BufferLayout arm_layout;
+    arm_layout.append(geom::Attrib::POSITION, 3, 7 * sizeof(float), 0);
+    arm_layout.append(geom::Attrib::NORMAL, 3, 7 * sizeof(float), 3 * sizeof(float));
+    arm_layout.append(geom::Attrib::CUSTOM_0, 1, 7 * sizeof(float), 6 * sizeof(float));
+
+    geom::BufferLayout arm_inst_layout;
+    for (int i = 0; i < 8; i++)
+        arm_inst_layout.append((geom::Attrib)(geom::Attrib::CUSTOM_1 + i), 4, sizeof(arm_instance), i * sizeof(vec4), 1);
+
+    vector<pair<geom::BufferLayout, gl::VboRef> > arm_bufs;
+    arm_bufs.push_back(make_pair(arm_layout, sh->arm_verts));
+    arm_bufs.push_back(make_pair(arm_inst_layout, arm_inst_vbo));
+    gl::VboMeshRef arm_mesh = gl::VboMesh::create(sh->arm_vert_cnt, GL_TRIANGLES, arm_bufs, sh->arm_index_cnt, GL_UNSIGNED_INT, sh->arm_indices);
+
+    gl::Batch::AttributeMapping arm_map;
+    arm_map[geom::Attrib::CUSTOM_0] = "aPart";
+    arm_map[geom::Attrib::CUSTOM_1] = "aJoint0";
+    arm_map[geom::Attrib::CUSTOM_2] = "aJoint1";
+    arm_map[geom::Attrib::CUSTOM_3] = "aJoint2";
+    arm_map[geom::Attrib::CUSTOM_4] = "aJoint3";
+    arm_map[geom::Attrib::CUSTOM_5] = "aLink0";
+    arm_map[geom::Attrib::CUSTOM_6] = "aLink1";
+    arm_map[geom::Attrib::CUSTOM_7] = "aLink2";
+    arm_map[geom::Attrib::CUSTOM_8] = "aLink3";
+    arm_batch = gl::Batch::create(arm_mesh, sh->arm_shader, arm_map);
+
+    //coordinate frames: shared arrows, one mat4 per instance
+    frame_inst_vbo = gl::Vbo::create(GL_ARRAY_BUFFER, sizeof(frame_inst), frame_inst, GL_DYNAMIC_DRAW);
+
+    geom::BufferLayout frame_layout;
+    frame_layout.append(geom::Attrib::POSITION, 3, 7 * sizeof(float), 0);
+    frame_layout.append(geom::Attrib::COLOR, 4, 7 * sizeof(float), 3 * sizeof(float));
+
+    geom::BufferLayout frame_inst_layout;
+    for (int i = 0; i < 4; i++)
+        frame_inst_layout.append((geom::Attrib)(geom::Attrib::CUSTOM_1 + i), 4, sizeof(mat4), i * sizeof(vec4), 1);
+
+    vector<pair<geom::BufferLayout, gl::VboRef> > frame_bufs;
+    frame_bufs.push_back(make_pair(frame_layout, sh->frame_verts));
+    frame_bufs.push_back(make_pair(frame_inst_layout, frame_inst_vbo));
+    gl::VboMeshRef frame_mesh = gl::VboMesh::create(sh->frame_vert_cnt, GL_TRIANGLES, frame_bufs, sh->frame_index_cnt, GL_UNSIGNED_INT, sh->frame_indices);
+
+    gl::Batch::AttributeMapping frame_map;
+    frame_map[geom::Attrib::CUSTOM_1] = "aFrame0";
+    frame_map[geom::Attrib::CUSTOM_2] = "aFrame1";
+    frame_map[geom::Attrib::CUSTOM_3] = "aFrame2";
+    frame_map[geom::Attrib::CUSTOM_4] = "aFrame3";
+    frame_batch = gl::Batch::create(frame_mesh, sh->frame_shader, frame_map);
+
+    //buffers were just created from the current matrices
+    dirty = false;
+    upload_cnt++;
+}
+
+void robot_mesh::draw(Color color)
+{
+    if (!arm_batch) create_batches();
+
+    if (dirty) {
+        arm_inst_vbo->bufferSubData(0, sizeof(arm_inst), arm_inst);
+        frame_inst_vbo->bufferSubData(0, sizeof(frame_inst), frame_inst);
+        dirty = false;
+        upload_cnt++;
+    }
+
+    robot_mesh_shared* sh = get_shared_mesh();
+
+    gl::color(color);
+    {
+        gl::ScopedModelMatrix scp_model;
+        gl::multModelMatrix(base_model);
+        sh->base->draw();
+    }
+
+    sh->arm_shader->uniform("uColor", vec4(color.r, color.g, color.b, 1.0f));
+    arm_batch->drawInstanced(3);
+    frame_batch->drawInstanced(4);
+}
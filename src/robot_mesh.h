@@ -0,0 +1,55 @@
+#pragma once
+
+#include "cinder/gl/gl.h"
+#include "robot_fk.h"
+
+using namespace ci;
+using namespace std;
+
+//Instanced renderer for the arm
+//Unit sized meshes (cube , sphere , cylinder , axis arrows) are uploaded once and shared by every robot_mesh,
+//dimensions only enter through per instance model matrices so changing limb lengths never rebuilds geometry
+//Draw calls per arm: base cube , all joints + links (one instanced draw) , coordinate frames (one instanced draw)
+class robot_mesh
+{
+	public:
+
+		robot_mesh();
+
+		//set model dimensions (milimeters), takes effect on the next update
+		void set_dims(float base_sz, float joint_sz, const float link_lens[3], const float link_rads[3]);
+
+		//recompute instance matrices from the fk frames
+		//returns true if any matrix changed, the instance buffers are then uploaded by the next draw
+		bool update(const fk_chain& fk);
+
+		void draw(Color color);
+
+		int get_upload_count() const;	//number of instance buffer uploads since construction
+
+	private:
+
+		float base_sz;
+		float joint_sz;
+		float link_lens[3];
+		float link_rads[3];
+		bool dirty;				//instance matrices changed since the last upload
+		int upload_cnt;
+
+		//per instance data of the joint + link draw, instance i is joint i followed by link i
+		struct arm_instance {
+			mat4 joint;			//frame * scale(joint_sz)
+			mat4 link;			//frame * scale(link_rad , link_len , link_rad)
+		};
+
+		arm_instance arm_inst[3];
+		mat4 frame_inst[4];		//base + the three joint frames (unscaled)
+		mat4 base_model;		//base frame * scale(base_sz)
+
+		gl::VboRef arm_inst_vbo;
+		gl::VboRef frame_inst_vbo;
+		gl::BatchRef arm_batch;
+		gl::BatchRef frame_batch;
+
+		void create_batches();	//needs a gl context, called from the first draw
+};
@@ -0,0 +1,247 @@
+#include "rr_teleop.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <math.h>
+
+//joint limits (alpha , beta , theta , theta_0), arm joints as robot_manipulator::make_dls_chain
+//theta_0 only over the half the firmware base reaches (FirmwareChain::inverse solves the base with asin)
+static const float RR_MIN_ANGLE[4] = { -10.0f, -175.0f, -180.0f, -90.0f };
+static const float RR_MAX_ANGLE[4] = { 190.0f, 0.0f, 180.0f, 90.0f };
+
+//never replay more than this many control steps in one update (e.g. after the window was dragged)
+static const int RR_MAX_STEPS = 16;
+
+rr_params::rr_params() {
+    rate_hz = 100.0f;
+    gain = 10.0f;
+    smoothing = 0.4f;
+    deadband = 2.0f;
+    max_jump = 40.0f;
+    timeout = 0.2f;
+    max_joint_speed = 90.0f;
+    tool_weight = 5.0f;
+    tool_gain = 2.0f;
+    damping = 3.0f;
+    manip_threshold = 50.0f;
+}
+
+rr_teleop::rr_teleop() {
+    reset(vec4(90, -90, 0, 90), 0);
+}
+
+void rr_teleop::set_params(const rr_params& params)
+{
+    this->params = params;
+}
+
+const rr_params& rr_teleop::get_params() const
+{
+    return params;
+}
+
+void rr_teleop::reset(vec4 angles, double time)
+{
+    q = angles;
+    last_step = time;
+    steps = 0;
+
+    hand = vec3(0);
+    hand_time = time;
+    has_hand = false;
+    hand_vel = vec3(0);
+
+    manipulability = 0;
+    lambda = 0;
+}
+
+void rr_teleop::add_sample(vec3 hand, double time)
+{
+    if (!has_hand) {
+        this->hand = hand;
+        hand_time = time;
+        has_hand = true;
+        return;
+    }
+
+    double dt = time - hand_time;
+    if (dt <= 0) return;
+
+    vec3 delta = hand - this->hand;
+    this->hand = hand;
+    hand_time = time;
+
+    //tracking glitch, start the estimate over instead of commanding a huge velocity
+    if (length(delta) > params.max_jump) {
+        hand_vel = vec3(0);
+        return;
+    }
+
+    hand_vel = mix(hand_vel, delta / (float)dt, params.smoothing);
+}
+
+int rr_teleop::update(double now, vec3 limb_lens, float gamma)
+{
+    float dt = 1.0f / params.rate_hz;
+
+    //drop time we could not keep up with rather than replaying it all at once
+    if (now - last_step > RR_MAX_STEPS * dt) last_step = now - RR_MAX_STEPS * dt;
+
+    int n = 0;
+    while (now - last_step >= dt) {
+        last_step += dt;
+        step(dt, limb_lens, gamma);
+        n++;
+    }
+    steps += n;
+    return n;
+}
+
+vec4 rr_teleop::get_angles() const
+{
+    return q;
+}
+
+void rr_teleop::set_angles(vec4 angles)
+{
+    q = angles;
+}
+
+vec3 rr_teleop::get_hand_vel() const
+{
+    return hand_vel;
+}
+
+float rr_teleop::get_manipulability() const
+{
+    return manipulability;
+}
+
+float rr_teleop::get_lambda() const
+{
+    return lambda;
+}
+
+int rr_teleop::get_steps() const
+{
+    return steps;
+}
+
+void rr_teleop::jacobian(vec3 limb_lens, vec4 angles, float j[RR_TASK_ROWS][4])
+{
+    const float deg = (float)(M_PI / 180.0);
+
+    //absolute link angles in the arm plane
+    float a1 = angles.x * deg;
+    float a2 = a1 + angles.y * deg;
+    float a3 = a2 + angles.z * deg;
+    float t0 = angles.w * deg;
+
+    float c1 = cos(a1), s1 = sin(a1);
+    float c2 = cos(a2), s2 = sin(a2);
+    float c3 = cos(a3), s3 = sin(a3);
+    float ct0 = cos(t0), st0 = sin(t0);
+
+    //reach and height of the distal part of the chain starting at each joint
+    float r3 = limb_lens.z * c3, h3 = limb_lens.z * s3;
+    float r2 = limb_lens.y * c2 + r3, h2 = limb_lens.y * s2 + h3;
+    float r1 = limb_lens.x * c1 + r2, h1 = limb_lens.x * s1 + h2;
+
+    //x = reach * sin(theta_0) , y = height , z = reach * cos(theta_0) , gamma = alpha + beta + theta
+    //d reach / d joint = -(height beyond the joint) , d height / d joint = reach beyond the joint
+    float dr[3] = { -h1, -h2, -h3 };
+    float dh[3] = { r1, r2, r3 };
+    for (int i = 0; i < 3; i++) {
+        j[0][i] = dr[i] * st0 * deg;
+        j[1][i] = dh[i] * deg;
+        j[2][i] = dr[i] * ct0 * deg;
+        j[3][i] = 1.0f;
+    }
+    j[0][3] = r1 * ct0 * deg;
+    j[1][3] = 0;
+    j[2][3] = -r1 * st0 * deg;
+    j[3][3] = 0;
+}
+
+//in place Cholesky of a symmetric positive definite n x n matrix (lower triangle), returns the product of the diagonal
+static float cholesky(float a[RR_TASK_ROWS][RR_TASK_ROWS], int n)
+{
+    float diag = 1.0f;
+    for (int c = 0; c < n; c++) {
+        float d = a[c][c];
+        for (int k = 0; k < c; k++) d -= a[c][k] * a[c][k];
+        d = sqrt(std::max(d, 1e-12f));
+        a[c][c] = d;
+        diag *= d;
+        for (int r = c + 1; r < n; r++) {
+            float s = a[r][c];
+            for (int k = 0; k < c; k++) s -= a[r][k] * a[c][k];
+            a[r][c] = s / d;
+        }
+    }
+    return diag;
+}
+
+void rr_teleop::step(float dt, vec3 limb_lens, float gamma)
+{
+    float j[RR_TASK_ROWS][4];
+    float a[RR_TASK_ROWS][RR_TASK_ROWS];
+    float xdot[RR_TASK_ROWS];
+    float y[RR_TASK_ROWS];
+
+    jacobian(limb_lens, q, j);
+    for (int i = 0; i < 4; i++) j[3][i] *= params.tool_weight;
+
+    //commanded task velocity, the arm stops when tracking goes stale
+    vec3 v = hand_vel;
+    if (!has_hand || last_step - hand_time > params.timeout) v = vec3(0);
+    if (length(v) < params.deadband) v = vec3(0);
+    v *= params.gain;
+
+    float q_gamma = q.x + q.y + q.z;
+    xdot[0] = v.x;
+    xdot[1] = v.y;
+    xdot[2] = v.z;
+    xdot[3] = params.tool_weight * params.tool_gain * (gamma - q_gamma);
+
+    //A = J J^T
+    for (int r = 0; r < RR_TASK_ROWS; r++) {
+        for (int c = 0; c <= r; c++) {
+            float sum = 0;
+            for (int i = 0; i < 4; i++) sum += j[r][i] * j[c][i];
+            a[r][c] = sum;
+            a[c][r] = sum;
+        }
+    }
+
+    //manipulability of the position rows, damping fades in as it drops toward a singularity
+    float p[RR_TASK_ROWS][RR_TASK_ROWS];
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++) p[r][c] = a[r][c];
+    manipulability = cholesky(p, 3);
+
+    float ratio = manipulability / params.manip_threshold;
+    lambda = ratio < 1.0f ? params.damping * sqrt(1.0f - ratio * ratio) : 0.0f;
+    for (int r = 0; r < RR_TASK_ROWS; r++) a[r][r] += lambda * lambda;
+
+    //solve (J J^T + lambda^2 I) y = xdot
+    cholesky(a, RR_TASK_ROWS);
+    for (int r = 0; r < RR_TASK_ROWS; r++) {
+        float s = xdot[r];
+        for (int k = 0; k < r; k++) s -= a[r][k] * y[k];
+        y[r] = s / a[r][r];
+    }
+    for (int r = RR_TASK_ROWS - 1; r >= 0; r--) {
+        float s = y[r];
+        for (int k = r + 1; k < RR_TASK_ROWS; k++) s -= a[k][r] * y[k];
+        y[r] = s / a[r][r];
+    }
+
+    //qdot = J^T y, limited to the joint speed and integrated inside the joint limits
+    for (int i = 0; i < 4; i++) {
+        float qdot = 0;
+        for (int r = 0; r < RR_TASK_ROWS; r++) qdot += j[r][i] * y[r];
+        qdot = clamp(qdot, -params.max_joint_speed, params.max_joint_speed);
+        q[i] = clamp(q[i] + qdot * dt, RR_MIN_ANGLE[i], RR_MAX_ANGLE[i]);
+    }
+}
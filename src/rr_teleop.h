@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cinder/Vector.h"
+
+using namespace ci;
+
+//task rows: end effector x , y , z (milimeters relative to the shoulder, Y up) + tool angle gamma
+#define RR_TASK_ROWS 4
+
+struct rr_params {
+	float rate_hz;			//fixed control rate the joint velocities are integrated at
+	float gain;				//tool speed (mm/s) per hand speed (cm/s)
+	float smoothing;		//0..1 weight of the newest hand velocity sample (exponential moving average)
+	float deadband;			//hand speeds below this are treated as zero (cm/s)
+	float max_jump;			//hand moves larger than this between two frames are tracking glitches (cm)
+	float timeout;			//seconds without a skeleton sample before the arm is stopped
+	float max_joint_speed;	//degrees per second
+	float tool_weight;		//milimeters per degree of tool angle error in the task space
+	float tool_gain;		//1/s, how fast gamma is pulled toward the requested tool angle
+	float damping;			//max damping (mm/deg), applied fully at a singularity and faded out at manip_threshold
+	float manip_threshold;	//manipulability below which damping starts
+
+	rr_params();
+};
+
+//Resolved rate teleoperation: qdot = J^T (J J^T + lambda^2 I)^-1 xdot
+//Hand velocity from successive skeleton frames is mapped through the analytic jacobian of the 4DOF arm
+//and integrated at a fixed rate, no IK solve per sample
+//Joint order is (alpha , beta , theta , theta_0) in degrees like robot_manipulator::get_angles
+class rr_teleop
+{
+	public:
+
+		rr_teleop();
+
+		void set_params(const rr_params& params);
+		const rr_params& get_params() const;
+
+		//start integrating from angles, clears the hand velocity estimate
+		void reset(vec4 angles, double time);
+
+		//new tracked hand position (centimeters, sensor frame mapped to robot axes) taken at time (seconds)
+		void add_sample(vec3 hand, double time);
+
+		//integrate fixed steps up to time now, gamma is the requested tool angle
+		//returns the number of control steps taken
+		int update(double now, vec3 limb_lens, float gamma);
+
+		vec4 get_angles() const;
+		void set_angles(vec4 angles);		//move the integrated pose (e.g. back into a workspace box), the hand velocity is kept
+		vec3 get_hand_vel() const;		//filtered hand velocity (cm/s)
+		float get_manipulability() const;	//of the last step, sqrt(det(J J^T)) of the position rows
+		float get_lambda() const;			//damping used in the last step
+		int get_steps() const;				//control steps since reset
+
+		//analytic jacobian at angles, rows (x , y , z , gamma) per degree of each joint
+		static void jacobian(vec3 limb_lens, vec4 angles, float j[RR_TASK_ROWS][4]);
+
+	private:
+
+		rr_params params;
+
+		vec4 q;				//joint angles being integrated
+		double last_step;	//time of the last control step
+		int steps;
+
+		vec3 hand;			//last accepted hand sample
+		double hand_time;
+		bool has_hand;
+		vec3 hand_vel;
+
+		float manipulability;
+		float lambda;
+
+		void step(float dt, vec3 limb_lens, float gamma);
+};
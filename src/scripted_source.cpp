@@ -0,0 +1,195 @@
+#include "scripted_source.h"
+
+#include <algorithm>
+#include <math.h>
+
+//standing pose of the left half of the body relative to the hip center (meters), the right half is mirrored in x
+//arms are bent with the hands held in front of the chest like an operator driving the arm
+static const vec3 SCRIPT_POSE[SKEL_JOINT_COUNT] = {
+    vec3(0.0f, 0.0f, 0.0f),         //hip center
+    vec3(0.0f, 0.1f, 0.0f),         //spine
+    vec3(0.0f, 0.45f, 0.0f),        //shoulder center
+    vec3(0.0f, 0.62f, 0.0f),        //head
+    vec3(-0.18f, 0.42f, 0.0f),      //shoulder left
+    vec3(-0.22f, 0.18f, -0.05f),    //elbow left
+    vec3(-0.2f, 0.25f, -0.3f),      //wrist left
+    vec3(-0.2f, 0.27f, -0.38f),     //hand left
+    vec3(0.18f, 0.42f, 0.0f),       //shoulder right
+    vec3(0.22f, 0.18f, -0.05f),     //elbow right
+    vec3(0.2f, 0.25f, -0.3f),       //wrist right
+    vec3(0.2f, 0.27f, -0.38f),      //hand right
+    vec3(-0.08f, -0.05f, 0.0f),     //hip left
+    vec3(-0.09f, -0.5f, 0.0f),      //knee left
+    vec3(-0.09f, -0.9f, 0.02f),     //ankle left
+    vec3(-0.09f, -0.95f, -0.1f),    //foot left
+    vec3(0.08f, -0.05f, 0.0f),      //hip right
+    vec3(0.09f, -0.5f, 0.0f),       //knee right
+    vec3(0.09f, -0.9f, 0.02f),      //ankle right
+    vec3(0.09f, -0.95f, -0.1f)      //foot right
+};
+
+//how much of the hand motion each arm joint follows
+static const float SCRIPT_ELBOW_FOLLOW = 0.5f;
+static const float SCRIPT_WRIST_FOLLOW = 0.9f;
+
+//tracking id of the first generated body
+#define SCRIPT_BODY_ID 1
+
+//sideways spacing of extra bodies (meters)
+static const float SCRIPT_PERSON_SPACING = 0.8f;
+
+//frames a body stays lost at every dropout
+static const int SCRIPT_DROPOUT_FRAMES = 3;
+
+script_params::script_params() {
+    motion = SCRIPT_CIRCLE;
+    fps = 30.0f;
+    duration = 0.0f;
+    amplitude = 0.15f;
+    period = 4.0f;
+    noise = 0.003f;
+    seed = 1;
+    distance = 2.0f;
+    people = 1;
+    dropout = 0.0f;
+}
+
+scripted_source::scripted_source() {
+    realtime = false;
+    running = false;
+    delivered = 0;
+}
+
+void scripted_source::set_params(const script_params& params)
+{
+    this->params = params;
+}
+
+const script_params& scripted_source::get_params() const
+{
+    return params;
+}
+
+void scripted_source::set_realtime(bool realtime)
+{
+    this->realtime = realtime;
+}
+
+bool scripted_source::start()
+{
+    rand.seed(params.seed);
+    delivered = 0;
+    running = true;
+    clock.start();
+    return true;
+}
+
+void scripted_source::stop()
+{
+    running = false;
+    clock.stop();
+}
+
+bool scripted_source::pop(skeleton_frame& frame)
+{
+    if (!running || finished()) return false;
+
+    double t = delivered / params.fps;
+    if (realtime && clock.getSeconds() < t) return false;
+
+    make_frame(delivered, frame);
+    delivered++;
+    return true;
+}
+
+bool scripted_source::finished() const
+{
+    return params.duration > 0 && delivered >= params.duration * params.fps;
+}
+
+const char* scripted_source::get_name() const
+{
+    return "Scripted";
+}
+
+uint32_t scripted_source::get_delivered() const
+{
+    return delivered;
+}
+
+const char* scripted_source::get_motion_name(int motion)
+{
+    switch (motion) {
+        case SCRIPT_IDLE:
+            return "Idle";
+        case SCRIPT_CIRCLE:
+            return "Circle";
+        case SCRIPT_SWEEP:
+            return "Sweep";
+        default:
+            return "Unknown";
+    }
+}
+
+void scripted_source::make_frame(uint32_t n, skeleton_frame& frame)
+{
+    double t = n / params.fps;
+
+    frame = skeleton_frame();
+    frame.time = t;
+    frame.timestamp = (int64_t)(t * 1000.0);
+    frame.number = n + 1;
+    frame.floor = vec4(0, 1, 0, 0.95f);     //floor just under the feet , 0.95 m below the hip
+
+    int people = std::max(1, std::min(params.people, SKEL_BODY_COUNT));
+    for (int k = 0; k < people; k++) {
+        //every dropout moves everyone one slot on under a new tracking id , after a few frames of nothing
+        int epoch = params.dropout > 0 ? (int)(t / params.dropout) : 0;
+        if (epoch > 0 && t - epoch * params.dropout < SCRIPT_DROPOUT_FRAMES / params.fps) continue;
+
+        skeleton_body& body = frame.bodies[(k + epoch) % SKEL_BODY_COUNT];
+        body.tracked = true;
+        body.id = SCRIPT_BODY_ID + k + epoch * people;
+        make_body(k, t, body);
+    }
+}
+
+void scripted_source::make_body(int k, double t, skeleton_body& body)
+{
+    //the others run the same motion a bit out of phase
+    float w = (float)(2 * M_PI * t / params.period) + k * 0.5f;
+    float a = params.amplitude;
+
+    //offset of the left hand, the right hand mirrors it
+    vec3 hand = vec3(0);
+    switch (params.motion) {
+        case SCRIPT_CIRCLE:
+            hand = vec3(a * cos(w) - a, a * sin(w), 0);
+            break;
+        case SCRIPT_SWEEP:
+            hand = vec3(a * sin(w), 0.5f * a * sin(2 * w), 0.5f * a * sin(0.5f * w));
+            break;
+        default:
+            break;
+    }
+
+    //first body in the middle , then alternating right and left
+    float side = (float)((k + 1) / 2) * (k % 2 ? 1.0f : -1.0f);
+    vec3 hip = vec3(side * SCRIPT_PERSON_SPACING, 0, params.distance);
+    vec3 mirror = vec3(-1, 1, 1);
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        vec3 p = hip + SCRIPT_POSE[j];
+
+        if (j == SKEL_ELBOW_LEFT) p += SCRIPT_ELBOW_FOLLOW * hand;
+        else if (j == SKEL_WRIST_LEFT) p += SCRIPT_WRIST_FOLLOW * hand;
+        else if (j == SKEL_HAND_LEFT) p += hand;
+        else if (j == SKEL_ELBOW_RIGHT) p += SCRIPT_ELBOW_FOLLOW * hand * mirror;
+        else if (j == SKEL_WRIST_RIGHT) p += SCRIPT_WRIST_FOLLOW * hand * mirror;
+        else if (j == SKEL_HAND_RIGHT) p += hand * mirror;
+
+        if (params.noise > 0) p += vec3(rand.nextGaussian(), rand.nextGaussian(), rand.nextGaussian()) * params.noise;
+
+        body.joints[j] = p;
+        body.state[j] = SKEL_TRACKED;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "cinder/Rand.h"
+#include "cinder/Timer.h"
+
+#include "skeleton_source.h"
+
+using namespace ci;
+
+//hand motions the scripted source can play
+enum script_motion {
+	SCRIPT_IDLE = 0,		//standing still (noise only)
+	SCRIPT_CIRCLE,			//both hands trace a circle in front of the body
+	SCRIPT_SWEEP,			//both hands sweep left and right , up and down
+	SCRIPT_MOTION_COUNT
+};
+
+struct script_params {
+	int motion;				//script_motion
+	float fps;				//frame rate of the generated stream
+	float duration;			//seconds of frames before finishing, 0 runs forever
+	float amplitude;		//hand travel (meters)
+	float period;			//seconds per cycle of the motion
+	float noise;			//standard deviation of the joint jitter (meters)
+	uint32_t seed;			//noise seed, the same seed always gives the same stream
+	float distance;			//how far from the sensor the body stands (meters)
+	int people;				//bodies in view , the first in the middle and the others side by side (1 - SKEL_BODY_COUNT)
+	float dropout;			//every this many seconds each body is lost for a few frames and comes back under a new
+							//tracking id in another slot (like the sensor re-acquiring someone) , 0 never
+
+	script_params();
+};
+
+//Synthetic skeleton stream, tracked bodies in a fixed standing pose with scripted hand motion
+//Deterministic for a given seed so headless runs are repeatable
+//In realtime mode frames are released at fps, otherwise as fast as they are popped
+class scripted_source : public skeleton_source
+{
+	public:
+
+		scripted_source();
+
+		void set_params(const script_params& params);	//call before start
+		const script_params& get_params() const;
+		void set_realtime(bool realtime);
+
+		bool start() override;
+		void stop() override;
+		bool pop(skeleton_frame& frame) override;
+		bool finished() const override;
+
+		const char* get_name() const override;
+		uint32_t get_delivered() const override;
+
+		static const char* get_motion_name(int motion);
+
+	private:
+
+		script_params params;
+		bool realtime;
+		bool running;
+
+		Rand rand;
+		Timer clock;
+		uint32_t delivered;
+
+		void make_frame(uint32_t n, skeleton_frame& frame);
+		void make_body(int k, double t, skeleton_body& body);
+};
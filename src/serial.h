@@ -29,7 +29,7 @@ class SerialPort
         SerialPort();               //default constructor (does not open port yet)
         char  ReadData[1000];        //Buffer for data read
         int open(char * portname);  //fxn to open user specified port
-        void write(char * buff);    //fxn to write to port
+        void write(const char * buff);    //fxn to write to port
         void write_gcode(char* buff); //fxn to write gcode to arduino mega Note: this waits for a reply
         void close();               //fxn to close port
 
@@ -110,7 +110,7 @@ int SerialPort::open(char * port_name) {
     return 0;
 }
 
-void SerialPort::write(char* buff) {
+void SerialPort::write(const char* buff) {
     
     char SerialBuffer[128] = { 0 };     
     sprintf(SerialBuffer, "\r\n%s\r\n", buff);
@@ -0,0 +1,432 @@
+#include "skeleton_archive.h"
+
+#include <math.h>
+#include <string.h>
+
+//file and block headers
+static const char ARCHIVE_MAGIC[4] = { 'K', 'X', 'S', 'A' };
+static const char ARCHIVE_BLOCK_MAGIC[4] = { 'K', 'X', 'A', 'B' };
+
+//larger payloads can only come from a damaged block header
+static const uint32_t ARCHIVE_MAX_PAYLOAD = 1 << 24;
+
+//frame flags
+#define ARCHIVE_FLAG_FLOOR 1		//floor plane changed, deltas follow
+
+struct archive_file_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t units_per_m;
+	uint32_t block_frames;
+};
+
+struct archive_block_header {
+	char magic[4];
+	uint32_t frame_count;
+	uint32_t payload_size;
+	uint32_t crc;
+};
+
+archive_state::archive_state() {
+    time_us = 0;
+    timestamp = 0;
+    number = 0;
+    memset(floor, 0, sizeof(floor));
+    memset(tracked, 0, sizeof(tracked));
+    memset(id, 0, sizeof(id));
+    memset(joints, 0, sizeof(joints));
+}
+
+uint32_t archive_crc32(const uint8_t* data, size_t len)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if (!table_ready) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        table_ready = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+//---------------------------------------------varints--------------------------------------------------
+
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline void put_varint(vector<uint8_t>& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static inline void put_delta(vector<uint8_t>& out, int64_t v, int64_t ref)
+{
+    put_varint(out, zigzag(v - ref));
+}
+
+//false if the varint runs past end
+static inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static inline bool get_delta(const uint8_t*& p, const uint8_t* end, int64_t ref, int64_t& v)
+{
+    uint64_t u;
+    if (!get_varint(p, end, u)) return false;
+    v = ref + unzigzag(u);
+    return true;
+}
+
+static inline int32_t quantize(float v)
+{
+    return (int32_t)lroundf(v * ARCHIVE_UNITS_PER_M);
+}
+
+//---------------------------------------------writer---------------------------------------------------
+
+archive_writer::archive_writer() {
+    file = NULL;
+    block_frames = 0;
+    frames = 0;
+    bytes = 0;
+}
+
+archive_writer::~archive_writer() {
+    close();
+}
+
+bool archive_writer::open(const string& path)
+{
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "Could not create " + path;
+        return false;
+    }
+
+    archive_file_header header;
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    header.units_per_m = ARCHIVE_UNITS_PER_M;
+    header.block_frames = ARCHIVE_BLOCK_FRAMES;
+    fwrite(&header, sizeof(header), 1, file);
+
+    error = "";
+    block.clear();
+    block_frames = 0;
+    prev = archive_state();
+    frames = 0;
+    bytes = sizeof(header);
+    return true;
+}
+
+void archive_writer::add(const skeleton_frame& frame)
+{
+    if (!file) return;
+
+    //quantize to what the decoder will reconstruct
+    archive_state cur;
+    cur.time_us = llround(frame.time * 1e6);
+    cur.timestamp = frame.timestamp;
+    cur.number = frame.number;
+    for (int i = 0; i < 4; i++) cur.floor[i] = quantize(frame.floor[i]);
+
+    uint8_t flags = 0;
+    if (memcmp(cur.floor, prev.floor, sizeof(cur.floor)) != 0) flags |= ARCHIVE_FLAG_FLOOR;
+
+    uint8_t mask = 0;
+    for (int b = 0; b < SKEL_BODY_COUNT; b++)
+        if (frame.bodies[b].tracked) mask |= 1 << b;
+
+    block.push_back(flags);
+    block.push_back(mask);
+    put_delta(block, cur.time_us, prev.time_us);
+    put_delta(block, cur.timestamp, prev.timestamp);
+    put_delta(block, cur.number, prev.number);
+    if (flags & ARCHIVE_FLAG_FLOOR)
+        for (int i = 0; i < 4; i++) put_delta(block, cur.floor[i], prev.floor[i]);
+
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        const skeleton_body& body = frame.bodies[b];
+        cur.tracked[b] = body.tracked;
+        if (!body.tracked) continue;
+
+        cur.id[b] = body.id;
+        put_varint(block, body.id);
+
+        //joint states , 2 bits each
+        uint8_t packed[(SKEL_JOINT_COUNT + 3) / 4] = { 0 };
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) packed[j / 4] |= (body.state[j] & 3) << ((j % 4) * 2);
+        block.insert(block.end(), packed, packed + sizeof(packed));
+
+        //same person in the same slot last frame: code the motion , otherwise the positions
+        bool ref = prev.tracked[b] && prev.id[b] == body.id;
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+            for (int c = 0; c < 3; c++) {
+                cur.joints[b][j][c] = quantize(body.joints[j][c]);
+                put_delta(block, cur.joints[b][j][c], ref ? prev.joints[b][j][c] : 0);
+            }
+        }
+    }
+
+    prev = cur;
+    block_frames++;
+    frames++;
+    if (block_frames == ARCHIVE_BLOCK_FRAMES) flush_block();
+}
+
+void archive_writer::flush_block()
+{
+    if (block_frames == 0) return;
+
+    archive_block_header header;
+    memcpy(header.magic, ARCHIVE_BLOCK_MAGIC, sizeof(header.magic));
+    header.frame_count = block_frames;
+    header.payload_size = (uint32_t)block.size();
+    header.crc = archive_crc32(block.data(), block.size());
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(block.data(), 1, block.size(), file);
+    bytes += sizeof(header) + block.size();
+
+    //next block starts from scratch so it decodes on its own
+    block.clear();
+    block_frames = 0;
+    prev = archive_state();
+}
+
+void archive_writer::close()
+{
+    if (!file) return;
+
+    flush_block();
+    if (ferror(file)) error = "Write error";
+    fclose(file);
+    file = NULL;
+}
+
+uint32_t archive_writer::get_frames() const
+{
+    return frames;
+}
+
+uint64_t archive_writer::get_bytes() const
+{
+    return bytes;
+}
+
+string archive_writer::get_error() const
+{
+    return error;
+}
+
+//---------------------------------------------reader---------------------------------------------------
+
+archive_reader::archive_reader() {
+    file = NULL;
+    pos = 0;
+    block_left = 0;
+    frames = 0;
+    bad_blocks = 0;
+}
+
+archive_reader::~archive_reader() {
+    close();
+}
+
+bool archive_reader::open(const string& path)
+{
+    close();
+
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "Could not open " + path;
+        return false;
+    }
+
+    archive_file_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != ARCHIVE_VERSION || header.units_per_m != ARCHIVE_UNITS_PER_M) {
+        error = path + " is not a skeleton archive";
+        close();
+        return false;
+    }
+
+    error = "";
+    block.clear();
+    pos = 0;
+    block_left = 0;
+    frames = 0;
+    bad_blocks = 0;
+    return true;
+}
+
+void archive_reader::close()
+{
+    if (file) fclose(file);
+    file = NULL;
+}
+
+bool archive_reader::read_block()
+{
+    archive_block_header header;
+
+    while (fread(&header, sizeof(header), 1, file) == 1) {
+        long start = ftell(file) - (long)sizeof(header);
+
+        bool ok = memcmp(header.magic, ARCHIVE_BLOCK_MAGIC, sizeof(header.magic)) == 0
+            && header.payload_size <= ARCHIVE_MAX_PAYLOAD && header.frame_count > 0;
+        if (ok) {
+            block.resize(header.payload_size);
+            ok = fread(block.data(), 1, block.size(), file) == block.size()
+                && archive_crc32(block.data(), block.size()) == header.crc;
+        }
+        if (ok) {
+            pos = 0;
+            block_left = header.frame_count;
+            prev = archive_state();
+            return true;
+        }
+
+        //damaged: look for the next block magic after this header
+        bad_blocks++;
+        fseek(file, start + 1, SEEK_SET);
+        char window[4] = { 0 };
+        int c;
+        while ((c = fgetc(file)) != EOF) {
+            memmove(window, window + 1, 3);
+            window[3] = (char)c;
+            if (memcmp(window, ARCHIVE_BLOCK_MAGIC, sizeof(window)) == 0) {
+                fseek(file, -4, SEEK_CUR);
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+bool archive_reader::next(skeleton_frame& frame)
+{
+    if (!file) return false;
+
+    while (true) {
+        if (block_left == 0 && !read_block()) return false;
+
+        const uint8_t* p = block.data() + pos;
+        const uint8_t* end = block.data() + block.size();
+
+        archive_state cur;
+        bool ok = end - p >= 2;
+        uint8_t flags = ok ? p[0] : 0;
+        uint8_t mask = ok ? p[1] : 0;
+        p += ok ? 2 : 0;
+
+        int64_t v = 0;
+        ok = ok && get_delta(p, end, prev.time_us, cur.time_us);
+        ok = ok && get_delta(p, end, prev.timestamp, cur.timestamp);
+        ok = ok && get_delta(p, end, prev.number, v);
+        cur.number = (uint32_t)v;
+        memcpy(cur.floor, prev.floor, sizeof(cur.floor));
+        if (flags & ARCHIVE_FLAG_FLOOR) {
+            for (int i = 0; i < 4 && ok; i++) {
+                ok = get_delta(p, end, prev.floor[i], v);
+                cur.floor[i] = (int32_t)v;
+            }
+        }
+
+        frame = skeleton_frame();
+        for (int b = 0; b < SKEL_BODY_COUNT && ok; b++) {
+            if (!(mask & (1 << b))) continue;
+
+            uint64_t id;
+            ok = get_varint(p, end, id) && end - p >= (SKEL_JOINT_COUNT + 3) / 4;
+            if (!ok) break;
+
+            skeleton_body& body = frame.bodies[b];
+            body.tracked = true;
+            body.id = (uint32_t)id;
+            cur.tracked[b] = true;
+            cur.id[b] = body.id;
+
+            for (int j = 0; j < SKEL_JOINT_COUNT; j++) body.state[j] = (p[j / 4] >> ((j % 4) * 2)) & 3;
+            p += (SKEL_JOINT_COUNT + 3) / 4;
+
+            bool ref = prev.tracked[b] && prev.id[b] == body.id;
+            for (int j = 0; j < SKEL_JOINT_COUNT && ok; j++) {
+                for (int c = 0; c < 3 && ok; c++) {
+                    ok = get_delta(p, end, ref ? prev.joints[b][j][c] : 0, v);
+                    cur.joints[b][j][c] = (int32_t)v;
+                    body.joints[j][c] = (float)v / ARCHIVE_UNITS_PER_M;
+                }
+            }
+        }
+
+        //a block that passed its checksum but does not parse was written by something else, drop the rest of it
+        if (!ok) {
+            bad_blocks++;
+            block_left = 0;
+            continue;
+        }
+
+        frame.time = cur.time_us / 1e6;
+        frame.timestamp = cur.timestamp;
+        frame.number = cur.number;
+        for (int i = 0; i < 4; i++) frame.floor[i] = (float)cur.floor[i] / ARCHIVE_UNITS_PER_M;
+
+        pos = p - block.data();
+        block_left--;
+        prev = cur;
+        frames++;
+        return true;
+    }
+}
+
+uint32_t archive_reader::get_frames() const
+{
+    return frames;
+}
+
+uint32_t archive_reader::get_bad_blocks() const
+{
+    return bad_blocks;
+}
+
+string archive_reader::get_error() const
+{
+    return error;
+}
+
+bool archive_reader::is_archive(const string& path)
+{
+    char magic[4] = { 0 };
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return n == sizeof(magic) && memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "skeleton_frame.h"
+
+using namespace std;
+
+//Compressed skeleton archive (.kxa) for long term storage of sessions
+//Joint positions and the floor plane are quantized to ARCHIVE_UNITS_PER_M (0.1 mm steps), times to microseconds
+//Every value is delta coded against the previous frame (same body slot and tracking id) and packed as a zigzag varint
+//Frames are grouped in blocks of up to ARCHIVE_BLOCK_FRAMES with a CRC32 each, the first frame of a block is coded
+//against nothing so a damaged block only loses its own frames and the decoder picks up again at the next one
+//  file header (16 bytes) | block header (16 bytes) , payload | block header , payload | ...
+
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_UNITS_PER_M 10000
+#define ARCHIVE_BLOCK_FRAMES 64
+
+//last frame as the decoder sees it, encoder and decoder both delta code against this so rounding never accumulates
+struct archive_state {
+	int64_t time_us;
+	int64_t timestamp;
+	uint32_t number;
+	int32_t floor[4];
+	bool tracked[SKEL_BODY_COUNT];
+	uint32_t id[SKEL_BODY_COUNT];
+	int32_t joints[SKEL_BODY_COUNT][SKEL_JOINT_COUNT][3];
+
+	archive_state();
+};
+
+class archive_writer
+{
+	public:
+
+		archive_writer();
+		~archive_writer();
+
+		bool open(const string& path);
+		void add(const skeleton_frame& frame);
+		void close();						//writes the last partial block
+
+		uint32_t get_frames() const;
+		uint64_t get_bytes() const;			//bytes written so far (including headers)
+		string get_error() const;
+
+	private:
+
+		FILE* file;
+		string error;
+
+		vector<uint8_t> block;				//payload of the block being filled
+		uint32_t block_frames;
+		archive_state prev;
+
+		uint32_t frames;
+		uint64_t bytes;
+
+		void flush_block();
+};
+
+//Streaming decoder, reads one block at a time and hands out frames in order
+class archive_reader
+{
+	public:
+
+		archive_reader();
+		~archive_reader();
+
+		bool open(const string& path);
+		void close();
+
+		//next frame, false at the end of the archive
+		//blocks failing their checksum are skipped and counted
+		bool next(skeleton_frame& frame);
+
+		uint32_t get_frames() const;		//frames decoded
+		uint32_t get_bad_blocks() const;
+		string get_error() const;
+
+		static bool is_archive(const string& path);		//true if path starts with the archive magic
+
+	private:
+
+		FILE* file;
+		string error;
+
+		vector<uint8_t> block;
+		size_t pos;							//read position in block
+		uint32_t block_left;				//frames left in block
+		archive_state prev;
+
+		uint32_t frames;
+		uint32_t bad_blocks;
+
+		bool read_block();
+};
+
+//standard CRC32 (IEEE , reflected 0xEDB88320)
+uint32_t archive_crc32(const uint8_t* data, size_t len);
@@ -0,0 +1,248 @@
+#include "skeleton_filter.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <math.h>
+
+//a gap longer than this (seconds) restarts every joint instead of integrating across it
+static const double FILTER_MAX_GAP = 0.5;
+
+//frame spacing assumed for the first frame after a restart (Kinect rate)
+static const float FILTER_NOMINAL_DT = 1.0f / 30.0f;
+
+//the stats forget about this fraction per frame (about 2 seconds at 30 fps)
+static const double FILTER_STATS_DECAY = 1.0 / 64.0;
+
+//lag is only measured while the output moves faster than this (m/s), a still joint has no measurable delay
+static const float FILTER_LAG_MIN_SPEED = 0.2f;
+
+//lower bound on inferred_weight so an inferred joint never gets an infinite measurement noise
+static const float FILTER_MIN_WEIGHT = 0.05f;
+
+//initial velocity variance of a Kalman joint ((m/s)^2)
+static const float FILTER_INITIAL_VEL_VAR = 1.0f;
+
+filter_params::filter_params() {
+    kind = FILTER_ONE_EURO;
+
+    min_cutoff = 1.5f;
+    beta = 5.0f;
+    d_cutoff = 1.0f;
+
+    process_noise = 1.0f;
+    measurement_noise = 0.01f;
+
+    inferred_weight = 0.3f;
+}
+
+skeleton_filter::skeleton_filter() {
+    reset();
+}
+
+void skeleton_filter::set_params(const filter_params& params)
+{
+    bool restart = params.kind != this->params.kind;
+    this->params = params;
+    if (restart) reset();
+}
+
+const filter_params& skeleton_filter::get_params() const
+{
+    return params;
+}
+
+void skeleton_filter::reset()
+{
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        bodies[b].tracked = false;
+        bodies[b].id = 0;
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) bodies[b].joints[j].valid = false;
+    }
+    last_time = 0;
+    has_time = false;
+
+    lag_num = 0;
+    lag_den = 0;
+    raw_jitter_sum = 0;
+    jitter_sum = 0;
+    jitter_weight = 0;
+
+    stats.lag_ms = 0;
+    stats.raw_jitter_mm = 0;
+    stats.jitter_mm = 0;
+    stats.frames = 0;
+}
+
+void skeleton_filter::filter(skeleton_frame& frame)
+{
+    //time step from the frame clock, a jump backwards or a long gap starts every joint over
+    float dt = FILTER_NOMINAL_DT;
+    if (has_time) {
+        double gap = frame.time - last_time;
+        if (gap <= 0 || gap > FILTER_MAX_GAP) {
+            for (int b = 0; b < SKEL_BODY_COUNT; b++) bodies[b].tracked = false;
+        }
+        else dt = (float)gap;
+    }
+    last_time = frame.time;
+    has_time = true;
+
+    lag_num *= 1.0 - FILTER_STATS_DECAY;
+    lag_den *= 1.0 - FILTER_STATS_DECAY;
+    raw_jitter_sum *= 1.0 - FILTER_STATS_DECAY;
+    jitter_sum *= 1.0 - FILTER_STATS_DECAY;
+    jitter_weight *= 1.0 - FILTER_STATS_DECAY;
+
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        skeleton_body& body = frame.bodies[b];
+        body_state& state = bodies[b];
+
+        if (!body.tracked) {
+            state.tracked = false;
+            continue;
+        }
+
+        //somebody new in this slot
+        if (!state.tracked || state.id != body.id) {
+            for (int j = 0; j < SKEL_JOINT_COUNT; j++) state.joints[j].valid = false;
+            state.tracked = true;
+            state.id = body.id;
+        }
+
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+            joint_state& s = state.joints[j];
+            vec3 raw = body.joints[j];
+
+            //lost joint: hold (or predict) the last output for a while , nothing to measure
+            if (body.state[j] == SKEL_NOT_TRACKED) {
+                if (!s.valid) continue;
+                s.lost += dt;
+                if (s.lost > FILTER_MAX_GAP) {
+                    s.valid = false;
+                    continue;
+                }
+                if (params.kind == FILTER_KALMAN) kalman(s, raw, dt, 1.0f, false);
+                body.joints[j] = s.x;
+                continue;
+            }
+
+            float weight = body.state[j] == SKEL_INFERRED ? std::max(params.inferred_weight, FILTER_MIN_WEIGHT) : 1.0f;
+
+            if (!s.valid) {
+                s.valid = true;
+                s.x = raw;
+                s.dx = vec3(0);
+                s.p[0] = params.measurement_noise * params.measurement_noise;
+                s.p[1] = 0;
+                s.p[2] = FILTER_INITIAL_VEL_VAR;
+                s.history = 0;
+            }
+            else if (params.kind == FILTER_ONE_EURO) one_euro(s, raw, dt, weight);
+            else if (params.kind == FILTER_KALMAN) kalman(s, raw, dt, weight, true);
+            else s.x = raw;
+
+            s.lost = 0;
+            measure(s, raw, dt);
+            body.joints[j] = s.x;
+        }
+    }
+
+    stats.lag_ms = lag_den > 0 ? (float)(lag_num / lag_den * 1000.0) : 0.0f;
+    stats.raw_jitter_mm = jitter_weight > 0 ? (float)sqrt(raw_jitter_sum / jitter_weight) * 1000.0f : 0.0f;
+    stats.jitter_mm = jitter_weight > 0 ? (float)sqrt(jitter_sum / jitter_weight) * 1000.0f : 0.0f;
+    stats.frames++;
+}
+
+const filter_stats& skeleton_filter::get_stats() const
+{
+    return stats;
+}
+
+const char* skeleton_filter::get_kind_name(int kind)
+{
+    switch (kind) {
+        case FILTER_PASSTHROUGH:
+            return "Passthrough";
+        case FILTER_ONE_EURO:
+            return "One-Euro";
+        case FILTER_KALMAN:
+            return "Kalman";
+        default:
+            return "Passthrough";
+    }
+}
+
+//smoothing factor of a first order low pass with this cutoff
+static float lowpass_alpha(float cutoff, float dt)
+{
+    float tau = 1.0f / (2.0f * (float)M_PI * std::max(cutoff, 0.001f));
+    return dt / (dt + tau);
+}
+
+void skeleton_filter::one_euro(joint_state& s, vec3 z, float dt, float weight)
+{
+    //speed of the joint from the last output , smoothed on its own cutoff
+    s.dx = mix(s.dx, (z - s.x) / dt, lowpass_alpha(params.d_cutoff, dt));
+
+    //faster joints get a higher cutoff (less lag) , inferred ones a lower one (more smoothing)
+    float cutoff = (params.min_cutoff + params.beta * length(s.dx)) * weight;
+    s.x = mix(s.x, z, lowpass_alpha(cutoff, dt));
+}
+
+void skeleton_filter::kalman(joint_state& s, vec3 z, float dt, float weight, bool measured)
+{
+    //predict: constant velocity , white acceleration noise
+    float q = params.process_noise * params.process_noise;
+    s.x += s.dx * dt;
+    float p00 = s.p[0] + dt * (2.0f * s.p[1] + dt * s.p[2]) + q * dt * dt * dt / 3.0f;
+    float p01 = s.p[1] + dt * s.p[2] + q * dt * dt / 2.0f;
+    float p11 = s.p[2] + q * dt;
+
+    if (measured) {
+        //position measurement , inferred joints are noisier
+        float r = params.measurement_noise / weight;
+        float innovation = p00 + r * r;
+        float k0 = p00 / innovation;
+        float k1 = p01 / innovation;
+
+        vec3 y = z - s.x;
+        s.x += k0 * y;
+        s.dx += k1 * y;
+
+        p11 -= k1 * p01;
+        p01 *= 1.0f - k0;
+        p00 *= 1.0f - k0;
+    }
+
+    s.p[0] = p00;
+    s.p[1] = p01;
+    s.p[2] = p11;
+}
+
+void skeleton_filter::measure(joint_state& s, vec3 raw, float dt)
+{
+    //lag: least squares delay d with raw - out = d * output velocity , only while the joint moves
+    //(output velocity so raw noise does not correlate with itself)
+    if (s.history >= 1) {
+        vec3 v = (s.x - s.out[0]) / dt;
+        if (length(v) > FILTER_LAG_MIN_SPEED) {
+            lag_num += dot(raw - s.x, v);
+            lag_den += dot(v, v);
+        }
+    }
+
+    //jitter: second difference of successive positions
+    if (s.history >= 2) {
+        vec3 raw_acc = raw - 2.0f * s.raw[0] + s.raw[1];
+        vec3 out_acc = s.x - 2.0f * s.out[0] + s.out[1];
+        raw_jitter_sum += dot(raw_acc, raw_acc);
+        jitter_sum += dot(out_acc, out_acc);
+        jitter_weight += 1.0;
+    }
+
+    s.raw[1] = s.raw[0];
+    s.raw[0] = raw;
+    s.out[1] = s.out[0];
+    s.out[0] = s.x;
+    s.history = std::min(s.history + 1, 2);
+}
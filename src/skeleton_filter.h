@@ -0,0 +1,99 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+
+#include "skeleton_frame.h"
+
+using namespace ci;
+
+//filter stages, order of the "Joint filter" combo
+enum filter_kind {
+	FILTER_PASSTHROUGH = 0,
+	FILTER_ONE_EURO,
+	FILTER_KALMAN,
+	FILTER_KIND_COUNT
+};
+
+struct filter_params {
+	int kind;					//filter_kind
+
+	//One-Euro: cutoff = min_cutoff + beta * speed , slow motion is smoothed hard , fast motion follows with little lag
+	float min_cutoff;			//Hz, cutoff when the joint is still
+	float beta;					//Hz per m/s of joint speed
+	float d_cutoff;				//Hz, cutoff of the speed estimate
+
+	//constant velocity Kalman per joint
+	float process_noise;		//m/s^2, how hard the joint may accelerate
+	float measurement_noise;	//m, sensor position noise of a tracked joint
+
+	//inferred joints are trusted this much (0..1) , lowers the One-Euro cutoff / scales up the Kalman measurement noise
+	float inferred_weight;
+
+	filter_params();
+};
+
+//lag and jitter of the filter output, exponential averages over the last couple of seconds
+struct filter_stats {
+	float lag_ms;				//least squares delay of the output behind the raw joints while they move
+	float raw_jitter_mm;		//rms frame to frame acceleration of the raw joints
+	float jitter_mm;			//same for the output
+	uint32_t frames;			//frames filtered since reset
+};
+
+//Per joint smoothing of skeleton frames before they reach the robot
+//State is kept per body slot and joint and restarts when the slot changes tracking id , loses tracking or the clock jumps
+//Joints that are not tracked keep their last output (One-Euro) or are predicted (Kalman) until they come back
+class skeleton_filter
+{
+	public:
+
+		skeleton_filter();
+
+		void set_params(const filter_params& params);	//changing the kind restarts every joint
+		const filter_params& get_params() const;
+
+		void reset();
+
+		//filter frame in place , frames must come in order
+		void filter(skeleton_frame& frame);
+
+		const filter_stats& get_stats() const;
+
+		static const char* get_kind_name(int kind);
+
+	private:
+
+		struct joint_state {
+			bool valid;
+			vec3 x;				//filtered position (m)
+			vec3 dx;			//One-Euro: filtered speed , Kalman: velocity estimate (m/s)
+			float p[3];			//Kalman covariance (p00 , p01 , p11) shared by the three axes
+			float lost;			//seconds since the joint was last measured
+
+			//history for the stats
+			vec3 raw[2];
+			vec3 out[2];
+			int history;
+		};
+
+		struct body_state {
+			bool tracked;
+			uint32_t id;
+			joint_state joints[SKEL_JOINT_COUNT];
+		};
+
+		filter_params params;
+		body_state bodies[SKEL_BODY_COUNT];
+		double last_time;
+		bool has_time;
+
+		//running sums behind filter_stats
+		double lag_num, lag_den;
+		double raw_jitter_sum, jitter_sum, jitter_weight;
+		filter_stats stats;
+
+		void one_euro(joint_state& s, vec3 z, float dt, float weight);
+		void kalman(joint_state& s, vec3 z, float dt, float weight, bool measured);
+		void measure(joint_state& s, vec3 raw, float dt);
+};
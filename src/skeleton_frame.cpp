@@ -0,0 +1,77 @@
+#include "skeleton_frame.h"
+
+//same bones the app always drew, torso then arms then legs
+const int SKEL_BONES[SKEL_BONE_COUNT][2] = {
+    { SKEL_HEAD, SKEL_SHOULDER_CENTER },
+    { SKEL_SHOULDER_CENTER, SKEL_SHOULDER_LEFT },
+    { SKEL_SHOULDER_CENTER, SKEL_SHOULDER_RIGHT },
+    { SKEL_SHOULDER_CENTER, SKEL_SPINE },
+    { SKEL_SPINE, SKEL_HIP_CENTER },
+    { SKEL_HIP_CENTER, SKEL_HIP_LEFT },
+    { SKEL_HIP_CENTER, SKEL_HIP_RIGHT },
+
+    { SKEL_SHOULDER_LEFT, SKEL_ELBOW_LEFT },
+    { SKEL_ELBOW_LEFT, SKEL_WRIST_LEFT },
+    { SKEL_WRIST_LEFT, SKEL_HAND_LEFT },
+
+    { SKEL_SHOULDER_RIGHT, SKEL_ELBOW_RIGHT },
+    { SKEL_ELBOW_RIGHT, SKEL_WRIST_RIGHT },
+    { SKEL_WRIST_RIGHT, SKEL_HAND_RIGHT },
+
+    { SKEL_HIP_LEFT, SKEL_KNEE_LEFT },
+    { SKEL_KNEE_LEFT, SKEL_ANKLE_LEFT },
+    { SKEL_ANKLE_LEFT, SKEL_FOOT_LEFT },
+
+    { SKEL_HIP_RIGHT, SKEL_KNEE_RIGHT },
+    { SKEL_KNEE_RIGHT, SKEL_ANKLE_RIGHT },
+    { SKEL_ANKLE_RIGHT, SKEL_FOOT_RIGHT }
+};
+
+skeleton_frame::skeleton_frame() {
+    time = 0;
+    timestamp = 0;
+    number = 0;
+    floor = vec4(0);
+
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        bodies[b].tracked = false;
+        bodies[b].id = 0;
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+            bodies[b].joints[j] = vec3(0);
+            bodies[b].state[j] = SKEL_NOT_TRACKED;
+        }
+    }
+}
+
+skeleton_pose::skeleton_pose() {
+    valid = false;
+    slot = -1;
+    id = 0;
+    time = 0;
+    timestamp = 0;
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        x[j] = y[j] = z[j] = 0;
+        state[j] = SKEL_NOT_TRACKED;
+    }
+    target = SKEL_HAND_LEFT;
+}
+
+void parse_pose(const skeleton_frame& frame, int slot, int target, skeleton_pose& pose)
+{
+    const skeleton_body* body = slot >= 0 && slot < SKEL_BODY_COUNT && frame.bodies[slot].tracked ? &frame.bodies[slot] : NULL;
+
+    pose.time = frame.time;
+    pose.timestamp = frame.timestamp;
+    pose.target = target;
+    pose.valid = body != NULL;
+    if (!body) return;
+
+    pose.slot = slot;
+    pose.id = body->id;
+    for (int j = 0; j < SKEL_JOINT_COUNT; j++) {
+        pose.x[j] = body->joints[j].x;
+        pose.y[j] = body->joints[j].y;
+        pose.z[j] = body->joints[j].z;
+        pose.state[j] = body->state[j];
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+
+using namespace ci;
+
+//Sensor independent skeleton frame, everything past the skeleton source works on this instead of NUI_SKELETON_FRAME
+//Joint order and state values match NUI_SKELETON_POSITION_INDEX / NUI_SKELETON_POSITION_TRACKING_STATE so the
+//Kinect backend can copy them straight across
+//Note: positions are in the sensor frame, meters (x left , y up , z away from the sensor)
+
+#define SKEL_JOINT_COUNT 20
+#define SKEL_BODY_COUNT 6
+
+enum skel_joint {
+	SKEL_HIP_CENTER = 0,
+	SKEL_SPINE,
+	SKEL_SHOULDER_CENTER,
+	SKEL_HEAD,
+	SKEL_SHOULDER_LEFT,
+	SKEL_ELBOW_LEFT,
+	SKEL_WRIST_LEFT,
+	SKEL_HAND_LEFT,
+	SKEL_SHOULDER_RIGHT,
+	SKEL_ELBOW_RIGHT,
+	SKEL_WRIST_RIGHT,
+	SKEL_HAND_RIGHT,
+	SKEL_HIP_LEFT,
+	SKEL_KNEE_LEFT,
+	SKEL_ANKLE_LEFT,
+	SKEL_FOOT_LEFT,
+	SKEL_HIP_RIGHT,
+	SKEL_KNEE_RIGHT,
+	SKEL_ANKLE_RIGHT,
+	SKEL_FOOT_RIGHT
+};
+
+enum skel_joint_state {
+	SKEL_NOT_TRACKED = 0,
+	SKEL_INFERRED,
+	SKEL_TRACKED
+};
+
+struct skeleton_body {
+	bool tracked;							//full skeleton available (position only bodies are left untracked)
+	uint32_t id;							//sensor tracking id, 0 if none
+	vec3 joints[SKEL_JOINT_COUNT];
+	uint8_t state[SKEL_JOINT_COUNT];		//skel_joint_state per joint
+};
+
+struct skeleton_frame {
+	double time;				//local time the frame was received (seconds, clock of the source)
+	int64_t timestamp;			//sensor timestamp (milliseconds since the sensor started), 0 if the source has none
+	uint32_t number;			//sensor frame number
+	vec4 floor;					//floor clip plane (a , b , c , d), zero if unknown
+	skeleton_body bodies[SKEL_BODY_COUNT];
+
+	skeleton_frame();
+};
+
+//The one body the app follows, parsed once per frame for every consumer (rendering, displacement, origin capture)
+//Joints are stored as separate x , y , z arrays (16 byte aligned) so whole-skeleton passes (see joint_transform)
+//run over contiguous floats , parse_pose fills them in meters and the pipeline maps them to robot axes in cm
+struct skeleton_pose {
+	bool valid;								//a body was selected
+	int slot;								//its index in skeleton_frame::bodies
+	uint32_t id;							//its tracking id
+	double time;
+	int64_t timestamp;
+
+	alignas(16) float x[SKEL_JOINT_COUNT];
+	alignas(16) float y[SKEL_JOINT_COUNT];
+	alignas(16) float z[SKEL_JOINT_COUNT];
+	uint8_t state[SKEL_JOINT_COUNT];		//skel_joint_state per joint
+
+	int target;								//selected tracking target joint (skel_joint)
+
+	skeleton_pose();
+
+	vec3 joint(int j) const { return vec3(x[j], y[j], z[j]); }
+	vec3 target_pos() const { return joint(target); }
+	int target_state() const { return state[target]; }
+};
+
+//copy the body in slot into pose (someone else chose it , see body_tracker) , invalid if slot is -1 or not tracked
+void parse_pose(const skeleton_frame& frame, int slot, int target, skeleton_pose& pose);
+
+//bone list used to draw a body (pairs of skel_joint)
+#define SKEL_BONE_COUNT 19
+extern const int SKEL_BONES[SKEL_BONE_COUNT][2];
@@ -0,0 +1,387 @@
+#include "skeleton_recording.h"
+
+#include <chrono>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//file header
+static const char SKEL_REC_MAGIC[4] = { 'K', 'X', 'S', 'K' };
+
+//frames the writer may fall behind by (about 8 seconds at 30 fps)
+#define REC_RING_SIZE 256
+
+//writer thread sleeps this long when there is nothing to write (milliseconds)
+#define REC_IDLE_MS 5
+
+//flush to disk this often so a crash loses at most this many frames
+#define REC_FLUSH_FRAMES 30
+
+//records are skeleton_frame as laid out in memory, keep them 8 byte aligned in the file so a mapping can be read in place
+static_assert(sizeof(skel_rec_header) == 64, "recording header must stay 64 bytes");
+static_assert(sizeof(skel_rec_index) == 24, "recording index entry must stay 24 bytes");
+static_assert(sizeof(skeleton_frame) % 8 == 0, "recording records must stay 8 byte aligned");
+
+recording_writer::recording_writer() : ring(REC_RING_SIZE) {
+    file = NULL;
+    running = false;
+    written = 0;
+    dropped = 0;
+    start_time = 0;
+}
+
+recording_writer::~recording_writer() {
+    stop();
+}
+
+bool recording_writer::start(const string& path)
+{
+    stop();
+
+    this->path = path;
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "Could not create " + path;
+        return false;
+    }
+
+    //placeholder header, count and index are filled in when the file is closed
+    skel_rec_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SKEL_REC_MAGIC, sizeof(header.magic));
+    header.version = SKEL_REC_VERSION;
+    header.header_size = sizeof(skel_rec_header);
+    header.record_size = sizeof(skeleton_frame);
+    fwrite(&header, sizeof(header), 1, file);
+
+    error = "";
+    written = 0;
+    dropped = 0;
+    index.clear();
+
+    running = true;
+    thread = std::thread(&recording_writer::run, this);
+    return true;
+}
+
+void recording_writer::stop()
+{
+    running = false;
+    if (thread.joinable()) thread.join();
+    if (file) finish();
+}
+
+bool recording_writer::push(const skeleton_frame& frame, bool wait)
+{
+    if (!running) return false;
+    if (wait) {
+        ring.pushFront(frame);
+        return true;
+    }
+    if (ring.tryPushFront(frame)) return true;
+    dropped++;
+    return false;
+}
+
+bool recording_writer::is_recording() const
+{
+    return running;
+}
+
+string recording_writer::get_path() const
+{
+    return path;
+}
+
+string recording_writer::get_error() const
+{
+    return error;
+}
+
+uint64_t recording_writer::get_written() const
+{
+    return written;
+}
+
+uint32_t recording_writer::get_dropped() const
+{
+    return dropped;
+}
+
+void recording_writer::run()
+{
+    skeleton_frame frame;
+
+    //keep draining after stop so every accepted frame lands in the file
+    while (true) {
+        if (ring.tryPopBack(&frame)) {
+            write_frame(frame);
+            continue;
+        }
+        if (!running) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(REC_IDLE_MS));
+    }
+}
+
+void recording_writer::write_frame(const skeleton_frame& frame)
+{
+    if (index.empty()) start_time = frame.time;
+
+    //copy member by member into a zeroed record so the struct padding goes to disk as zeros , not stack garbage
+    skeleton_frame record;
+    memset((void*)&record, 0, sizeof(record));
+    record.time = frame.time;
+    record.timestamp = frame.timestamp;
+    record.number = frame.number;
+    record.floor = frame.floor;
+    for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+        record.bodies[b].tracked = frame.bodies[b].tracked;
+        record.bodies[b].id = frame.bodies[b].id;
+        for (int j = 0; j < SKEL_JOINT_COUNT; j++) record.bodies[b].joints[j] = frame.bodies[b].joints[j];
+        memcpy(record.bodies[b].state, frame.bodies[b].state, sizeof(record.bodies[b].state));
+    }
+    fwrite(&record, sizeof(record), 1, file);
+
+    skel_rec_index entry;
+    entry.time = frame.time;
+    entry.timestamp = frame.timestamp;
+    entry.number = frame.number;
+    entry.reserved = 0;
+    index.push_back(entry);
+
+    written++;
+    if (written % REC_FLUSH_FRAMES == 0) fflush(file);
+}
+
+void recording_writer::finish()
+{
+    //index right after the last record
+    uint64_t index_offset = sizeof(skel_rec_header) + index.size() * (uint64_t)sizeof(skeleton_frame);
+    if (!index.empty()) fwrite(index.data(), sizeof(skel_rec_index), index.size(), file);
+
+    skel_rec_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SKEL_REC_MAGIC, sizeof(header.magic));
+    header.version = SKEL_REC_VERSION;
+    header.header_size = sizeof(skel_rec_header);
+    header.record_size = sizeof(skeleton_frame);
+    header.frame_count = index.size();
+    header.index_offset = index.empty() ? 0 : index_offset;
+    header.start_time = start_time;
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    if (ferror(file)) error = "Write error on " + path;
+
+    fclose(file);
+    file = NULL;
+    index.clear();
+}
+
+recording_reader::recording_reader() {
+    data = NULL;
+    size = 0;
+    file_handle = NULL;
+    map_handle = NULL;
+    fd = -1;
+    header = NULL;
+    records = NULL;
+    index = NULL;
+    count = 0;
+}
+
+recording_reader::~recording_reader() {
+    close();
+}
+
+bool recording_reader::open(const string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "Could not open " + path;
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    size = (size_t)file_size.QuadPart;
+    file_handle = file;
+
+    if (size > 0) {
+        map_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map_handle) data = (const uint8_t*)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Could not open " + path;
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size = (size_t)st.st_size;
+
+    if (size > 0) {
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) data = (const uint8_t*)map;
+    }
+#endif
+
+    if (!data) {
+        error = "Could not map " + path;
+        close();
+        return false;
+    }
+
+    header = (const skel_rec_header*)data;
+    if (size < sizeof(skel_rec_header) || memcmp(header->magic, SKEL_REC_MAGIC, sizeof(header->magic)) != 0
+        || header->version != SKEL_REC_VERSION) {
+        error = path + " is not a skeleton recording";
+        close();
+        return false;
+    }
+    if (header->record_size != sizeof(skeleton_frame) || header->header_size % 8 != 0) {
+        error = path + " was recorded by an incompatible build";
+        close();
+        return false;
+    }
+    if (header->header_size < sizeof(skel_rec_header) || header->header_size > size) {
+        error = path + " is truncated";
+        close();
+        return false;
+    }
+
+    records = (const skeleton_frame*)(data + header->header_size);
+    size_t max_count = (size - header->header_size) / header->record_size;
+
+    //closed recordings carry their count and index , otherwise take every complete record in the file
+    //the index has to sit after the last record and fit in the file , counts are checked before multiplying
+    if (header->index_offset) {
+        uint64_t frame_count = header->frame_count;
+        uint64_t index_offset = header->index_offset;
+        bool fits = frame_count <= max_count
+            && index_offset % 8 == 0
+            && index_offset >= header->header_size + frame_count * header->record_size
+            && index_offset <= size
+            && frame_count <= (size - index_offset) / sizeof(skel_rec_index);
+        if (!fits) {
+            error = path + " is truncated";
+            close();
+            return false;
+        }
+        count = (size_t)frame_count;
+        index = (const skel_rec_index*)(data + index_offset);
+    }
+    else count = max_count;
+
+    error = "";
+    return true;
+}
+
+void recording_reader::close()
+{
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (map_handle) CloseHandle((HANDLE)map_handle);
+    if (file_handle) CloseHandle((HANDLE)file_handle);
+#else
+    if (data) munmap((void*)data, size);
+    if (fd >= 0) ::close(fd);
+#endif
+
+    data = NULL;
+    size = 0;
+    file_handle = NULL;
+    map_handle = NULL;
+    fd = -1;
+    header = NULL;
+    records = NULL;
+    index = NULL;
+    count = 0;
+}
+
+bool recording_reader::is_open() const
+{
+    return data != NULL;
+}
+
+bool recording_reader::has_index() const
+{
+    return index != NULL;
+}
+
+size_t recording_reader::get_count() const
+{
+    return count;
+}
+
+const skeleton_frame& recording_reader::get_frame(size_t i) const
+{
+    return records[i];
+}
+
+double recording_reader::time_at(size_t i) const
+{
+    return index ? index[i].time : records[i].time;
+}
+
+uint32_t recording_reader::number_at(size_t i) const
+{
+    return index ? index[i].number : records[i].number;
+}
+
+size_t recording_reader::find_time(double t) const
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (time_at(mid) < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+size_t recording_reader::find_number(uint32_t number) const
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (number_at(mid) < number) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+double recording_reader::get_start_time() const
+{
+    return count ? time_at(0) : 0;
+}
+
+double recording_reader::get_end_time() const
+{
+    return count ? time_at(count - 1) : 0;
+}
+
+string recording_reader::get_error() const
+{
+    return error;
+}
+
+bool recording_reader::is_recording(const string& path)
+{
+    char magic[4] = { 0 };
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return n == sizeof(magic) && memcmp(magic, SKEL_REC_MAGIC, sizeof(magic)) == 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "cinder/ConcurrentCircularBuffer.h"
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "skeleton_frame.h"
+
+using namespace ci;
+using namespace std;
+
+//Binary skeleton recording (.kxr)
+//  header (64 bytes) | fixed size records , one skeleton_frame each , stored as is | index
+//Records are skeleton_frame written straight from memory, so a mapped file can be read in place without parsing
+//The index holds (time , timestamp , number) per record in a dense array for O(log n) seeks by time or frame number
+//A recording that was never closed (crash , power loss) has no index, readers then count records from the file size
+//and search the records themselves
+
+#define SKEL_REC_VERSION 1
+
+struct skel_rec_header {
+	char magic[4];			//"KXSK"
+	uint32_t version;
+	uint32_t header_size;	//offset of the first record
+	uint32_t record_size;	//sizeof(skeleton_frame) of the writer, must match the reader
+	uint64_t frame_count;	//0 until the writer closes the file
+	uint64_t index_offset;	//0 until the writer closes the file
+	double start_time;		//time of the first frame
+	uint8_t reserved[24];
+};
+
+struct skel_rec_index {
+	double time;
+	int64_t timestamp;
+	uint32_t number;
+	uint32_t reserved;
+};
+
+//Records frames on a background thread, push never blocks the caller
+class recording_writer
+{
+	public:
+
+		recording_writer();
+		~recording_writer();
+
+		bool start(const string& path);		//creates the file and the writer thread
+		void stop();						//flushes everything queued, writes the index and closes the file
+
+		//queue a frame for writing, returns false (and counts it as dropped) if the writer fell behind
+		//wait blocks until there is room instead, for offline runs that produce frames faster than the disk takes them
+		bool push(const skeleton_frame& frame, bool wait = false);
+
+		bool is_recording() const;
+		string get_path() const;
+		string get_error() const;
+		uint64_t get_written() const;
+		uint32_t get_dropped() const;
+
+	private:
+
+		string path;
+		string error;
+		FILE* file;
+
+		ConcurrentCircularBuffer<skeleton_frame> ring;
+		std::thread thread;
+		std::atomic<bool> running;
+		std::atomic<uint64_t> written;
+		std::atomic<uint32_t> dropped;
+
+		vector<skel_rec_index> index;	//writer thread only
+		double start_time;
+
+		void run();
+		void write_frame(const skeleton_frame& frame);
+		void finish();
+};
+
+//Memory mapped reader, frames are returned as pointers into the mapping (no copy)
+class recording_reader
+{
+	public:
+
+		recording_reader();
+		~recording_reader();
+
+		bool open(const string& path);		//false if the file cannot be mapped or is not a compatible recording
+		void close();
+
+		bool is_open() const;
+		bool has_index() const;				//false for recordings that were never closed
+		size_t get_count() const;
+		const skeleton_frame& get_frame(size_t i) const;
+
+		//first record at or after time t / with frame number >= number (records are in order), get_count() if none
+		size_t find_time(double t) const;
+		size_t find_number(uint32_t number) const;
+
+		double get_start_time() const;		//time of the first record
+		double get_end_time() const;		//time of the last record
+		string get_error() const;
+
+		static bool is_recording(const string& path);	//true if path starts with the recording magic
+
+	private:
+
+		const uint8_t* data;
+		size_t size;
+		void* file_handle;
+		void* map_handle;
+		int fd;
+
+		const skel_rec_header* header;
+		const skeleton_frame* records;
+		const skel_rec_index* index;
+		size_t count;
+		string error;
+
+		double time_at(size_t i) const;
+		uint32_t number_at(size_t i) const;
+};
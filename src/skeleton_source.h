@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "skeleton_frame.h"
+
+using namespace std;
+
+//Where skeleton frames come from
+//The control loop only ever pops frames, so the same tracking pipeline runs on a live Kinect (kinect_capture),
+//a recorded file (replay_source) or generated motion (scripted_source), with or without a window
+class skeleton_source
+{
+	public:
+
+		virtual ~skeleton_source() {}
+
+		virtual bool start() = 0;						//returns false if the source could not be opened
+		virtual void stop() = 0;						//safe to call if never started
+
+		//next frame that is due, false if none is waiting
+		//frame.time is on the source clock (seconds since start for file and scripted sources)
+		virtual bool pop(skeleton_frame& frame) = 0;
+
+		virtual bool finished() const { return false; }	//no frame will ever come again (end of file or script)
+		virtual void set_seated(bool /*seated*/) {}			//only meaningful for a live sensor
+		virtual void set_sensor_smoothing(bool /*smoothing*/) {}	//the sensor's own smoothing, on top of the pipeline's joint filter
+
+		virtual const char* get_name() const = 0;
+		virtual uint32_t get_delivered() const = 0;		//frames handed out by pop
+		virtual uint32_t get_dropped() const { return 0; }	//frames lost before they could be popped
+		virtual string get_error() const { return ""; }	//why start failed
+};
@@ -0,0 +1,99 @@
+#include "target_predictor.h"
+#include "skeleton_frame.h"
+
+#include <algorithm>
+#include <math.h>
+
+//samples further apart than this (seconds) start the velocity estimate over
+static const double PREDICT_MAX_GAP = 0.5;
+
+//sensor timestamps are in milliseconds
+static const double PREDICT_TIMESTAMP_SCALE = 0.001;
+
+predict_params::predict_params() {
+    enabled = false;
+    auto_horizon = true;
+    horizon = 0.1f;
+    max_horizon = 0.25f;
+    sensor_latency = 0.06f;
+    inferred_scale = 0.0f;
+    max_lead = 10.0f;
+    smoothing = 0.5f;
+}
+
+target_predictor::target_predictor() {
+    reset();
+}
+
+void target_predictor::set_params(const predict_params& params)
+{
+    this->params = params;
+}
+
+const predict_params& target_predictor::get_params() const
+{
+    return params;
+}
+
+void target_predictor::reset()
+{
+    has_pos = false;
+    pos = vec3(0);
+    time = 0;
+    timestamp = 0;
+    state = SKEL_NOT_TRACKED;
+    vel = vec3(0);
+    lead = 0;
+}
+
+void target_predictor::add_sample(vec3 pos, double time, int64_t timestamp, int state)
+{
+    if (has_pos) {
+        //sensor spacing when the source has timestamps , arrival spacing otherwise
+        double dt = (timestamp - this->timestamp) * PREDICT_TIMESTAMP_SCALE;
+        if (dt <= 0) dt = time - this->time;
+
+        if (dt > 0 && dt <= PREDICT_MAX_GAP) vel = mix(vel, (pos - this->pos) / (float)dt, params.smoothing);
+        else vel = vec3(0);
+    }
+
+    has_pos = true;
+    this->pos = pos;
+    this->time = time;
+    this->timestamp = timestamp;
+    this->state = state;
+}
+
+vec3 target_predictor::predict(double time, float look_ahead)
+{
+    if (!has_pos) return vec3(0);
+
+    //time since the last sample (upsampling) plus the look ahead (latency compensation)
+    float ahead = (float)(time - this->time) + look_ahead;
+    ahead = std::min(std::max(ahead, 0.0f), params.max_horizon);
+
+    //inferred or lost joints are guesses already, extrapolating them only amplifies the error
+    if (state != SKEL_TRACKED) ahead *= params.inferred_scale;
+
+    vec3 delta = vel * ahead;
+    float len = length(delta);
+    if (len > params.max_lead) delta *= params.max_lead / len;
+
+    lead = length(delta);
+    return pos + delta;
+}
+
+bool target_predictor::has_sample() const
+{
+    return has_pos;
+}
+
+vec3 target_predictor::get_velocity() const
+{
+    return vel;
+}
+
+float target_predictor::get_lead() const
+{
+    return lead;
+}
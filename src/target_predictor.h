@@ -0,0 +1,58 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+
+using namespace ci;
+
+struct predict_params {
+	bool enabled;				//drive the robot from the predicted target instead of the last sample
+	bool auto_horizon;			//look ahead by the measured pipeline delay instead of horizon
+	float horizon;				//seconds to look ahead when auto_horizon is off
+	float max_horizon;			//never extrapolate further than this past the last sample (seconds)
+	float sensor_latency;		//capture to delivery delay of the sensor, not measurable from the host (seconds)
+	float inferred_scale;		//0..1 of the extrapolation kept while the joint is only inferred (0 holds the last sample)
+	float max_lead;				//cap on how far the prediction may run ahead of the last sample (cm)
+	float smoothing;			//0..1 weight of the newest velocity sample (exponential moving average)
+
+	predict_params();
+};
+
+//Latency compensation and upsampling of one tracked joint
+//Velocity comes from successive samples spaced by their sensor timestamps (less jitter than arrival times)
+//and the joint is extrapolated from the last sample to any later time , so a 30 Hz joint can be read at the control rate
+//Times are on the source clock (skeleton_frame::time) , the owner maps its own clock onto it
+class target_predictor
+{
+	public:
+
+		target_predictor();
+
+		void set_params(const predict_params& params);
+		const predict_params& get_params() const;
+
+		void reset();
+
+		//new sample of the joint (cm) , time on the source clock , timestamp from the sensor (ms) , skel_joint_state
+		void add_sample(vec3 pos, double time, int64_t timestamp, int state);
+
+		//joint position at time (source clock) plus look ahead , held closer to the last sample while the joint is inferred
+		vec3 predict(double time, float look_ahead);
+
+		bool has_sample() const;
+		vec3 get_velocity() const;		//cm/s
+		float get_lead() const;			//distance of the last prediction ahead of the last sample (cm)
+
+	private:
+
+		predict_params params;
+
+		bool has_pos;
+		vec3 pos;
+		double time;
+		int64_t timestamp;
+		int state;
+
+		vec3 vel;
+		float lead;
+};
@@ -0,0 +1,631 @@
+#include "tracking_pipeline.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+//loops to wait after a G1 before the next one in position mode
+static const int SEND_SPACING = 10;
+
+//weight of the newest sample in the frame age and G1 spacing averages
+static const float DELAY_SMOOTHING = 0.1f;
+
+//tool angle change (degrees) worth a new G1 on its own , the measured angle is snapped to this grid so the
+//robot only ever sees a few distinct tool angles instead of a new one every frame
+static const float TOOL_ANGLE_STEP = 2.0f;
+
+//weight of the newest hand angle in its running average , and how far (degrees) the average has to move off the
+//snapped angle before that follows , more than a step so sensor jitter around a grid line does not toggle it
+static const float TOOL_ANGLE_SMOOTHING = 0.3f;
+static const float TOOL_ANGLE_DEADBAND = 3.0f;
+
+//a pause in the G1 stream longer than this (seconds) is the operator standing still, not streaming delay
+static const double MAX_SEND_INTERVAL = 0.5;
+
+pipeline_params::pipeline_params() {
+    tracking_target = TRACK_HEAD;
+    person = 0;
+    apply_displacement = false;
+    displacement_mult = 1.0f;
+    home_point = vec3(420, 320, 0);
+
+    rr_mode = false;
+    rr_send_hz = 20.0f;
+
+    retarget_mode = false;
+
+    track_tool_angle = false;
+    tool_angle_offset = 0.0f;
+    tool_angle_range = vec2(-90.0f, 90.0f);
+
+    use_extrinsic = false;
+    extrinsic = mat4(1.0f);
+
+    max_displacement = 40.0f;
+    send_threshold = 2.0f;
+    g1_gain = vec3(4, 2, 2);
+
+    origin = ivec3(0, 320, 320);
+    apply_mvspeed = false;
+    mv_speed = 0;
+}
+
+tracking_pipeline::tracking_pipeline(robot_manipulator& robot) : robot(robot) {
+    set_params(params);
+
+    following = 0;
+    filter_lag = 0;
+
+    tool_arm = vec4(0);
+    tool_angle = 0;
+    tool_smooth = 0;
+    tool_measured = false;
+    tool_sent = 0;
+
+    faux_origin = vec3(0);
+    faux_origin_set = false;
+    displacement = vec3(0);
+    target = vec3(0);
+
+    clock_offset = 0;
+    has_clock = false;
+    frame_fresh = false;
+    frame_age = 0;
+    last_send = 0;
+    send_interval = 0;
+    delay = 0;
+    horizon = 0;
+
+    dest = vec4(params.home_point, 0);
+
+    x_temp_old = 0;
+    y_temp_old = 0;
+    z_temp_old = 0;
+    loops_since_send = 0;
+
+    ext_g1 = ivec3(0);
+    ext_sent = vec3(0);
+
+    rr_last_send = 0;
+    rr_last_g1 = vec3(0);
+
+    memset(gcode_buff, 0, sizeof(gcode_buff));
+    g1_target = vec3(0);
+    frame_cnt = 0;
+    sent_cnt = 0;
+}
+
+void tracking_pipeline::set_params(const pipeline_params& params)
+{
+    this->params = params;
+
+    sensor_map.set(params.sensor_map);
+
+    //G1 target = gain * displacement + initial robot position
+    mat4 g1(1.0f);
+    g1[0][0] = params.g1_gain.x;
+    g1[1][1] = params.g1_gain.y;
+    g1[2][2] = params.g1_gain.z;
+    g1[3] = vec4(vec3(params.origin), 1.0f);
+    g1_map.set_matrix(g1);
+
+    //calibrated map is from raw sensor joints , the pose it is applied to already went through sensor_map
+    target_map.set_matrix(params.extrinsic * inverse(sensor_map.get_matrix()));
+}
+
+const pipeline_params& tracking_pipeline::get_params() const
+{
+    return params;
+}
+
+bool tracking_pipeline::add_frame(const skeleton_frame& frame)
+{
+    //a repeated or late sensor frame must not move the displacement again
+    int verdict = monitor.add_frame(frame);
+    if (verdict == FRAME_DUPLICATE || verdict == FRAME_LATE) return false;
+
+    //source started over (new source , rewind , replay loop), the loop clock mapping and the motion history are stale
+    if (verdict == FRAME_RESTART) {
+        has_clock = false;
+        predictor.reset();
+    }
+
+    //cleanup and identities run over all six slots once , whichever arms follow them
+    this->frame = frame;
+    bones.apply(this->frame);
+    filter.filter(this->frame);
+    people.update(this->frame);
+    frame_cnt++;
+
+    track(people, filter.get_stats().lag_ms);
+    return true;
+}
+
+void tracking_pipeline::add_frame(const tracking_pipeline& lead)
+{
+    const skeleton_frame& cleaned = lead.get_frame();
+    if (frame_cnt > 0 && cleaned.time < frame.time) {
+        has_clock = false;
+        predictor.reset();
+    }
+
+    frame = cleaned;
+    frame_cnt++;
+    track(lead.people, lead.filter.get_stats().lag_ms);
+}
+
+void tracking_pipeline::track(const body_tracker& people, float lag_ms)
+{
+    filter_lag = lag_ms / 1000.0f;
+
+    //the person this arm follows: the one asked for , or whoever has been here longest and stays while only briefly lost
+    uint32_t person = params.person;
+    if (person == 0) person = people.is_known(following) ? following : people.get_first();
+    if (person != following) {
+        if (following != 0) predictor.reset();		//someone else's motion history
+        following = person;
+    }
+
+    //copy their body once and map all its joints to robot axes in one pass, every consumer reads the pose from here on
+    parse_pose(frame, people.find_slot(following), get_target_joint(params.tracking_target), pose);
+    if (!pose.valid) return;
+    sensor_map.apply(pose);
+
+    //tool angle from the same filtered pose as the position target
+    if (params.track_tool_angle && retarget.measure(pose, get_target_side(params.tracking_target), tool_arm)) {
+        float angle = glm::clamp(joint_retarget::get_tool_angle(tool_arm) + params.tool_angle_offset, params.tool_angle_range.x, params.tool_angle_range.y);
+        tool_smooth = tool_measured ? glm::mix(tool_smooth, angle, TOOL_ANGLE_SMOOTHING) : angle;
+        if (!tool_measured || fabsf(tool_smooth - tool_angle) > TOOL_ANGLE_DEADBAND) tool_angle = roundf(tool_smooth / TOOL_ANGLE_STEP) * TOOL_ANGLE_STEP;
+        tool_measured = true;
+    }
+
+    vec3 target_pos = pose.target_pos();
+    predictor.add_sample(target_pos, frame.time, frame.timestamp, pose.target_state());
+    target = target_pos;
+    frame_fresh = true;
+
+    //calculate and record displacement to be applied to robot
+    if (faux_origin_set && params.apply_displacement) displacement = target_pos - faux_origin;
+
+    //hand velocity for the velocity mode comes from successive frames (from the loop when predicting)
+    if (params.rr_mode && !predictor.get_params().enabled) rr.add_sample(displacement, frame.time);
+}
+
+bool tracking_pipeline::set_faux_origin(double now)
+{
+    if (!pose.valid) return false;
+
+    faux_origin = pose.target_pos();
+    faux_origin_set = true;
+
+    //joint space mode is zeroed at the same moment
+    start_retarget(now);
+    return true;
+}
+
+void tracking_pipeline::update(double now)
+{
+    //map the loop clock onto the source clock, the first loop after a frame tells how long it waited
+    if (frame_fresh) {
+        double age = now - frame.time;
+        if (!has_clock || age < clock_offset) {
+            clock_offset = age;
+            has_clock = true;
+        }
+        frame_age = glm::mix(frame_age, (float)(age - clock_offset), DELAY_SMOOTHING);
+        monitor.add_age((float)(age - clock_offset));
+        frame_fresh = false;
+    }
+
+    //capture to robot delay: what the sensor , the joint filter , the loop and the G1 spacing each add
+    const predict_params& predict = predictor.get_params();
+    delay = predict.sensor_latency + filter_lag + frame_age + send_interval / 2.0f;
+    horizon = predict.auto_horizon ? delay : predict.horizon;
+
+    //upsample the tracked joint to this loop and run it ahead by the delay
+    if (predict.enabled && has_clock && predictor.has_sample() && (faux_origin_set || params.use_extrinsic) && params.apply_displacement) {
+        double source_now = now - clock_offset;
+        target = predictor.predict(source_now, horizon);
+        if (faux_origin_set) {
+            displacement = target - faux_origin;
+            if (params.rr_mode) rr.add_sample(displacement, source_now);
+        }
+    }
+
+    //tool angle follows the operator's hand while the displacement is applied
+    if (params.apply_displacement && params.track_tool_angle) dest.w = tool_angle;
+
+    if (params.retarget_mode) {
+        //operator's arm angles straight onto the joints, no IK solve and no reach limit
+        //the model stays inside the safe box the G1 lines are clamped to , so the robot never waits at the box while
+        //the model wanders off and jumps when it comes back
+        if (params.apply_displacement && retarget.has_neutral()) {
+            vec4 angles = retarget.apply(pose, get_target_side(params.tracking_target), now);
+            if (keep_in_box(angles)) retarget.set_output(angles);
+            robot.set_angles(angles);
+        }
+        return;
+    }
+
+    if (params.rr_mode) {
+        //integrate joint velocities at the fixed control rate, no IK solve per skeleton sample
+        vec4 lens = robot.get_limb_lens();
+        rr.update(now, vec3(lens), dest.w);
+        vec4 angles = rr.get_angles();
+        if (keep_in_box(angles)) rr.set_angles(angles);
+        robot.set_angles(angles);
+        return;
+    }
+
+    if (params.use_extrinsic && params.apply_displacement) {
+        //calibrated position mode: the model takes the joint angles the firmware will solve for the G1 target ,
+        //tilted to the requested tool angle (the firmware tool is level)
+        if (predictor.has_sample()) {
+            ext_g1 = clamp_g1(target_map.apply(target));
+            kxr::FirmwareJoints joints;
+            if (robot.predict_firmware(vec3(ext_g1), joints)) {
+                float angles[4];
+                kxr::firmwareToHostAngles(joints, angles);
+                robot.set_angles(vec4(angles[0], angles[1], angles[2] + dest.w, angles[3]));
+            }
+        }
+        return;
+    }
+
+    //if apply displacement flag is set then update robot using displacement vector
+    if (params.apply_displacement) dest = vec4(vec3(params.displacement_mult) * (params.home_point + displacement), params.track_tool_angle ? tool_angle : 0);
+
+    //update robot arm destination
+    robot.set_dest(dest);
+}
+
+bool tracking_pipeline::stream(double now)
+{
+    bool send = false;
+
+    if (params.rr_mode || params.retarget_mode) {
+        //velocity and joint space modes: stream the model pose, G1 from FK so the firmware reproduces the same joint angles
+        //(update already kept the model inside the safe box , the clamp only rounds) , sent as soon as it moved and the
+        //G1 rate allows instead of every SEND_SPACING loops
+        ivec3 g1 = clamp_g1(robot.get_firmware_target());
+        int x_dest = g1.x;
+        int y_dest = g1.y;
+        int z_dest = g1.z;
+        g1_target = vec3(g1);
+
+        if (params.apply_mvspeed) snprintf(gcode_buff, sizeof(gcode_buff), "G1X%dY%dZ%dF%d", x_dest, y_dest, z_dest, params.mv_speed);
+        else snprintf(gcode_buff, sizeof(gcode_buff), "G1X%dY%dZ%d", x_dest, y_dest, z_dest);
+
+        float tool = joint_retarget::get_tool_angle(robot.get_angles());
+        bool tool_moved = false;
+        if (params.track_tool_angle) {
+            add_tool_word(tool);
+            tool_moved = fabsf(tool - tool_sent) >= TOOL_ANGLE_STEP;
+        }
+
+        if (now - rr_last_send >= 1.0 / params.rr_send_hz && (distance(g1_target, rr_last_g1) >= 1.0f || tool_moved)) {
+            if (params.track_tool_angle) tool_sent = tool;
+            rr_last_send = now;
+            rr_last_g1 = g1_target;
+            send = true;
+        }
+    }
+    else if (params.use_extrinsic) {
+        //calibrated position mode: G1 target from the last update , sent once the tracked target moved send_threshold
+        g1_target = vec3(ext_g1);
+        if (params.apply_mvspeed) snprintf(gcode_buff, sizeof(gcode_buff), "G1X%dY%dZ%dF%d", ext_g1.x, ext_g1.y, ext_g1.z, params.mv_speed);
+        else snprintf(gcode_buff, sizeof(gcode_buff), "G1X%dY%dZ%d", ext_g1.x, ext_g1.y, ext_g1.z);
+
+        bool tool_moved = false;
+        if (params.track_tool_angle) {
+            tool_moved = fabsf(tool_angle - tool_sent) >= TOOL_ANGLE_STEP;
+            add_tool_word(tool_angle);
+        }
+
+        bool moved = distance(target, ext_sent) >= params.send_threshold || tool_moved;
+        if (params.apply_displacement && predictor.has_sample() && moved && loops_since_send == 0) {
+            loops_since_send = SEND_SPACING;
+            ext_sent = target;
+            tool_sent = tool_angle;
+            send = true;
+        }
+
+        if (loops_since_send > 0) loops_since_send -= 1;
+    }
+    else {
+        //Int to track how many coordinate values have changed
+        int coordinates_changed = 0;
+
+        //Only record displacement if (smoothing is done by the joint filter before this):
+        //----displacement is less than max_displacement units long
+        //----new displacement has a delta of atleast send_threshold from the previous displacement value
+        float limit = params.max_displacement;
+        float threshold = params.send_threshold;
+        if ((displacement.x < limit && displacement.x > -limit) &&
+            ((displacement.x >= x_temp_old + threshold) || (displacement.x <= x_temp_old - threshold))) {
+            x_temp_old = params.displacement_mult * displacement.x;
+            coordinates_changed++;
+        }
+
+        if ((displacement.y < limit && displacement.y > -limit) &&
+            ((displacement.y >= y_temp_old + threshold) || (displacement.y <= y_temp_old - threshold))) {
+            y_temp_old = params.displacement_mult * displacement.y;
+            coordinates_changed++;
+        }
+
+        if ((displacement.z < limit && displacement.z > -limit) &&
+            ((displacement.z >= z_temp_old + threshold) || (displacement.z <= z_temp_old - threshold))) {
+            z_temp_old = params.displacement_mult * displacement.z;
+            coordinates_changed++;
+        }
+
+        //the tool angle only counts as sent once a line with it actually goes out
+        if (params.track_tool_angle && params.apply_displacement && fabsf(tool_angle - tool_sent) >= TOOL_ANGLE_STEP) coordinates_changed++;
+
+        //Adding displacement to current home position (multiplying displacement with a constant), kept inside the safe box
+        ivec3 g1 = clamp_g1(g1_map.apply(vec3(x_temp_old, y_temp_old, z_temp_old)));
+        int x_dest = g1.x;
+        int y_dest = g1.y;
+        int z_dest = g1.z;
+
+        g1_target = vec3(x_dest, y_dest, z_dest);
+
+        //Apply base speed
+        if (params.apply_mvspeed) snprintf(gcode_buff, sizeof(gcode_buff), "G1X%dY%dZ%dF%d", x_dest, y_dest, z_dest, params.mv_speed);
+        else snprintf(gcode_buff, sizeof(gcode_buff), "G1X%dY%dZ%d", x_dest, y_dest, z_dest);
+        float tool = params.apply_displacement ? tool_angle : tool_sent;
+        if (params.track_tool_angle) add_tool_word(tool);
+
+        //send if more than 1 coordinate has been updated, after sending set a timer
+        if (coordinates_changed >= 1 && loops_since_send == 0) {
+            loops_since_send = SEND_SPACING;
+            tool_sent = tool;
+            send = true;
+        }
+
+        //decriment timer till next viable gcode send
+        if (loops_since_send > 0) loops_since_send -= 1;
+        else loops_since_send = 0;
+    }
+
+    if (send) {
+        if (sent_cnt > 0) send_interval = glm::mix(send_interval, (float)std::min(now - last_send, MAX_SEND_INTERVAL), DELAY_SMOOTHING);
+        last_send = now;
+        sent_cnt++;
+    }
+    return send;
+}
+
+ivec3 tracking_pipeline::clamp_g1(vec3 g1)
+{
+    int x_dest = (int)round(g1.x);
+    int y_dest = (int)round(g1.y);
+    int z_dest = (int)round(g1.z);
+
+    //--------Coordinate edge cases-----
+    //safe box around the initial position from the workspace map (old hand tuned box if the map has none)
+    vec3 box_min = vec3(-300, 250, 100);
+    vec3 box_max = vec3(300, 500, 320);
+    robot.get_safe_box(vec3(params.origin), box_min, box_max);
+
+    //the firmware base only turns +-90 degrees off its y axis , a target behind it (y < 0) comes out mirrored
+    box_min.y = std::max(box_min.y, 0.0f);
+    x_dest = glm::clamp(x_dest, (int)ceil(box_min.x), (int)floor(box_max.x));
+    y_dest = glm::clamp(y_dest, (int)ceil(box_min.y), (int)floor(box_max.y));
+    z_dest = glm::clamp(z_dest, (int)ceil(box_min.z), (int)floor(box_max.z));
+    return ivec3(x_dest, y_dest, z_dest);
+}
+
+void tracking_pipeline::add_tool_word(float tool)
+{
+    //A word after the position , firmware without a wrist axis skips letters it does not know
+    size_t len = strlen(gcode_buff);
+    snprintf(gcode_buff + len, sizeof(gcode_buff) - len, "A%d", (int)round(tool));
+}
+
+void tracking_pipeline::set_dest(vec4 dest)
+{
+    this->dest = dest;
+}
+
+vec4 tracking_pipeline::get_dest() const
+{
+    return dest;
+}
+
+void tracking_pipeline::start_rr(double now)
+{
+    home_to_origin();
+    rr.reset(robot.get_angles(), now);
+}
+
+bool tracking_pipeline::start_retarget(double now)
+{
+    home_to_origin();
+    return retarget.set_neutral(pose, get_target_side(params.tracking_target), robot.get_angles(), now);
+}
+
+void tracking_pipeline::home_to_origin()
+{
+    //joint angles the firmware solves for the real robot's initial position , the model pose of the first G1
+    kxr::FirmwareJoints joints;
+    if (!robot.predict_firmware(vec3(params.origin), joints)) return;
+
+    float angles[4];
+    kxr::firmwareToHostAngles(joints, angles);
+    robot.set_angles(vec4(angles[0], angles[1], angles[2], angles[3]));
+}
+
+bool tracking_pipeline::keep_in_box(vec4& angles)
+{
+    robot.set_angles(angles);
+    vec3 fw = robot.get_firmware_target();
+    ivec3 g1 = clamp_g1(fw);
+    if (g1 == ivec3(round(fw))) return false;
+
+    //pose the firmware solves for the clamped target , tilted back to the model's tool angle (the firmware tool is level)
+    kxr::FirmwareJoints joints;
+    if (!robot.predict_firmware(vec3(g1), joints)) return false;
+
+    float host[4];
+    kxr::firmwareToHostAngles(joints, host);
+    angles = vec4(host[0], host[1], host[2] + angles.x + angles.y + angles.z, host[3]);
+    return true;
+}
+
+const skeleton_frame& tracking_pipeline::get_frame() const
+{
+    return frame;
+}
+
+const skeleton_pose& tracking_pipeline::get_pose() const
+{
+    return pose;
+}
+
+vec3 tracking_pipeline::get_displacement() const
+{
+    return displacement;
+}
+
+vec3 tracking_pipeline::get_faux_origin() const
+{
+    return faux_origin;
+}
+
+bool tracking_pipeline::is_faux_origin_set() const
+{
+    return faux_origin_set;
+}
+
+vec3 tracking_pipeline::get_target_pos() const
+{
+    return pose.target_pos();
+}
+
+vec3 tracking_pipeline::get_sensor_target() const
+{
+    return vec3(inverse(sensor_map.get_matrix()) * vec4(pose.target_pos(), 1.0f));
+}
+
+float tracking_pipeline::get_tool_angle() const
+{
+    return tool_angle;
+}
+
+bool tracking_pipeline::has_target() const
+{
+    return pose.valid;
+}
+
+const char* tracking_pipeline::get_gcode() const
+{
+    return gcode_buff;
+}
+
+vec3 tracking_pipeline::get_g1_target() const
+{
+    return g1_target;
+}
+
+uint32_t tracking_pipeline::get_frame_count() const
+{
+    return frame_cnt;
+}
+
+uint32_t tracking_pipeline::get_sent_count() const
+{
+    return sent_cnt;
+}
+
+rr_teleop& tracking_pipeline::get_rr()
+{
+    return rr;
+}
+
+joint_retarget& tracking_pipeline::get_retarget()
+{
+    return retarget;
+}
+
+frame_monitor& tracking_pipeline::get_monitor()
+{
+    return monitor;
+}
+
+body_tracker& tracking_pipeline::get_people()
+{
+    return people;
+}
+
+uint32_t tracking_pipeline::get_following() const
+{
+    return following;
+}
+
+skeleton_filter& tracking_pipeline::get_filter()
+{
+    return filter;
+}
+
+bone_constraint& tracking_pipeline::get_bones()
+{
+    return bones;
+}
+
+target_predictor& tracking_pipeline::get_predictor()
+{
+    return predictor;
+}
+
+float tracking_pipeline::get_delay() const
+{
+    return delay;
+}
+
+float tracking_pipeline::get_horizon() const
+{
+    return horizon;
+}
+
+const char* tracking_pipeline::get_target_name(int target)
+{
+    switch (target) {
+        case TRACK_HEAD:
+            return "Head";
+        case TRACK_HAND_LEFT:
+            return "Left hand";
+        case TRACK_HAND_RIGHT:
+            return "Right hand";
+        case TRACK_FOOT_LEFT:
+            return "Left foot";
+        case TRACK_FOOT_RIGHT:
+            return "Right foot";
+        default:
+            return "Left hand";
+    }
+}
+
+int tracking_pipeline::get_target_joint(int target)
+{
+    switch (target) {
+        case TRACK_HEAD:
+            return SKEL_HEAD;
+        case TRACK_HAND_LEFT:
+            return SKEL_HAND_LEFT;
+        case TRACK_HAND_RIGHT:
+            return SKEL_HAND_RIGHT;
+        case TRACK_FOOT_LEFT:
+            return SKEL_FOOT_LEFT;
+        case TRACK_FOOT_RIGHT:
+            return SKEL_FOOT_RIGHT;
+        default:
+            return SKEL_HAND_LEFT;
+    }
+}
+
+int tracking_pipeline::get_target_side(int target)
+{
+    return target == TRACK_HAND_RIGHT ? RETARGET_RIGHT : RETARGET_LEFT;
+}
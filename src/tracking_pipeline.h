@@ -0,0 +1,204 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+
+#include "body_tracker.h"
+#include "bone_constraint.h"
+#include "frame_monitor.h"
+#include "joint_retarget.h"
+#include "joint_transform.h"
+#include "robot_manipulator.h"
+#include "rr_teleop.h"
+#include "skeleton_filter.h"
+#include "skeleton_frame.h"
+#include "target_predictor.h"
+
+using namespace ci;
+
+//body parts that can drive the robot, order of the "Tracking target" combo
+enum tracking_target_index {
+	TRACK_HEAD = 0,
+	TRACK_HAND_LEFT,
+	TRACK_HAND_RIGHT,
+	TRACK_FOOT_LEFT,
+	TRACK_FOOT_RIGHT,
+	TRACK_TARGET_COUNT
+};
+
+struct pipeline_params {
+	int tracking_target;		//tracking_target_index
+	uint32_t person;			//body_tracker person this arm follows , 0 follows whoever has been in view longest
+	bool apply_displacement;	//drive the robot from the displacement vector
+	float displacement_mult;	//scalar multiplier to change sensitivity of displacement vector
+	vec3 home_point;			//model end effector position the displacement is added to (mm)
+
+	bool rr_mode;				//drive joints from hand velocity instead of solving IK for the displaced target
+	float rr_send_hz;			//max rate of G1 lines in velocity mode and joint space mode
+
+	bool retarget_mode;			//drive joints from the operator's own arm angles (joint_retarget), overrides rr_mode
+
+	//tool angle (gamma) from the operator's wrist -> hand direction in the plane of their arm instead of the panel
+	bool track_tool_angle;
+	float tool_angle_offset;	//degrees added to the measured angle
+	vec2 tool_angle_range;		//degrees , the measured angle is clamped to it
+
+	//sensor joints (m) to robot axes (cm), applied to the whole pose before anything reads it
+	transform_params sensor_map;
+
+	//position mode from the extrinsic_calibration result instead of the faux origin , gain and sensitivity:
+	//the tracked target goes to the firmware frame in one matrix multiply
+	bool use_extrinsic;
+	mat4 extrinsic;				//sensor joints (m) to firmware frame (mm)
+
+	//G1 stream in position mode (cm of displacement)
+	float max_displacement;		//larger displacements are tracking glitches and never sent
+	float send_threshold;		//smaller changes are not worth a new G1
+	vec3 g1_gain;				//firmware mm per cm of displacement on each axis
+
+	ivec3 origin;				//initial position of the actual robot (firmware frame, mm)
+	bool apply_mvspeed;			//append F to every G1
+	int mv_speed;
+
+	pipeline_params();
+};
+
+//Everything between a skeleton frame and a G1 line, with no sensor, window or serial port involved
+//skeleton frame -> sequence check -> bone lengths -> joint filter -> identities -> followed person's tracked joint
+//(optionally predicted ahead at the loop rate) -> displacement from the faux origin -> robot model (IK or resolved rate) -> G1 target
+//With a sensor to robot calibration the position mode skips the faux origin: tracked joint -> G1 target in one matrix
+//Owned by the app for the live arm and by the headless driver for replay / CI runs , one more per extra arm fed from the first
+class tracking_pipeline
+{
+	public:
+
+		tracking_pipeline(robot_manipulator& robot);
+
+		void set_params(const pipeline_params& params);
+		const pipeline_params& get_params() const;
+
+		//feed one skeleton frame, frames must come in order and are cleaned up by the bone constraint and the joint filter first
+		//returns false if the frame monitor dropped it (repeat or late frame of the sensor)
+		bool add_frame(const skeleton_frame& frame);
+
+		//take the frame lead just cleaned up , for extra arms following other people off the same sensor
+		//(the bone constraint , joint filter and identities run once in lead , not once per arm)
+		void add_frame(const tracking_pipeline& lead);
+
+		//make the current position of the tracking target the zero of the displacement
+		//returns false if nobody is tracked in the last frame , now is the loop clock (joint space mode is zeroed too)
+		bool set_faux_origin(double now);
+
+		//move the robot model for this loop (resolved rate integration up to now, or IK for the displaced target)
+		//with prediction on the displacement is re-evaluated here at every loop, not only when a frame arrives
+		void update(double now);
+
+		//build the G1 line for this loop, returns true if it should be sent now
+		bool stream(double now);
+
+		void set_dest(vec4 dest);			//manual model destination (x , y , z , gamma), overridden while displacement is applied
+		vec4 get_dest() const;
+		void start_rr(double now);			//restart velocity integration with the model at the robot's origin
+		bool start_retarget(double now);	//pair the operator's arm now with the model at the robot's origin , false if the arm is not visible
+
+		const skeleton_frame& get_frame() const;	//last frame added (filtered)
+		const skeleton_pose& get_pose() const;		//followed body of the last frame (robot axes , cm), parsed once per frame
+		vec3 get_displacement() const;				//cm, robot axes
+		vec3 get_faux_origin() const;				//cm, robot axes
+		bool is_faux_origin_set() const;
+		vec3 get_target_pos() const;				//tracking target in the last frame (cm), valid if has_target
+		vec3 get_sensor_target() const;				//the same in sensor coordinates (m), what the extrinsic calibration pairs up
+		float get_tool_angle() const;				//tool angle measured from the operator's hand (degrees, offset , clamped , smoothed and snapped to the send step)
+		bool has_target() const;
+
+		const char* get_gcode() const;		//G1 line of the last stream call
+		vec3 get_g1_target() const;			//its target (firmware frame)
+		uint32_t get_frame_count() const;	//frames accepted
+		uint32_t get_sent_count() const;	//stream calls that returned true
+
+		rr_teleop& get_rr();
+		joint_retarget& get_retarget();
+		frame_monitor& get_monitor();
+		body_tracker& get_people();
+		uint32_t get_following() const;		//person the last frame was taken from , 0 if nobody
+		skeleton_filter& get_filter();
+		bone_constraint& get_bones();
+		target_predictor& get_predictor();
+
+		//measured delay from joint capture to the robot (seconds): sensor latency , filter lag , frame age and G1 spacing
+		float get_delay() const;
+		float get_horizon() const;			//look ahead used by the last update
+
+		static const char* get_target_name(int target);
+		static int get_target_joint(int target);	//skel_joint of a tracking_target_index
+		static int get_target_side(int target);		//retarget_side of the arm a tracking_target_index is on (left for head and feet)
+
+	private:
+
+		robot_manipulator& robot;
+		pipeline_params params;
+
+		frame_monitor monitor;
+		body_tracker people;
+		uint32_t following;
+		bone_constraint bones;
+		skeleton_filter filter;
+		skeleton_frame frame;
+		skeleton_pose pose;
+		joint_transform sensor_map;		//params.sensor_map as a matrix
+		joint_transform g1_map;			//displacement (cm) to firmware target (mm)
+		joint_transform target_map;		//tracking target (cm) to firmware target (mm) , params.extrinsic after undoing sensor_map
+
+		vec3 faux_origin;
+		bool faux_origin_set;
+		vec3 displacement;
+		vec3 target;			//tracking target (cm) , run ahead by the predictor when it is on
+
+		//latency compensation
+		target_predictor predictor;
+		double clock_offset;	//loop clock minus source clock , smallest seen so queueing shows up as frame age
+		bool has_clock;
+		bool frame_fresh;		//a frame came in since the last update
+		float frame_age;		//average time a frame waits before the loop sees it (seconds)
+		double last_send;		//loop time of the last G1 line
+		float send_interval;	//average time between G1 lines (seconds)
+		float filter_lag;		//joint filter lag of whoever cleaned the last frame (seconds)
+		float delay;
+		float horizon;
+
+		vec4 dest;
+
+		//last displacement sent on the G1 stream
+		int x_temp_old, y_temp_old, z_temp_old;
+		int loops_since_send;	//loop tracker to space out between sends
+
+		//calibrated position mode
+		ivec3 ext_g1;			//G1 target of the last update (firmware frame , clamped)
+		vec3 ext_sent;			//tracking target of the last G1 line (cm)
+
+		//resolved rate teleop (velocity mode)
+		rr_teleop rr;
+		double rr_last_send;	//time the last G1 line was sent in velocity mode
+		vec3 rr_last_g1;		//last G1 target sent in velocity mode (firmware frame)
+
+		//joint space teleop
+		joint_retarget retarget;
+
+		//tool angle from the operator's hand
+		vec4 tool_arm;			//operator arm angles it was measured from (keeps the heading while the arm has none)
+		float tool_angle;		//snapped to TOOL_ANGLE_STEP , moves only when tool_smooth leaves the dead band around it
+		float tool_smooth;		//running average of the measured hand angle
+		bool tool_measured;		//tool_smooth has been seeded
+		float tool_sent;		//tool angle of the last G1 line
+
+		char gcode_buff[32];	//gcode container before streaming
+		vec3 g1_target;
+		uint32_t frame_cnt;
+		uint32_t sent_cnt;
+
+		void track(const body_tracker& people, float lag_ms);	//followed body of frame -> pose -> displacement
+		void add_tool_word(float tool);		//append the tool angle to gcode_buff
+		ivec3 clamp_g1(vec3 g1);			//round a G1 target into the safe box around params.origin
+		void home_to_origin();				//put the model in the pose the firmware takes at params.origin
+		bool keep_in_box(vec4& angles);		//pull a model pose whose G1 would be clamped onto the clamped target , true if moved
+};
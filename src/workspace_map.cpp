@@ -0,0 +1,336 @@
+#include "workspace_map.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+//map file header
+static const char WS_MAP_MAGIC[4] = { 'K', 'X', 'W', 'S' };
+static const uint32_t WS_MAP_VERSION = 2;
+
+//grid spacing (milimeters)
+static const float WS_MAP_STEP = 10.0f;
+
+//joint limits in the firmware convention (degrees), the host limits of robot_manipulator::make_dls_chain converted
+//low = 90 - alpha , elbow opening high - low = -beta
+static const float WS_LOW_MIN = -100.0f;
+static const float WS_LOW_MAX = 100.0f;
+static const float WS_ELBOW_MAX = 175.0f;
+
+//FK of the IK answer must land within this distance of the cell (milimeters), rejects the firmware's asin branch flips
+static const float WS_ROUND_TRIP_TOL = 1.0f;
+
+workspace_map::workspace_map() {
+    l1_len = 0;
+    l2_len = 0;
+    ee_offset = 0;
+    floor_z = 0;
+    valid = false;
+    step = WS_MAP_STEP;
+    nx = ny = nz = 0;
+    reachable_cnt = 0;
+    build_ms = 0;
+    threads = 0;
+    version = 0;
+}
+
+bool workspace_map::prepare(float l1_len, float l2_len, float ee_offset, float floor_z, const string& cache_dir)
+{
+    if (matches(l1_len, l2_len, ee_offset, floor_z)) return false;
+
+    this->l1_len = l1_len;
+    this->l2_len = l2_len;
+    this->ee_offset = ee_offset;
+    this->floor_z = floor_z;
+    set_grid();
+    version++;
+
+    string path = (fs::path(cache_dir) / cache_name()).string();
+    if (load(path)) {
+        valid = true;
+        return true;
+    }
+
+    build();
+    valid = true;
+
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+    save(path);
+    return false;
+}
+
+bool workspace_map::matches(float l1_len, float l2_len, float ee_offset, float floor_z) const
+{
+    return valid && this->l1_len == l1_len && this->l2_len == l2_len && this->ee_offset == ee_offset && this->floor_z == floor_z;
+}
+
+bool workspace_map::is_valid() const
+{
+    return valid;
+}
+
+void workspace_map::set_grid()
+{
+    //full reach in every direction the firmware can face (asin keeps y >= 0), down to the floor
+    float reach = l1_len + l2_len + ee_offset;
+    box_min = vec3(-reach, 0, floor_z);
+
+    nx = (int)ceil(2 * reach / step) + 1;
+    ny = (int)ceil(reach / step) + 1;
+    nz = std::max(1, (int)ceil((reach - floor_z) / step) + 1);
+}
+
+int workspace_map::get_dim(int axis) const
+{
+    return axis == 0 ? nx : (axis == 1 ? ny : nz);
+}
+
+size_t workspace_map::index(int i, int j, int k) const
+{
+    return ((size_t)k * ny + j) * nx + i;
+}
+
+vec3 workspace_map::get_pos(int i, int j, int k) const
+{
+    return box_min + vec3(i, j, k) * step;
+}
+
+bool workspace_map::is_reachable(int i, int j, int k) const
+{
+    return manip[index(i, j, k)] >= 0;
+}
+
+float workspace_map::get_manip(int i, int j, int k) const
+{
+    return std::max(manip[index(i, j, k)], 0.0f);
+}
+
+float workspace_map::get_step() const
+{
+    return step;
+}
+
+size_t workspace_map::get_cell_count() const
+{
+    return (size_t)nx * ny * nz;
+}
+
+size_t workspace_map::get_reachable_count() const
+{
+    return reachable_cnt;
+}
+
+double workspace_map::get_build_ms() const
+{
+    return build_ms;
+}
+
+int workspace_map::get_threads() const
+{
+    return threads;
+}
+
+int workspace_map::get_version() const
+{
+    return version;
+}
+
+void workspace_map::sample_slice(const kxr::FirmwareChain<kxr::RuntimeArmDims>& chain, int k)
+{
+    //|det J| = r * l1 * l2 * |sin(high - low)|, largest at full reach with a right angle elbow
+    float manip_norm = (l1_len + l2_len + ee_offset) * l1_len * l2_len;
+
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            vec3 p = get_pos(i, j, k);
+            float& m = manip[index(i, j, k)];
+            m = -1.0f;
+
+            //the firmware refuses G1 targets outside its move limits even when they solve
+            if (!kxr::isAllowedPosition(l1_len, l2_len, ee_offset, p.x, p.y, p.z)) continue;
+
+            kxr::FirmwareJoints q;
+            if (!chain.inverse(p.x, p.y, p.z, q)) continue;
+
+            float low = q.low * kxr::KC_RAD_TO_DEG;
+            float elbow = (q.high - q.low) * kxr::KC_RAD_TO_DEG;
+            if (low < WS_LOW_MIN || low > WS_LOW_MAX || elbow < 0 || elbow > WS_ELBOW_MAX) continue;
+
+            float fk[3];
+            chain.forward(q, fk);
+            if (distance(vec3(fk[0], fk[1], fk[2]), p) > WS_ROUND_TRIP_TOL) continue;
+
+            float r = l1_len * sin(q.low) + l2_len * sin(q.high) + ee_offset;
+            m = abs(r * l1_len * l2_len * sin(q.high - q.low)) / manip_norm;
+        }
+    }
+}
+
+void workspace_map::build()
+{
+    Timer timer(true);
+
+    manip.assign(get_cell_count(), -1.0f);
+    kxr::FirmwareChain<kxr::RuntimeArmDims> chain(kxr::RuntimeArmDims(l1_len, l2_len, ee_offset));
+
+    //z slices handed out to the workers one at a time
+    threads = std::max(1, (int)std::thread::hardware_concurrency());
+    std::atomic<int> next_slice(0);
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            for (int k = next_slice++; k < nz; k = next_slice++) sample_slice(chain, k);
+        }));
+    }
+    for (auto& w : workers) w.join();
+
+    reachable_cnt = 0;
+    for (float m : manip) if (m >= 0) reachable_cnt++;
+
+    timer.stop();
+    build_ms = timer.getSeconds() * 1000.0;
+}
+
+bool workspace_map::safe_box(vec3 seed, float margin, float min_manip, vec3& out_min, vec3& out_max) const
+{
+    if (!valid) return false;
+
+    //cells good enough to command
+    size_t cells = get_cell_count();
+    vector<uint8_t> safe(cells);
+    for (size_t n = 0; n < cells; n++) safe[n] = manip[n] >= min_manip ? 1 : 0;
+
+    //keep margin away from anything that is not (outside the grid counts as unsafe)
+    int erode = (int)ceil(margin / step);
+    vector<uint8_t> next(cells);
+    for (int e = 0; e < erode; e++) {
+        for (int k = 0; k < nz; k++)
+            for (int j = 0; j < ny; j++)
+                for (int i = 0; i < nx; i++) {
+                    size_t n = index(i, j, k);
+                    next[n] = safe[n] && i > 0 && i < nx - 1 && j > 0 && j < ny - 1 && k > 0 && k < nz - 1
+                        && safe[n - 1] && safe[n + 1] && safe[n - nx] && safe[n + nx]
+                        && safe[n - (size_t)nx * ny] && safe[n + (size_t)nx * ny];
+                }
+        safe.swap(next);
+    }
+
+    //start at the safe cell closest to the seed
+    int lo[3], hi[3];
+    float best = -1;
+    for (int k = 0; k < nz; k++)
+        for (int j = 0; j < ny; j++)
+            for (int i = 0; i < nx; i++) {
+                if (!safe[index(i, j, k)]) continue;
+                float d = distance(get_pos(i, j, k), seed);
+                if (best < 0 || d < best) {
+                    best = d;
+                    lo[0] = hi[0] = i;
+                    lo[1] = hi[1] = j;
+                    lo[2] = hi[2] = k;
+                }
+            }
+    if (best < 0) return false;
+
+    //grow one face at a time while the new slab is entirely safe
+    int dims[3] = { nx, ny, nz };
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        for (int face = 0; face < 6; face++) {
+            int axis = face / 2;
+            int layer = (face & 1) ? hi[axis] + 1 : lo[axis] - 1;
+            if (layer < 0 || layer >= dims[axis]) continue;
+
+            int a = (axis + 1) % 3;
+            int b = (axis + 2) % 3;
+            bool ok = true;
+            for (int u = lo[a]; u <= hi[a] && ok; u++)
+                for (int v = lo[b]; v <= hi[b] && ok; v++) {
+                    int c[3];
+                    c[axis] = layer;
+                    c[a] = u;
+                    c[b] = v;
+                    ok = safe[index(c[0], c[1], c[2])] != 0;
+                }
+            if (!ok) continue;
+
+            if (face & 1) hi[axis] = layer;
+            else lo[axis] = layer;
+            grown = true;
+        }
+    }
+
+    out_min = get_pos(lo[0], lo[1], lo[2]);
+    out_max = get_pos(hi[0], hi[1], hi[2]);
+    return true;
+}
+
+string workspace_map::cache_name() const
+{
+    char buff[128];
+    snprintf(buff, sizeof(buff), "workspace_%.9g_%.9g_%.9g_f%.9g_s%.9g.bin", l1_len, l2_len, ee_offset, floor_z, step);
+    return string(buff);
+}
+
+bool workspace_map::save(const string& path) const
+{
+    ofstream file(path, ios::binary);
+    if (!file) return false;
+
+    uint32_t dims[3] = { (uint32_t)nx, (uint32_t)ny, (uint32_t)nz };
+    float key[4] = { l1_len, l2_len, ee_offset, floor_z };
+    uint64_t cnt = reachable_cnt;
+
+    file.write(WS_MAP_MAGIC, sizeof(WS_MAP_MAGIC));
+    file.write((const char*)&WS_MAP_VERSION, sizeof(WS_MAP_VERSION));
+    file.write((const char*)key, sizeof(key));
+    file.write((const char*)&step, sizeof(step));
+    file.write((const char*)dims, sizeof(dims));
+    file.write((const char*)&cnt, sizeof(cnt));
+    file.write((const char*)manip.data(), manip.size() * sizeof(float));
+    return (bool)file;
+}
+
+bool workspace_map::load(const string& path)
+{
+    ifstream file(path, ios::binary);
+    if (!file) return false;
+
+    char magic[4];
+    uint32_t version;
+    float key[4];
+    float file_step;
+    uint32_t dims[3];
+    uint64_t cnt;
+
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    file.read((char*)key, sizeof(key));
+    file.read((char*)&file_step, sizeof(file_step));
+    file.read((char*)dims, sizeof(dims));
+    file.read((char*)&cnt, sizeof(cnt));
+    if (!file) return false;
+
+    //reject anything that does not match the current key and grid exactly
+    if (memcmp(magic, WS_MAP_MAGIC, sizeof(magic)) != 0 || version != WS_MAP_VERSION) return false;
+    if (key[0] != l1_len || key[1] != l2_len || key[2] != ee_offset || key[3] != floor_z) return false;
+    if (file_step != step) return false;
+    if (dims[0] != (uint32_t)nx || dims[1] != (uint32_t)ny || dims[2] != (uint32_t)nz) return false;
+
+    manip.resize(get_cell_count());
+    file.read((char*)manip.data(), manip.size() * sizeof(float));
+    if (!file) return false;
+
+    reachable_cnt = (size_t)cnt;
+    build_ms = 0;
+    threads = 0;
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cinder/Vector.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../arduino/Community_robot_firmware/robotArm_v0.41/kinematicChain.h"
+
+using namespace ci;
+using namespace std;
+
+//Reachability and manipulability of the firmware arm on a 3D grid of G1 targets
+//Note: firmware frame (x , y , z up) relative to the shoulder, milimeters
+//A cell is reachable if it passes the firmware's move limits (kxr::isAllowedPosition) , the firmware IK solves it inside
+//the joint limits and its FK lands back on the cell
+//Manipulability is |det J| of (rot , low , high) normalized to 0..1 by its value at full reach with a right angle elbow
+class workspace_map
+{
+	public:
+
+		workspace_map();
+
+		//make map valid for the geometry, loads it from cache_dir if a matching file exists
+		//otherwise samples it (multithreaded) and saves it. returns true if the map was loaded from disk
+		bool prepare(float l1_len, float l2_len, float ee_offset, float floor_z, const string& cache_dir);
+
+		bool matches(float l1_len, float l2_len, float ee_offset, float floor_z) const;
+		bool is_valid() const;
+
+		//largest axis aligned box grown from seed whose cells are all reachable with manipulability >= min_manip
+		//and at least margin milimeters away from any cell that is not. returns false if seed has no such cell nearby
+		bool safe_box(vec3 seed, float margin, float min_manip, vec3& box_min, vec3& box_max) const;
+
+		//cell centers and values, x fastest then y then z
+		int get_dim(int axis) const;
+		vec3 get_pos(int i, int j, int k) const;
+		bool is_reachable(int i, int j, int k) const;
+		float get_manip(int i, int j, int k) const;		//0 for unreachable cells
+
+		float get_step() const;
+		size_t get_cell_count() const;
+		size_t get_reachable_count() const;
+		double get_build_ms() const;
+		int get_threads() const;			//workers used by the last build
+		int get_version() const;			//bumped every time the map contents change
+
+	private:
+
+		//map key
+		float l1_len;
+		float l2_len;
+		float ee_offset;
+		float floor_z;
+		bool valid;
+
+		//sampled region, derived from the key
+		vec3 box_min;
+		float step;
+		int nx, ny, nz;
+
+		vector<float> manip;		//per cell, negative for unreachable
+		size_t reachable_cnt;
+		double build_ms;
+		int threads;
+		int version;
+
+		size_t index(int i, int j, int k) const;
+		void set_grid();
+		void build();
+		void sample_slice(const kxr::FirmwareChain<kxr::RuntimeArmDims>& chain, int k);
+		bool load(const string& path);
+		bool save(const string& path) const;
+		string cache_name() const;
+};
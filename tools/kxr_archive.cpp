@@ -0,0 +1,168 @@
+//Skeleton archive tool: pack recordings into compressed archives, unpack them again and benchmark the codec
+//Portable (no Cinder library needed, headers only), not part of the Visual Studio project (it has its own main)
+//
+//Build (one line):
+//  g++ -std=c++14 -O2 -Idependencies/Cinder/include -o kxr_archive tools/kxr_archive.cpp
+//      src/skeleton_archive.cpp src/skeleton_recording.cpp src/skeleton_frame.cpp -lpthread
+//
+//Usage:
+//  kxr_archive pack in.kxr out.kxa       compress a binary recording
+//  kxr_archive unpack in.kxa out.kxr     restore a binary recording (positions rounded to 0.1 mm)
+//  kxr_archive bench in.kxr [...]        compression ratio , encode / decode throughput and rounding error per recording
+
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+
+#include "../src/skeleton_archive.h"
+#include "../src/skeleton_recording.h"
+
+using namespace std;
+
+//Kinect frame rate, decode speed is reported as a multiple of it
+static const double KINECT_FPS = 30.0;
+
+//size of a raw NUI_SKELETON_FRAME (6 skeletons of 20 Vector4 positions and states plus headers)
+static const double NUI_FRAME_BYTES = 2664.0;
+
+static double now_ms()
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int usage()
+{
+    cerr << "usage: kxr_archive pack in.kxr out.kxa | unpack in.kxa out.kxr | bench in.kxr [...]" << endl;
+    return 2;
+}
+
+static int pack(const string& in_path, const string& out_path)
+{
+    recording_reader reader;
+    if (!reader.open(in_path)) {
+        cerr << reader.get_error() << endl;
+        return 1;
+    }
+
+    archive_writer writer;
+    if (!writer.open(out_path)) {
+        cerr << writer.get_error() << endl;
+        return 1;
+    }
+    for (size_t i = 0; i < reader.get_count(); i++) writer.add(reader.get_frame(i));
+    writer.close();
+    if (!writer.get_error().empty()) {
+        cerr << writer.get_error() << endl;
+        return 1;
+    }
+
+    cout << out_path << ": " << writer.get_frames() << " frames , " << writer.get_bytes() << " bytes" << endl;
+    return 0;
+}
+
+static int unpack(const string& in_path, const string& out_path)
+{
+    archive_reader reader;
+    if (!reader.open(in_path)) {
+        cerr << reader.get_error() << endl;
+        return 1;
+    }
+
+    recording_writer writer;
+    if (!writer.start(out_path)) {
+        cerr << writer.get_error() << endl;
+        return 1;
+    }
+    skeleton_frame frame;
+    while (reader.next(frame)) writer.push(frame, true);
+    writer.stop();
+
+    cout << out_path << ": " << reader.get_frames() << " frames";
+    if (reader.get_bad_blocks()) cout << " , " << reader.get_bad_blocks() << " damaged blocks skipped";
+    cout << endl;
+    return 0;
+}
+
+static int bench(const string& in_path)
+{
+    recording_reader reader;
+    if (!reader.open(in_path)) {
+        cerr << reader.get_error() << endl;
+        return 1;
+    }
+    size_t count = reader.get_count();
+    if (count == 0) {
+        cerr << in_path << ": empty" << endl;
+        return 1;
+    }
+
+    string tmp_path = in_path + ".bench.kxa";
+
+    //encode
+    archive_writer writer;
+    double t0 = now_ms();
+    if (!writer.open(tmp_path)) {
+        cerr << writer.get_error() << endl;
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) writer.add(reader.get_frame(i));
+    writer.close();
+    double encode_ms = now_ms() - t0;
+
+    //decode , comparing against the original as we go (compare time not counted)
+    archive_reader decoder;
+    decoder.open(tmp_path);
+    skeleton_frame frame;
+    double decode_ms = 0;
+    float max_err = 0;
+    size_t n = 0;
+    while (true) {
+        t0 = now_ms();
+        bool ok = decoder.next(frame);
+        decode_ms += now_ms() - t0;
+        if (!ok) break;
+
+        const skeleton_frame& ref = reader.get_frame(n++);
+        for (int b = 0; b < SKEL_BODY_COUNT; b++) {
+            if (!ref.bodies[b].tracked) continue;
+            for (int j = 0; j < SKEL_JOINT_COUNT; j++)
+                for (int c = 0; c < 3; c++) max_err = fmax(max_err, fabs(frame.bodies[b].joints[j][c] - ref.bodies[b].joints[j][c]));
+        }
+    }
+    decoder.close();
+    remove(tmp_path.c_str());
+
+    double raw_bytes = (double)count * sizeof(skeleton_frame);
+    double archive_bytes = (double)writer.get_bytes();
+    double decode_fps = n / (decode_ms / 1000.0);
+
+    cout << in_path << ": " << count << " frames" << endl;
+    cout << "  archive " << archive_bytes / 1024.0 << " KiB , " << archive_bytes / count << " bytes/frame" << endl;
+    cout << "  ratio " << raw_bytes / archive_bytes << "x vs records , " << count * NUI_FRAME_BYTES / archive_bytes << "x vs NUI frames" << endl;
+    cout << "  encode " << count / (encode_ms / 1000.0) << " frames/s" << endl;
+    cout << "  decode " << decode_fps << " frames/s (" << decode_fps / KINECT_FPS << "x real time)" << endl;
+    cout << "  max position error " << max_err * 1000.0f << " mm" << endl;
+
+    if (n != count) {
+        cerr << "  decoded " << n << " of " << count << " frames" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) return usage();
+    string cmd = argv[1];
+
+    if (cmd == "pack" && argc == 4) return pack(argv[2], argv[3]);
+    if (cmd == "unpack" && argc == 4) return unpack(argv[2], argv[3]);
+    if (cmd == "bench") {
+        int rc = 0;
+        for (int i = 2; i < argc; i++) rc |= bench(argv[i]);
+        return rc;
+    }
+    return usage();
+}
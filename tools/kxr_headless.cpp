@@ -0,0 +1,370 @@
+//Headless tracking pipeline: skeleton source -> tracking_pipeline -> G1 lines, no window, sensor or serial port
+//For throughput testing and CI on a machine without a Kinect. Not part of the Visual Studio project (it has its own main)
+//
+//Build on Linux against a Cinder build (robot_manipulator links cinder, no GL context is ever created), all on one line:
+//  g++ -std=c++14 -O2 -Idependencies/Cinder/include -o kxr_headless tools/kxr_headless.cpp
+//      src/tracking_pipeline.cpp src/skeleton_frame.cpp src/replay_source.cpp src/scripted_source.cpp
+//      src/robot_manipulator.cpp src/robot_mesh.cpp src/robot_fk.cpp src/rr_teleop.cpp src/ik_batch.cpp src/ik_table.cpp
+//      src/dls_ik.cpp src/workspace_map.cpp src/skeleton_recording.cpp src/skeleton_archive.cpp src/skeleton_filter.cpp
+//      src/target_predictor.cpp src/joint_transform.cpp src/bone_constraint.cpp src/noise_calibration.cpp
+//      src/frame_monitor.cpp src/body_tracker.cpp src/joint_retarget.cpp src/extrinsic_calibration.cpp
+//      -L<cinder>/lib/linux/x86_64/ogl/Release -lcinder -lGL -lpthread -ldl
+//
+//Usage:
+//  kxr_headless [--replay file | --script idle|circle|sweep] [--start s] [--seconds s] [--target 0-4] [--rr | --retarget] [--realtime]
+//               [--gcode out.txt] [--record out.kxr] [--record-text out.txt] [--min-sent n] [--filter passthrough|one-euro|kalman]
+//               [--predict] [--loop-hz n] [--bones] [--calibrate out.txt] [--profile in.txt]
+//               [--people n] [--dropout s] [--person n] [--arms n] [--tool-angle] [--extrinsic in.txt]
+//  --replay     binary recording (.kxr), archive (.kxa) or text recording
+//  --start      seek this far into a binary recording first
+//  --seconds    stop after this much source time (scripted default 10 s, replay plays the whole file)
+//  --target     tracking target (0 head , 1 left hand , 2 right hand , 3 left foot , 4 right foot), default left hand
+//  --retarget   drive the joints from the operator's arm angles instead of IK on the displaced target
+//  --realtime   pace frames at their recorded / scripted rate instead of as fast as possible
+//  --gcode      write every G1 line that would go to the serial port
+//  --record     write the frames as a binary recording (written on a background thread like the app does)
+//  --record-text  write the frames as a text recording, handy for small diffable fixtures
+//  --min-sent   fail unless at least n G1 lines were produced
+//  --filter     joint filter in front of the pipeline (default one-euro)
+//  --predict    drive the robot from the tracked joint predicted ahead by the measured delay
+//  --bones      hold the arm bones at the lengths learned over the first seconds
+//  --loop-hz    run pipeline loops at this rate between frames like the app's render loop (default one loop per frame)
+//  --calibrate  treat the first seconds as the operator holding still , tune the joint filter and save the profile
+//  --profile    start with the joint filter from a saved profile (overrides --filter)
+//  --people     bodies in the scripted scene (default 1)
+//  --dropout    scripted bodies are lost and re-acquired under a new tracking id every this many seconds
+//  --person     person the first arm follows (default 0 , whoever was in view first)
+//  --tool-angle tool angle from the operator's wrist -> hand direction , streamed as an A word
+//  --extrinsic  position mode through a saved sensor to robot calibration instead of the faux origin and gains
+//  --arms       extra arms follow persons 2 , 3 , ... off the first arm's cleaned frames (default 1 arm)
+//The faux origin is set on the first tracked frame and the displacement is applied from then on, like an operator would
+//Exit code is non zero if the source could not be opened, no frame was processed or fewer than --min-sent lines were sent
+
+#include "cinder/Timer.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/extrinsic_calibration.h"
+#include "../src/noise_calibration.h"
+#include "../src/replay_source.h"
+#include "../src/robot_manipulator.h"
+#include "../src/scripted_source.h"
+#include "../src/tracking_pipeline.h"
+
+using namespace ci;
+using namespace std;
+
+//length of a scripted run without --seconds
+static const float HEADLESS_DEFAULT_SECONDS = 10.0f;
+
+static int usage()
+{
+    cerr << "usage: kxr_headless [--replay file | --script idle|circle|sweep] [--start s] [--seconds s] [--target 0-4] [--rr | --retarget] [--realtime]" << endl
+         << "                    [--gcode out.txt] [--record out.kxr] [--record-text out.txt] [--min-sent n]" << endl
+         << "                    [--filter passthrough|one-euro|kalman] [--predict] [--loop-hz n] [--bones]" << endl
+         << "                    [--calibrate out.txt] [--profile in.txt] [--people n] [--dropout s] [--person n] [--arms n]" << endl
+         << "                    [--tool-angle] [--extrinsic in.txt]" << endl;
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    string replay_path;
+    string gcode_path;
+    string record_path;
+    string record_text_path;
+    float start = 0;
+    int motion = SCRIPT_CIRCLE;
+    float seconds = 0;
+    int target = TRACK_HAND_LEFT;
+    bool rr_mode = false;
+    bool retarget_mode = false;
+    bool realtime = false;
+    int min_sent = 0;
+    int filter_kind = filter_params().kind;
+    bool predict = false;
+    bool bones = false;
+    float loop_hz = 0;
+    string calibrate_path;
+    string profile_path;
+    string extrinsic_path;
+    int people = 1;
+    float dropout = 0;
+    int person = 0;
+    int arms = 1;
+    bool tool_angle = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--replay" && has_value) replay_path = argv[++i];
+        else if (arg == "--script" && has_value) {
+            string name = argv[++i];
+            motion = -1;
+            for (int m = 0; m < SCRIPT_MOTION_COUNT; m++)
+                if (strcasecmp(name.c_str(), scripted_source::get_motion_name(m)) == 0) motion = m;
+            if (motion < 0) return usage();
+        }
+        else if (arg == "--start" && has_value) start = (float)atof(argv[++i]);
+        else if (arg == "--seconds" && has_value) seconds = (float)atof(argv[++i]);
+        else if (arg == "--target" && has_value) target = atoi(argv[++i]);
+        else if (arg == "--rr") rr_mode = true;
+        else if (arg == "--retarget") retarget_mode = true;
+        else if (arg == "--tool-angle") tool_angle = true;
+        else if (arg == "--realtime") realtime = true;
+        else if (arg == "--gcode" && has_value) gcode_path = argv[++i];
+        else if (arg == "--record" && has_value) record_path = argv[++i];
+        else if (arg == "--record-text" && has_value) record_text_path = argv[++i];
+        else if (arg == "--min-sent" && has_value) min_sent = atoi(argv[++i]);
+        else if (arg == "--predict") predict = true;
+        else if (arg == "--bones") bones = true;
+        else if (arg == "--loop-hz" && has_value) loop_hz = (float)atof(argv[++i]);
+        else if (arg == "--calibrate" && has_value) calibrate_path = argv[++i];
+        else if (arg == "--profile" && has_value) profile_path = argv[++i];
+        else if (arg == "--extrinsic" && has_value) extrinsic_path = argv[++i];
+        else if (arg == "--people" && has_value) people = atoi(argv[++i]);
+        else if (arg == "--dropout" && has_value) dropout = (float)atof(argv[++i]);
+        else if (arg == "--person" && has_value) person = atoi(argv[++i]);
+        else if (arg == "--arms" && has_value) arms = std::max(1, atoi(argv[++i]));
+        else if (arg == "--filter" && has_value) {
+            string name = argv[++i];
+            filter_kind = -1;
+            for (int k = 0; k < FILTER_KIND_COUNT; k++)
+                if (strcasecmp(name.c_str(), skeleton_filter::get_kind_name(k)) == 0) filter_kind = k;
+            if (filter_kind < 0) return usage();
+        }
+        else return usage();
+    }
+
+    //skeleton source
+    unique_ptr<skeleton_source> source;
+    replay_source* replay = NULL;
+    if (!replay_path.empty()) {
+        replay = new replay_source(replay_path);
+        replay->set_realtime(realtime);
+        source.reset(replay);
+    }
+    else {
+        scripted_source* scripted = new scripted_source();
+        script_params params;
+        params.motion = motion;
+        params.duration = seconds > 0 ? seconds : HEADLESS_DEFAULT_SECONDS;
+        params.people = people;
+        params.dropout = dropout;
+        scripted->set_params(params);
+        scripted->set_realtime(realtime);
+        source.reset(scripted);
+    }
+
+    if (!source->start()) {
+        cerr << source->get_name() << " source: " << source->get_error() << endl;
+        return 1;
+    }
+    if (start > 0 && !(replay && replay->seek(start))) {
+        cerr << "--start needs a binary recording" << endl;
+        return 1;
+    }
+
+    ofstream gcode_file;
+    if (!gcode_path.empty()) gcode_file.open(gcode_path);
+    recording_writer recorder;
+    if (!record_path.empty() && !recorder.start(record_path)) {
+        cerr << recorder.get_error() << endl;
+        return 1;
+    }
+    ofstream record_file;
+    if (!record_text_path.empty()) {
+        record_file.open(record_text_path);
+        write_skeleton_text_header(record_file);
+    }
+
+    //same model and pipeline the app drives
+    robot_manipulator robot;
+    tracking_pipeline pipeline(robot);
+
+    pipeline_params track = pipeline.get_params();
+    track.tracking_target = target;
+    track.rr_mode = rr_mode;
+    track.retarget_mode = retarget_mode;
+    track.track_tool_angle = tool_angle;
+    if (!extrinsic_path.empty()) {
+        if (!extrinsic_calibration::load_profile(extrinsic_path, track.extrinsic)) {
+            cerr << "could not load extrinsic calibration " << extrinsic_path << endl;
+            return 1;
+        }
+        track.use_extrinsic = true;
+    }
+    track.person = person;
+    pipeline.set_params(track);
+    pipeline.set_dest(vec4(track.home_point, 0));
+    robot.set_dest(pipeline.get_dest());
+    if (rr_mode) pipeline.start_rr(0);
+
+    filter_params filter = pipeline.get_filter().get_params();
+    filter.kind = filter_kind;
+    if (!profile_path.empty() && !noise_calibration::load_profile(profile_path, filter)) {
+        cerr << "could not load filter profile " << profile_path << endl;
+        return 1;
+    }
+    pipeline.get_filter().set_params(filter);
+
+    noise_calibration calibration;
+    if (!calibrate_path.empty()) calibration.start(filter);
+
+    predict_params prediction = pipeline.get_predictor().get_params();
+    prediction.enabled = predict;
+    pipeline.get_predictor().set_params(prediction);
+
+    bone_params bone_settings = pipeline.get_bones().get_params();
+    bone_settings.enabled = bones;
+    pipeline.get_bones().set_params(bone_settings);
+
+    //extra arms follow persons 2 , 3 , ... off the frames the first arm cleaned up
+    vector<unique_ptr<robot_manipulator>> extra_robots;
+    vector<unique_ptr<tracking_pipeline>> extra_arms;
+    vector<pipeline_params> extra_tracks;
+    for (int a = 1; a < arms; a++) {
+        extra_robots.emplace_back(new robot_manipulator());
+        extra_arms.emplace_back(new tracking_pipeline(*extra_robots.back()));
+        tracking_pipeline& arm = *extra_arms.back();
+
+        pipeline_params arm_track = track;
+        arm_track.person = a + 1;
+        extra_tracks.push_back(arm_track);
+        arm.set_params(arm_track);
+        arm.set_dest(vec4(arm_track.home_point, 0));
+        extra_robots.back()->set_dest(arm.get_dest());
+        if (rr_mode) arm.start_rr(0);
+        arm.get_predictor().set_params(prediction);
+    }
+
+    //pipeline loops on the frame clock so runs are repeatable, one per frame or loop_hz in between
+    Timer wall(true);
+    skeleton_frame frame;
+    double loop_time = 0;
+    uint32_t loops = 0;
+    double lead_sum = 0;
+    while (!source->finished()) {
+        if (!source->pop(frame)) {
+            if (realtime) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (seconds > 0 && frame.time > seconds) break;
+
+        //flat out the source outruns the disk, wait for the writer instead of dropping frames
+        if (recorder.is_recording()) recorder.push(frame, !realtime);
+        if (record_file.is_open()) write_skeleton_text(record_file, frame);
+
+        //loops that would have run while waiting for this frame
+        if (loop_hz > 0 && pipeline.get_frame_count() > 0) {
+            for (loop_time += 1.0 / loop_hz; loop_time < frame.time - 1e-6; loop_time += 1.0 / loop_hz) {
+                pipeline.update(loop_time);
+                if (pipeline.stream(loop_time) && gcode_file.is_open()) gcode_file << pipeline.get_gcode() << "\n";
+                lead_sum += pipeline.get_predictor().get_lead();
+                loops++;
+
+                for (size_t a = 0; a < extra_arms.size(); a++) {
+                    extra_arms[a]->update(loop_time);
+                    extra_arms[a]->stream(loop_time);
+                }
+            }
+        }
+        loop_time = frame.time;
+
+        //repeated and late frames never reach the loop , like in the app
+        if (!pipeline.add_frame(frame)) continue;
+
+        if (calibration.is_running() && calibration.add_frame(frame) && calibration.is_done())
+            pipeline.get_filter().set_params(calibration.get_result());
+        if (!pipeline.is_faux_origin_set() && pipeline.set_faux_origin(frame.time)) {
+            track.apply_displacement = true;
+            pipeline.set_params(track);
+        }
+
+        pipeline.update(frame.time);
+        if (pipeline.stream(frame.time) && gcode_file.is_open()) gcode_file << pipeline.get_gcode() << "\n";
+        lead_sum += pipeline.get_predictor().get_lead();
+        loops++;
+
+        for (size_t a = 0; a < extra_arms.size(); a++) {
+            tracking_pipeline& arm = *extra_arms[a];
+            arm.add_frame(pipeline);
+            if (!arm.is_faux_origin_set() && arm.set_faux_origin(frame.time)) {
+                extra_tracks[a].apply_displacement = true;
+                arm.set_params(extra_tracks[a]);
+            }
+            arm.update(frame.time);
+            arm.stream(frame.time);
+        }
+    }
+    wall.stop();
+    source->stop();
+    recorder.stop();
+
+    uint32_t frames = pipeline.get_frame_count();
+    double ms = wall.getSeconds() * 1000.0;
+    cout << source->get_name() << " source: " << frames << " frames in " << ms << " ms";
+    if (ms > 0) cout << " (" << frames / wall.getSeconds() << " frames/s)";
+    cout << endl;
+    cout << "G1 lines: " << pipeline.get_sent_count() << " , last: " << pipeline.get_gcode() << endl;
+    if (people > 1 || dropout > 0 || arms > 1) {
+        cout << "People: " << pipeline.get_people().get_total() << " identities , " << pipeline.get_people().get_count()
+             << " known , arm 1 follows person " << pipeline.get_following() << endl;
+        for (size_t a = 0; a < extra_arms.size(); a++)
+            cout << "Arm " << a + 2 << ": person " << extra_arms[a]->get_following() << " , G1 lines: " << extra_arms[a]->get_sent_count()
+                 << " , last: " << extra_arms[a]->get_gcode() << endl;
+    }
+
+    if (!calibrate_path.empty()) {
+        if (!calibration.is_done()) {
+            cerr << "calibration: " << (calibration.is_running() ? "source ended before the run finished" : calibration.get_error()) << endl;
+            return 1;
+        }
+        const joint_noise& target_noise = calibration.get_noise(tracking_pipeline::get_target_joint(target));
+        const filter_params& tuned = calibration.get_result();
+        cout << "Calibration: target noise " << target_noise.noise_mm << " mm , drift " << target_noise.drift_mm_s << " mm/s -> "
+             << skeleton_filter::get_kind_name(tuned.kind) << " (min cutoff " << tuned.min_cutoff << " , beta " << tuned.beta
+             << " , process noise " << tuned.process_noise << " , measurement noise " << tuned.measurement_noise << ") lag "
+             << calibration.get_result_lag() << " ms , jitter " << calibration.get_result_jitter() << " mm"
+             << (calibration.is_budget_met() ? "" : " (budget not met)") << endl;
+        if (!calibration.save_profile(calibrate_path)) {
+            cerr << "could not write " << calibrate_path << endl;
+            return 1;
+        }
+    }
+
+    const filter_stats& stats = pipeline.get_filter().get_stats();
+    cout << skeleton_filter::get_kind_name(pipeline.get_filter().get_params().kind) << " filter: lag " << stats.lag_ms << " ms , jitter " << stats.jitter_mm
+         << " mm (raw " << stats.raw_jitter_mm << " mm)" << endl;
+    if (bones) cout << "Bone constraint: " << pipeline.get_bones().get_stats().learned << " learned , correction "
+         << pipeline.get_bones().get_stats().correction_mm << " mm" << endl;
+    const frame_stats& timing = pipeline.get_monitor().get_stats();
+    cout << "Frames: " << timing.duplicates << " duplicate , " << timing.late << " late , " << timing.missing << " missing in "
+         << timing.gaps << " gaps , interval " << timing.interval_ms << " ms (jitter " << timing.interval_jitter_ms << " ms)" << endl;
+    cout << "Loops: " << loops << " , delay " << pipeline.get_delay() * 1000.0f << " ms";
+    if (predict && loops > 0) cout << " , predicted " << pipeline.get_horizon() * 1000.0f << " ms ahead (mean lead " << lead_sum / loops << " cm)";
+    cout << endl;
+
+    if (retarget_mode) {
+        joint_retarget& retarget = pipeline.get_retarget();
+        vec4 op = retarget.get_operator_angles();
+        cout << "Retarget: operator arm " << op.x << " " << op.y << " " << op.z << " " << op.w
+             << (retarget.is_limited() ? " (limited)" : "") << endl;
+    }
+
+    if (tool_angle) cout << "Tool angle: hand " << pipeline.get_tool_angle() << " , robot " << joint_retarget::get_tool_angle(robot.get_angles()) << endl;
+
+    vec4 angles = robot.get_angles();
+    cout << "Final angles: " << angles.x << " " << angles.y << " " << angles.z << " " << angles.w << endl;
+
+    if (frames == 0 || (int)pipeline.get_sent_count() < min_sent) return 1;
+    return 0;
+}